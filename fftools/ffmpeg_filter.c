@@ -1857,10 +1857,19 @@ static int configure_input_filter(FilterGraph *fg, AVFilterGraph *graph,
 
 static void cleanup_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
 {
+    FilterGraphPriv *fgp = fgp_from_fg(fg);
+
     for (int i = 0; i < fg->nb_outputs; i++)
         ofp_from_ofilter(fg->outputs[i])->filter = NULL;
-    for (int i = 0; i < fg->nb_inputs; i++)
-        ifp_from_ifilter(fg->inputs[i])->filter = NULL;
+    for (int i = 0; i < fg->nb_inputs; i++) {
+        InputFilterPriv *ifp = ifp_from_ifilter(fg->inputs[i]);
+
+        // the graph is not running here, collect the copies it made
+        if (ifp->filter)
+            sch_filter_add_copies(fgp->sch, fgp->sch_idx, ifp->index,
+                                  av_buffersrc_get_nb_frame_copies(ifp->filter));
+        ifp->filter = NULL;
+    }
     avfilter_graph_free(&fgt->graph);
 }
 
@@ -1915,6 +1924,8 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
             ret = av_opt_set(fgt->graph, "threads", fgp->nb_threads, 0);
             if (ret < 0)
                 return ret;
+        } else {
+            fgt->graph->nb_threads = sch_thread_share(fgp->sch);
         }
 
         if (av_dict_count(ofp->sws_opts)) {
@@ -1934,7 +1945,10 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
             av_free(args);
         }
     } else {
-        fgt->graph->nb_threads = filter_complex_nbthreads;
+        fgt->graph->nb_threads = filter_complex_nbthreads ?
+                                 filter_complex_nbthreads : sch_thread_share(fgp->sch);
+        if (filter_complex_branch_threads)
+            fgt->graph->thread_type |= AVFILTER_THREAD_BRANCH;
     }
 
     hw_device = hw_device_for_filter();
@@ -3077,6 +3091,7 @@ finish:
     if (ret == AVERROR_EOF)
         ret = 0;
 
+    cleanup_filtergraph(fg, &fgt);
     fg_thread_uninit(&fgt);
 
     return ret;
@@ -19,9 +19,13 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
 #include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "cmdutils.h"
 #include "ffmpeg_sched.h"
@@ -69,12 +73,23 @@ typedef struct SchTask {
 
     pthread_t           thread;
     int                 thread_running;
+
+    // tracing state, only used when tracing is enabled
+    char                trace_name[32];
+    int64_t             trace_start;
+    int64_t             trace_end;
+    // total time spent blocked in scheduler calls
+    int64_t             trace_wait;
+    size_t              trace_max_queued;
 } SchTask;
 
 typedef struct SchDecOutput {
     SchedulerNode      *dst;
     uint8_t            *dst_finished;
     unsigned         nb_dst;
+
+    // per-destination count of frames sent
+    uint64_t           *dst_frames;
 } SchDecOutput;
 
 typedef struct SchDec {
@@ -238,6 +253,10 @@ typedef struct SchFilterIn {
     SchedulerNode       src_sched;
     int                 send_finished;
     int                 receive_finished;
+
+    // frames received on this input that the filters had to copy to write
+    // into them; only updated by the filtergraph task
+    uint64_t            nb_copies;
 } SchFilterIn;
 
 typedef struct SchFilterOut {
@@ -304,6 +323,15 @@ struct Scheduler {
     char               *sdp_filename;
     int                 sdp_auto;
 
+    unsigned            thread_budget;
+    unsigned            thread_share;
+
+    char               *trace_filename;
+    FILE               *trace_file;
+    pthread_mutex_t     trace_lock;
+    int64_t             trace_time_base;
+    int                 trace_nb_events;
+
     enum SchedulerState state;
     atomic_int          terminate;
     atomic_int          task_failed;
@@ -409,6 +437,119 @@ static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_si
     return 0;
 }
 
+static av_printf_format(2, 3)
+void trace_write(Scheduler *sch, const char *fmt, ...)
+{
+    va_list vl;
+
+    pthread_mutex_lock(&sch->trace_lock);
+
+    fputs(sch->trace_nb_events++ ? ",\n" : "[\n", sch->trace_file);
+
+    va_start(vl, fmt);
+    vfprintf(sch->trace_file, fmt, vl);
+    va_end(vl);
+
+    pthread_mutex_unlock(&sch->trace_lock);
+}
+
+static unsigned trace_tid(const SchTask *task)
+{
+    return (task->node.type << 16) | task->node.idx;
+}
+
+static int64_t trace_clock(const Scheduler *sch)
+{
+    return sch->trace_file ? av_gettime_relative() : 0;
+}
+
+/**
+ * Record that the task was blocked in a scheduler call since start, as
+ * returned by trace_clock().
+ */
+static void trace_wait(Scheduler *sch, SchTask *task, const char *name,
+                       int64_t start)
+{
+    int64_t end;
+
+    if (!sch->trace_file)
+        return;
+
+    end = av_gettime_relative();
+    task->trace_wait += end - start;
+
+    trace_write(sch, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,"
+                "\"ts\":%"PRId64",\"dur\":%"PRId64"}", name, trace_tid(task),
+                start - sch->trace_time_base, end - start);
+}
+
+static void trace_queue(Scheduler *sch, SchTask *task, ThreadQueue *tq)
+{
+    size_t nb_queued;
+
+    if (!sch->trace_file)
+        return;
+
+    nb_queued = tq_nb_queued(tq);
+    task->trace_max_queued = FFMAX(task->trace_max_queued, nb_queued);
+
+    trace_write(sch, "{\"name\":\"%s queue\",\"ph\":\"C\",\"pid\":0,"
+                "\"ts\":%"PRId64",\"args\":{\"items\":%zu}}", task->trace_name,
+                av_gettime_relative() - sch->trace_time_base, nb_queued);
+}
+
+static void trace_choke(Scheduler *sch, SchTask *task, int choked)
+{
+    if (!sch->trace_file)
+        return;
+
+    trace_write(sch, "{\"name\":\"%s choked\",\"ph\":\"C\",\"pid\":0,"
+                "\"ts\":%"PRId64",\"args\":{\"choked\":%d}}", task->trace_name,
+                av_gettime_relative() - sch->trace_time_base, choked);
+}
+
+static void trace_report(Scheduler *sch, const SchTask *task)
+{
+    int64_t total = task->trace_end - task->trace_start;
+
+    if (!sch->trace_file || !task->trace_start)
+        return;
+
+    av_log(sch, AV_LOG_INFO, "%s: busy %.3fs, waiting %.3fs (%.1f%%), "
+           "max queued %zu\n", task->trace_name,
+           (total - task->trace_wait) / 1e6, task->trace_wait / 1e6,
+           total > 0 ? 100.0 * task->trace_wait / total : 0.0,
+           task->trace_max_queued);
+}
+
+static int trace_open(Scheduler *sch)
+{
+    if (!sch->trace_filename)
+        return 0;
+
+    sch->trace_file = fopen(sch->trace_filename, "w");
+    if (!sch->trace_file) {
+        int ret = AVERROR(errno);
+        av_log(sch, AV_LOG_ERROR, "Error opening trace file '%s': %s\n",
+               sch->trace_filename, av_err2str(ret));
+        return ret;
+    }
+
+    sch->trace_time_base = av_gettime_relative();
+
+    return 0;
+}
+
+static void trace_close(Scheduler *sch)
+{
+    if (!sch->trace_file)
+        return;
+
+    fputs(sch->trace_nb_events ? "\n]\n" : "[]\n", sch->trace_file);
+    fclose(sch->trace_file);
+    sch->trace_file = NULL;
+}
+
 static void *task_wrapper(void *arg);
 
 static int task_start(SchTask *task)
@@ -440,6 +581,13 @@ static void task_init(Scheduler *sch, SchTask *task, enum SchedulerNodeType type
 
     task->func      = func;
     task->func_arg  = func_arg;
+
+    snprintf(task->trace_name, sizeof(task->trace_name), "%s %u",
+             type == SCH_NODE_TYPE_DEMUX     ? "demux"       :
+             type == SCH_NODE_TYPE_MUX       ? "mux"         :
+             type == SCH_NODE_TYPE_DEC       ? "dec"         :
+             type == SCH_NODE_TYPE_ENC       ? "enc"         :
+             type == SCH_NODE_TYPE_FILTER_IN ? "filtergraph" : "?", idx);
 }
 
 static int64_t trailing_dts(const Scheduler *sch, int count_finished)
@@ -464,6 +612,31 @@ static int64_t trailing_dts(const Scheduler *sch, int count_finished)
     return min_dts == INT64_MAX ? AV_NOPTS_VALUE : min_dts;
 }
 
+static void dec_report_stats(const Scheduler *sch, SchDec *dec, unsigned out_idx)
+{
+    const SchDecOutput *o = &dec->outputs[out_idx];
+
+    if (!o->dst_frames)
+        return;
+
+    for (unsigned i = 0; i < o->nb_dst; i++) {
+        const SchedulerNode *dst = &o->dst[i];
+
+        if (!o->dst_frames[i])
+            continue;
+
+        if (dst->type == SCH_NODE_TYPE_FILTER_IN) {
+            const SchFilterIn *fi = &sch->filters[dst->idx].inputs[dst->idx_stream];
+            av_log(dec, AV_LOG_VERBOSE,
+                   "Output %u -> filtergraph %u:%u: %"PRIu64" frames, %"PRIu64" copied\n",
+                   out_idx, dst->idx, dst->idx_stream, o->dst_frames[i], fi->nb_copies);
+        } else {
+            av_log(dec, AV_LOG_VERBOSE, "Output %u -> encoder %u: %"PRIu64" frames\n",
+                   out_idx, dst->idx, o->dst_frames[i]);
+        }
+    }
+}
+
 void sch_free(Scheduler **psch)
 {
     Scheduler *sch = *psch;
@@ -524,6 +697,7 @@ void sch_free(Scheduler **psch)
 
             av_freep(&o->dst);
             av_freep(&o->dst_finished);
+            av_freep(&o->dst_frames);
         }
 
         av_freep(&dec->outputs);
@@ -567,6 +741,10 @@ void sch_free(Scheduler **psch)
 
     av_freep(&sch->sdp_filename);
 
+    trace_close(sch);
+    av_freep(&sch->trace_filename);
+    pthread_mutex_destroy(&sch->trace_lock);
+
     pthread_mutex_destroy(&sch->schedule_lock);
 
     pthread_mutex_destroy(&sch->mux_ready_lock);
@@ -598,6 +776,10 @@ Scheduler *sch_alloc(void)
     if (ret)
         goto fail;
 
+    ret = pthread_mutex_init(&sch->trace_lock, NULL);
+    if (ret)
+        goto fail;
+
     ret = pthread_mutex_init(&sch->mux_ready_lock, NULL);
     if (ret)
         goto fail;
@@ -623,6 +805,23 @@ int sch_sdp_filename(Scheduler *sch, const char *sdp_filename)
     return sch->sdp_filename ? 0 : AVERROR(ENOMEM);
 }
 
+void sch_thread_budget(Scheduler *sch, unsigned nb_threads)
+{
+    sch->thread_budget = nb_threads;
+}
+
+unsigned sch_thread_share(const Scheduler *sch)
+{
+    return sch->thread_share;
+}
+
+int sch_trace_filename(Scheduler *sch, const char *trace_filename)
+{
+    av_freep(&sch->trace_filename);
+    sch->trace_filename = av_strdup(trace_filename);
+    return sch->trace_filename ? 0 : AVERROR(ENOMEM);
+}
+
 static const AVClass sch_mux_class = {
     .class_name                = "SchMux",
     .version                   = LIBAVUTIL_VERSION_INT,
@@ -1357,8 +1556,11 @@ static void schedule_update_locked(Scheduler *sch)
     for (unsigned type = 0; type < 2; type++)
         for (unsigned i = 0; i < (type ? sch->nb_filters : sch->nb_demux); i++) {
             SchWaiter *w = type ? &sch->filters[i].waiter : &sch->demux[i].waiter;
-            if (w->choked_prev != w->choked_next)
+            if (w->choked_prev != w->choked_next) {
                 waiter_set(w, w->choked_next);
+                trace_choke(sch, type ? &sch->filters[i].task : &sch->demux[i].task,
+                            w->choked_next);
+            }
         }
 
 }
@@ -1492,7 +1694,8 @@ static int start_prepare(Scheduler *sch)
             }
 
             o->dst_finished = av_calloc(o->nb_dst, sizeof(*o->dst_finished));
-            if (!o->dst_finished)
+            o->dst_frames   = av_calloc(o->nb_dst, sizeof(*o->dst_frames));
+            if (!o->dst_finished || !o->dst_frames)
                 return AVERROR(ENOMEM);
         }
     }
@@ -1604,6 +1807,19 @@ int sch_start(Scheduler *sch)
     if (ret < 0)
         return ret;
 
+    ret = trace_open(sch);
+    if (ret < 0)
+        return ret;
+
+    if (sch->thread_budget) {
+        unsigned nb_users = FFMAX(sch->nb_enc + sch->nb_filters, 1);
+
+        sch->thread_share = FFMAX(sch->thread_budget / nb_users, 1);
+        av_log(sch, AV_LOG_VERBOSE, "Thread budget of %u shared by %u "
+               "encoders and filtergraphs: %u threads each\n",
+               sch->thread_budget, nb_users, sch->thread_share);
+    }
+
     av_assert0(sch->state == SCH_STATE_UNINIT);
     sch->state = SCH_STATE_STARTED;
 
@@ -2036,8 +2252,8 @@ static int demux_flush(Scheduler *sch, SchDemux *d, AVPacket *pkt)
     return 0;
 }
 
-int sch_demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
-                   unsigned flags)
+static int demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
+                      unsigned flags)
 {
     SchDemux *d;
     int terminate;
@@ -2058,6 +2274,15 @@ int sch_demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
     return demux_send_for_stream(sch, d, &d->streams[pkt->stream_index], pkt, flags);
 }
 
+int sch_demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
+                   unsigned flags)
+{
+    int64_t start = trace_clock(sch);
+    int ret = demux_send(sch, demux_idx, pkt, flags);
+    trace_wait(sch, &sch->demux[demux_idx].task, "send", start);
+    return ret;
+}
+
 static int demux_done(Scheduler *sch, unsigned demux_idx)
 {
     SchDemux *d = &sch->demux[demux_idx];
@@ -2080,7 +2305,7 @@ static int demux_done(Scheduler *sch, unsigned demux_idx)
     return ret;
 }
 
-int sch_mux_receive(Scheduler *sch, unsigned mux_idx, AVPacket *pkt)
+static int mux_receive(Scheduler *sch, unsigned mux_idx, AVPacket *pkt)
 {
     SchMux *mux;
     int ret, stream_idx;
@@ -2093,6 +2318,15 @@ int sch_mux_receive(Scheduler *sch, unsigned mux_idx, AVPacket *pkt)
     return ret;
 }
 
+int sch_mux_receive(Scheduler *sch, unsigned mux_idx, AVPacket *pkt)
+{
+    int64_t start = trace_clock(sch);
+    int ret = mux_receive(sch, mux_idx, pkt);
+    trace_wait(sch, &sch->mux[mux_idx].task, "receive", start);
+    trace_queue(sch, &sch->mux[mux_idx].task, sch->mux[mux_idx].queue);
+    return ret;
+}
+
 void sch_mux_receive_finish(Scheduler *sch, unsigned mux_idx, unsigned stream_idx)
 {
     SchMux *mux;
@@ -2164,7 +2398,7 @@ static int mux_done(Scheduler *sch, unsigned mux_idx)
     return 0;
 }
 
-int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
+static int dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
 {
     SchDec *dec;
     int ret, dummy;
@@ -2193,6 +2427,15 @@ int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
     return ret;
 }
 
+int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
+{
+    int64_t start = trace_clock(sch);
+    int ret = dec_receive(sch, dec_idx, pkt);
+    trace_wait(sch, &sch->dec[dec_idx].task, "receive", start);
+    trace_queue(sch, &sch->dec[dec_idx].task, sch->dec[dec_idx].queue);
+    return ret;
+}
+
 static int send_to_filter(Scheduler *sch, SchFilterGraph *fg,
                           unsigned in_idx, AVFrame *frame)
 {
@@ -2240,12 +2483,12 @@ finish:
     return AVERROR_EOF;
 }
 
-int sch_dec_send(Scheduler *sch, unsigned dec_idx,
-                 unsigned out_idx, AVFrame *frame)
+static int dec_send(Scheduler *sch, unsigned dec_idx,
+                    unsigned out_idx, AVFrame *frame)
 {
     SchDec *dec;
     SchDecOutput *o;
-    int ret;
+    int ret, has_data;
     unsigned nb_done = 0;
 
     av_assert0(dec_idx < sch->nb_dec);
@@ -2254,6 +2497,11 @@ int sch_dec_send(Scheduler *sch, unsigned dec_idx,
     av_assert0(out_idx < dec->nb_outputs);
     o = &dec->outputs[out_idx];
 
+    // fan-out only ever passes references, the data is duplicated later
+    // only if a consumer needs to write into a frame it does not own;
+    // filtergraphs account for those copies with sch_filter_add_copies()
+    has_data = !!frame->buf[0];
+
     for (unsigned i = 0; i < o->nb_dst; i++) {
         uint8_t *finished = &o->dst_finished[i];
         AVFrame *to_send  = frame;
@@ -2279,11 +2527,22 @@ int sch_dec_send(Scheduler *sch, unsigned dec_idx,
             }
             return ret;
         }
+
+        o->dst_frames[i] += has_data;
     }
 
     return (nb_done == o->nb_dst) ? AVERROR_EOF : 0;
 }
 
+int sch_dec_send(Scheduler *sch, unsigned dec_idx,
+                 unsigned out_idx, AVFrame *frame)
+{
+    int64_t start = trace_clock(sch);
+    int ret = dec_send(sch, dec_idx, out_idx, frame);
+    trace_wait(sch, &sch->dec[dec_idx].task, "send", start);
+    return ret;
+}
+
 static int dec_done(Scheduler *sch, unsigned dec_idx)
 {
     SchDec *dec = &sch->dec[dec_idx];
@@ -2309,7 +2568,7 @@ static int dec_done(Scheduler *sch, unsigned dec_idx)
     return ret;
 }
 
-int sch_enc_receive(Scheduler *sch, unsigned enc_idx, AVFrame *frame)
+static int enc_receive(Scheduler *sch, unsigned enc_idx, AVFrame *frame)
 {
     SchEnc *enc;
     int ret, dummy;
@@ -2323,6 +2582,15 @@ int sch_enc_receive(Scheduler *sch, unsigned enc_idx, AVFrame *frame)
     return ret;
 }
 
+int sch_enc_receive(Scheduler *sch, unsigned enc_idx, AVFrame *frame)
+{
+    int64_t start = trace_clock(sch);
+    int ret = enc_receive(sch, enc_idx, frame);
+    trace_wait(sch, &sch->enc[enc_idx].task, "receive", start);
+    trace_queue(sch, &sch->enc[enc_idx].task, sch->enc[enc_idx].queue);
+    return ret;
+}
+
 static int enc_send_to_dst(Scheduler *sch, const SchedulerNode dst,
                            uint8_t *dst_finished, AVPacket *pkt)
 {
@@ -2353,7 +2621,7 @@ finish:
     return AVERROR_EOF;
 }
 
-int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
+static int enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
 {
     SchEnc *enc;
     int ret;
@@ -2386,6 +2654,14 @@ int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
     return 0;
 }
 
+int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
+{
+    int64_t start = trace_clock(sch);
+    int ret = enc_send(sch, enc_idx, pkt);
+    trace_wait(sch, &sch->enc[enc_idx].task, "send", start);
+    return ret;
+}
+
 static int enc_done(Scheduler *sch, unsigned enc_idx)
 {
     SchEnc *enc = &sch->enc[enc_idx];
@@ -2402,8 +2678,8 @@ static int enc_done(Scheduler *sch, unsigned enc_idx)
     return ret;
 }
 
-int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
-                       unsigned *in_idx, AVFrame *frame)
+static int filter_receive(Scheduler *sch, unsigned fg_idx,
+                          unsigned *in_idx, AVFrame *frame)
 {
     SchFilterGraph *fg;
 
@@ -2446,6 +2722,16 @@ int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
     }
 }
 
+int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
+                       unsigned *in_idx, AVFrame *frame)
+{
+    int64_t start = trace_clock(sch);
+    int ret = filter_receive(sch, fg_idx, in_idx, frame);
+    trace_wait(sch, &sch->filters[fg_idx].task, "receive", start);
+    trace_queue(sch, &sch->filters[fg_idx].task, sch->filters[fg_idx].queue);
+    return ret;
+}
+
 void sch_filter_receive_finish(Scheduler *sch, unsigned fg_idx, unsigned in_idx)
 {
     SchFilterGraph *fg;
@@ -2467,7 +2753,19 @@ void sch_filter_receive_finish(Scheduler *sch, unsigned fg_idx, unsigned in_idx)
     }
 }
 
-int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *frame)
+void sch_filter_add_copies(Scheduler *sch, unsigned fg_idx, unsigned in_idx,
+                           uint64_t nb_copies)
+{
+    SchFilterGraph *fg;
+
+    av_assert0(fg_idx < sch->nb_filters);
+    fg = &sch->filters[fg_idx];
+
+    av_assert0(in_idx < fg->nb_inputs);
+    fg->inputs[in_idx].nb_copies += nb_copies;
+}
+
+static int filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *frame)
 {
     SchFilterGraph *fg;
     SchedulerNode  dst;
@@ -2483,6 +2781,14 @@ int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *
            send_to_filter(sch, &sch->filters[dst.idx], dst.idx_stream, frame);
 }
 
+int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *frame)
+{
+    int64_t start = trace_clock(sch);
+    int ret = filter_send(sch, fg_idx, out_idx, frame);
+    trace_wait(sch, &sch->filters[fg_idx].task, "send", start);
+    return ret;
+}
+
 static int filter_done(Scheduler *sch, unsigned fg_idx)
 {
     SchFilterGraph *fg = &sch->filters[fg_idx];
@@ -2541,6 +2847,13 @@ static void *task_wrapper(void *arg)
     int ret;
     int err = 0;
 
+    if (sch->trace_file) {
+        task->trace_start = av_gettime_relative();
+        trace_write(sch, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                    "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    trace_tid(task), task->trace_name);
+    }
+
     ret = task->func(task->func_arg);
     if (ret < 0)
         av_log(task->func_arg, AV_LOG_ERROR,
@@ -2549,6 +2862,8 @@ static void *task_wrapper(void *arg)
     err = task_cleanup(sch, task->node);
     ret = err_merge(ret, err);
 
+    task->trace_end = trace_clock(sch);
+
     // EOF is considered normal termination
     if (ret == AVERROR_EOF)
         ret = 0;
@@ -2614,6 +2929,11 @@ int sch_stop(Scheduler *sch, int64_t *finish_ts)
         ret = err_merge(ret, err);
     }
 
+    // filtergraphs report their copies when they terminate
+    for (unsigned i = 0; i < sch->nb_dec; i++)
+        for (unsigned j = 0; j < sch->dec[i].nb_outputs; j++)
+            dec_report_stats(sch, &sch->dec[i], j);
+
     for (unsigned i = 0; i < sch->nb_enc; i++) {
         SchEnc *enc = &sch->enc[i];
 
@@ -2631,6 +2951,21 @@ int sch_stop(Scheduler *sch, int64_t *finish_ts)
     if (finish_ts)
         *finish_ts = trailing_dts(sch, 1);
 
+    if (sch->trace_file) {
+        for (unsigned i = 0; i < sch->nb_demux; i++)
+            trace_report(sch, &sch->demux[i].task);
+        for (unsigned i = 0; i < sch->nb_dec; i++)
+            trace_report(sch, &sch->dec[i].task);
+        for (unsigned i = 0; i < sch->nb_filters; i++)
+            trace_report(sch, &sch->filters[i].task);
+        for (unsigned i = 0; i < sch->nb_enc; i++)
+            trace_report(sch, &sch->enc[i].task);
+        for (unsigned i = 0; i < sch->nb_mux; i++)
+            trace_report(sch, &sch->mux[i].task);
+
+        trace_close(sch);
+    }
+
     sch->state = SCH_STATE_STOPPED;
 
     return ret;
@@ -298,6 +298,35 @@ int sch_mux_stream_ready(Scheduler *sch, unsigned mux_idx, unsigned stream_idx);
  */
 int sch_sdp_filename(Scheduler *sch, const char *sdp_filename);
 
+/**
+ * Set the total number of threads to be shared by all encoders and
+ * filtergraphs that use an automatic thread count. 0 (the default) lets each
+ * of them choose its thread count independently.
+ *
+ * Must be called before sch_start().
+ */
+void sch_thread_budget(Scheduler *sch, unsigned nb_threads);
+
+/**
+ * @return number of threads an encoder or filtergraph with an automatic
+ *         thread count should use, as determined from the thread budget at
+ *         sch_start(); 0 if no budget was set
+ */
+unsigned sch_thread_share(const Scheduler *sch);
+
+/**
+ * Enable scheduler tracing and set the file path the trace is written to.
+ *
+ * When tracing is enabled, the time every task spends blocked in the
+ * scheduler, the occupancy of its input queue and changes in the choked state
+ * of demuxers and filtergraphs are written to the file in the Chrome trace
+ * event JSON format. A per-task summary is logged when the scheduler is
+ * stopped.
+ *
+ * Must be called before sch_start().
+ */
+int sch_trace_filename(Scheduler *sch, const char *trace_filename);
+
 /**
  * Add an encoder to the scheduler.
  *
@@ -425,6 +454,18 @@ int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
  */
 void sch_filter_receive_finish(Scheduler *sch, unsigned fg_idx, unsigned in_idx);
 
+/**
+ * Called by filtergraph tasks to account for frames received on an input
+ * that the filters had to copy before writing into them, because their
+ * data was still shared with another consumer.
+ *
+ * @param fg_idx Filtergraph index previously returned by sch_add_filtergraph().
+ * @param in_idx Index of the input the copied frames were received on.
+ * @param nb_copies Number of copies to add.
+ */
+void sch_filter_add_copies(Scheduler *sch, unsigned fg_idx, unsigned in_idx,
+                           uint64_t nb_copies);
+
 /**
  * Called by filtergraph tasks to send a filtered frame or EOF to consumers.
  *
@@ -78,4 +78,9 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data);
  */
 void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx);
 
+/**
+ * @return number of items currently stored in the queue
+ */
+size_t tq_nb_queued(ThreadQueue *tq);
+
 #endif // FFTOOLS_THREAD_QUEUE_H
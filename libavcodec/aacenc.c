@@ -826,19 +826,377 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+/* Tools selected by the per-element searches, used to decide whether the
+ * coefficients must be restored before another rate control iteration. */
+enum {
+    ELEMENT_TNS  = 1 << 0,
+    ELEMENT_IS   = 1 << 1,
+    ELEMENT_PRED = 1 << 2,
+};
+
+typedef struct ElementJobArg {
+    FFPsyWindowInfo *windows;
+    int flush;                                   ///< no more input, lookahead is unavailable
+} ElementJobArg;
+
+static int element_start_channel(const AACEncContext *s, int elem)
+{
+    int i, start_ch = 0;
+    for (i = 0; i < elem; i++)
+        start_ch += s->chan_map[i + 1] == TYPE_CPE ? 2 : 1;
+    return start_ch;
+}
+
+/**
+ * Decide the window sequence of each channel of an element and transform
+ * its input to the frequency domain.
+ */
+static int transform_element(AVCodecContext *avctx, AACEncContext *s,
+                             FFPsyWindowInfo *windows, int elem, int flush)
+{
+    float **samples = s->planar_samples, *samples2, *la, *overlap;
+    const int tag      = s->chan_map[elem + 1];
+    const int chans    = tag == TYPE_CPE ? 2 : 1;
+    const int start_ch = element_start_channel(s, elem);
+    ChannelElement *cpe = &s->cpe[elem];
+    FFPsyWindowInfo *wi = windows + start_ch;
+    SingleChannelElement *sce;
+    IndividualChannelStream *ics;
+    int ch, w;
+
+    for (ch = 0; ch < chans; ch++) {
+        int k;
+        float clip_avoidance_factor;
+        sce = &cpe->ch[ch];
+        ics = &sce->ics;
+        s->cur_channel = start_ch + ch;
+        overlap  = &samples[s->cur_channel][0];
+        samples2 = overlap + 1024;
+        la       = samples2 + (448+64);
+        if (flush)
+            la = NULL;
+        if (tag == TYPE_LFE) {
+            wi[ch].window_type[0] = wi[ch].window_type[1] = ONLY_LONG_SEQUENCE;
+            wi[ch].window_shape   = 0;
+            wi[ch].num_windows    = 1;
+            wi[ch].grouping[0]    = 1;
+            wi[ch].clipping[0]    = 0;
+
+            /* Only the lowest 12 coefficients are used in a LFE channel.
+             * The expression below results in only the bottom 8 coefficients
+             * being used for 11.025kHz to 16kHz sample rates.
+             */
+            ics->num_swb = s->samplerate_index >= 8 ? 1 : 3;
+        } else {
+            wi[ch] = s->psy.model->window(&s->psy, samples2, la, s->cur_channel,
+                                          ics->window_sequence[0]);
+        }
+        ics->window_sequence[1] = ics->window_sequence[0];
+        ics->window_sequence[0] = wi[ch].window_type[0];
+        ics->use_kb_window[1]   = ics->use_kb_window[0];
+        ics->use_kb_window[0]   = wi[ch].window_shape;
+        ics->num_windows        = wi[ch].num_windows;
+        ics->swb_sizes          = s->psy.bands    [ics->num_windows == 8];
+        ics->num_swb            = tag == TYPE_LFE ? ics->num_swb : s->psy.num_bands[ics->num_windows == 8];
+        ics->max_sfb            = FFMIN(ics->max_sfb, ics->num_swb);
+        ics->swb_offset         = wi[ch].window_type[0] == EIGHT_SHORT_SEQUENCE ?
+                                    ff_swb_offset_128 [s->samplerate_index]:
+                                    ff_swb_offset_1024[s->samplerate_index];
+        ics->tns_max_bands      = wi[ch].window_type[0] == EIGHT_SHORT_SEQUENCE ?
+                                    ff_tns_max_bands_128 [s->samplerate_index]:
+                                    ff_tns_max_bands_1024[s->samplerate_index];
+
+        for (w = 0; w < ics->num_windows; w++)
+            ics->group_len[w] = wi[ch].grouping[w];
+
+        /* Calculate input sample maximums and evaluate clipping risk */
+        clip_avoidance_factor = 0.0f;
+        for (w = 0; w < ics->num_windows; w++) {
+            const float *wbuf = overlap + w * 128;
+            const int wlen = 2048 / ics->num_windows;
+            float max = 0;
+            int j;
+            /* mdct input is 2 * output */
+            for (j = 0; j < wlen; j++)
+                max = FFMAX(max, fabsf(wbuf[j]));
+            wi[ch].clipping[w] = max;
+        }
+        for (w = 0; w < ics->num_windows; w++) {
+            if (wi[ch].clipping[w] > CLIP_AVOIDANCE_FACTOR) {
+                ics->window_clipping[w] = 1;
+                clip_avoidance_factor = FFMAX(clip_avoidance_factor, wi[ch].clipping[w]);
+            } else {
+                ics->window_clipping[w] = 0;
+            }
+        }
+        if (clip_avoidance_factor > CLIP_AVOIDANCE_FACTOR) {
+            ics->clip_avoidance_factor = CLIP_AVOIDANCE_FACTOR / clip_avoidance_factor;
+        } else {
+            ics->clip_avoidance_factor = 1.0f;
+        }
+
+        apply_window_and_mdct(s, sce, overlap);
+
+        if (s->options.ltp && s->coder->update_ltp) {
+            s->coder->update_ltp(s, sce);
+            apply_window[sce->ics.window_sequence[0]](s->fdsp, sce, &sce->ltp_state[0]);
+            s->mdct1024_fn(s->mdct1024, sce->lcoeffs, sce->ret_buf, sizeof(float));
+        }
+
+        for (k = 0; k < 1024; k++) {
+            if (!(fabs(cpe->ch[ch].coeffs[k]) < 1E16)) { // Ensure headroom for energy calculation
+                av_log(avctx, AV_LOG_ERROR, "Input contains (near) NaN/+-Inf\n");
+                return AVERROR(EINVAL);
+            }
+        }
+        avoid_clipping(s, sce);
+    }
+    return 0;
+}
+
+/**
+ * Reset the per-frame coding state of an element and run the psychoacoustic
+ * analysis on it.
+ * @return the number of bits psy asks for, scaled by lambda
+ */
+static float analyze_element(AVCodecContext *avctx, AACEncContext *s,
+                           FFPsyWindowInfo *windows, int elem)
+{
+    const int chans    = s->chan_map[elem + 1] == TYPE_CPE ? 2 : 1;
+    const int start_ch = element_start_channel(s, elem);
+    ChannelElement *cpe = &s->cpe[elem];
+    const float *coeffs[2];
+    float bits = 0.0f;
+    int ch, w;
+
+    cpe->common_window = 0;
+    memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
+    memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
+    for (ch = 0; ch < chans; ch++) {
+        SingleChannelElement *sce = &cpe->ch[ch];
+        coeffs[ch] = sce->coeffs;
+        sce->ics.predictor_present = 0;
+        sce->ics.ltp.present = 0;
+        memset(sce->ics.ltp.used, 0, sizeof(sce->ics.ltp.used));
+        memset(sce->ics.prediction_used, 0, sizeof(sce->ics.prediction_used));
+        memset(&sce->tns, 0, sizeof(TemporalNoiseShaping));
+        for (w = 0; w < 128; w++)
+            if (sce->band_type[w] > RESERVED_BT)
+                sce->band_type[w] = 0;
+    }
+    s->psy.bitres.alloc = -1;
+    s->psy.bitres.bits = s->last_frame_pb_count / s->channels;
+    s->psy.model->analyze(&s->psy, start_ch, coeffs, windows + start_ch);
+    if (s->psy.bitres.alloc > 0) {
+        /* Lambda unused here on purpose, we need to take psy's unscaled allocation */
+        bits = s->psy.bitres.alloc
+            * (s->lambda / (avctx->global_quality ? avctx->global_quality : 120));
+        s->psy.bitres.alloc /= chans;
+    }
+    s->bitres_alloc[elem] = s->psy.bitres.alloc;
+    return bits;
+}
+
+/**
+ * Search scalefactors and codebooks for an element and apply TNS.
+ * Only touches the element itself and the scratch state of s.
+ */
+static int search_element_coeffs(AVCodecContext *avctx, AACEncContext *s,
+                                 const FFPsyWindowInfo *windows, int elem)
+{
+    const int tag      = s->chan_map[elem + 1];
+    const int chans    = tag == TYPE_CPE ? 2 : 1;
+    const int start_ch = element_start_channel(s, elem);
+    const FFPsyWindowInfo *wi = windows + start_ch;
+    ChannelElement *cpe = &s->cpe[elem];
+    int ch, w, modes = 0;
+
+    s->cur_type = tag;
+    for (ch = 0; ch < chans; ch++) {
+        s->cur_channel = start_ch + ch;
+        if (s->options.pns && s->coder->mark_pns)
+            s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
+        s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
+    }
+    if (chans > 1
+        && wi[0].window_type[0] == wi[1].window_type[0]
+        && wi[0].window_shape   == wi[1].window_shape) {
+
+        cpe->common_window = 1;
+        for (w = 0; w < wi[0].num_windows; w++) {
+            if (wi[0].grouping[w] != wi[1].grouping[w]) {
+                cpe->common_window = 0;
+                break;
+            }
+        }
+    }
+    for (ch = 0; ch < chans; ch++) { /* TNS */
+        SingleChannelElement *sce = &cpe->ch[ch];
+        s->cur_channel = start_ch + ch;
+        if (s->options.tns && s->coder->search_for_tns)
+            s->coder->search_for_tns(s, sce);
+        if (s->options.tns && s->coder->apply_tns_filt)
+            s->coder->apply_tns_filt(s, sce);
+        if (sce->tns.present)
+            modes |= ELEMENT_TNS;
+    }
+    return modes;
+}
+
+/**
+ * Search PNS bands of an element. This consumes the shared noise generator
+ * state, so it must run on the main context in element order.
+ */
+static void search_element_pns(AVCodecContext *avctx, AACEncContext *s, int elem)
+{
+    const int chans    = s->chan_map[elem + 1] == TYPE_CPE ? 2 : 1;
+    const int start_ch = element_start_channel(s, elem);
+    ChannelElement *cpe = &s->cpe[elem];
+    int ch;
+
+    if (!s->options.pns || !s->coder->search_for_pns)
+        return;
+    for (ch = 0; ch < chans; ch++) {
+        s->cur_channel = start_ch + ch;
+        s->coder->search_for_pns(s, avctx, &cpe->ch[ch]);
+    }
+}
+
+/**
+ * Run the intensity stereo, prediction, mid/side and LTP searches of an
+ * element.
+ */
+static int search_element_tools(AVCodecContext *avctx, AACEncContext *s, int elem)
+{
+    const int tag      = s->chan_map[elem + 1];
+    const int chans    = tag == TYPE_CPE ? 2 : 1;
+    const int start_ch = element_start_channel(s, elem);
+    ChannelElement *cpe = &s->cpe[elem];
+    SingleChannelElement *sce;
+    int ch, modes = 0;
+
+    s->cur_type    = tag;
+    s->cur_channel = start_ch;
+    if (s->options.intensity_stereo) { /* Intensity Stereo */
+        if (s->coder->search_for_is)
+            s->coder->search_for_is(s, avctx, cpe);
+        if (cpe->is_mode) modes |= ELEMENT_IS;
+        apply_intensity_stereo(cpe);
+    }
+    if (s->options.pred) { /* Prediction */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = start_ch + ch;
+            if (s->options.pred && s->coder->search_for_pred)
+                s->coder->search_for_pred(s, sce);
+            if (cpe->ch[ch].ics.predictor_present) modes |= ELEMENT_PRED;
+        }
+        s->cur_channel = start_ch;
+        if (s->coder->adjust_common_pred)
+            s->coder->adjust_common_pred(s, cpe);
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = start_ch + ch;
+            if (s->options.pred && s->coder->apply_main_pred)
+                s->coder->apply_main_pred(s, sce);
+        }
+        s->cur_channel = start_ch;
+    }
+    if (s->options.mid_side) { /* Mid/Side stereo */
+        if (s->options.mid_side == -1 && s->coder->search_for_ms)
+            s->coder->search_for_ms(s, cpe);
+        else if (cpe->common_window)
+            memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
+        apply_mid_side_stereo(cpe);
+    }
+    adjust_frame_information(cpe, chans);
+    if (s->options.ltp) { /* LTP */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = start_ch + ch;
+            if (s->coder->search_for_ltp)
+                s->coder->search_for_ltp(s, sce, cpe->common_window);
+            if (sce->ics.ltp.present) modes |= ELEMENT_PRED;
+        }
+        s->cur_channel = start_ch;
+        if (s->coder->adjust_common_ltp)
+            s->coder->adjust_common_ltp(s, cpe);
+    }
+    return modes;
+}
+
+static int transform_element_job(AVCodecContext *avctx, void *arg,
+                                 int jobnr, int threadnr)
+{
+    AACEncContext *s = avctx->priv_data;
+    const ElementJobArg *job = arg;
+
+    return transform_element(avctx, s->thread_ctx[threadnr], job->windows,
+                             jobnr, job->flush);
+}
+
+static int search_element_coeffs_job(AVCodecContext *avctx, void *arg,
+                                     int jobnr, int threadnr)
+{
+    AACEncContext *s   = avctx->priv_data;
+    AACEncContext *ctx = s->thread_ctx[threadnr];
+    const ElementJobArg *job = arg;
+
+    ctx->psy.bitres.alloc = s->bitres_alloc[jobnr];
+    return search_element_coeffs(avctx, ctx, job->windows, jobnr);
+}
+
+static int search_element_tools_job(AVCodecContext *avctx, void *arg,
+                                    int jobnr, int threadnr)
+{
+    AACEncContext *s = avctx->priv_data;
+
+    return search_element_tools(avctx, s->thread_ctx[threadnr], jobnr);
+}
+
+/**
+ * Propagate the frame-level coding state to the per-thread contexts.
+ */
+static void update_thread_contexts(AACEncContext *s)
+{
+    int i;
+    for (i = 1; i < s->nb_thread_ctx; i++) {
+        s->thread_ctx[i]->lambda = s->lambda;
+        s->thread_ctx[i]->psy    = s->psy;
+    }
+}
+
+/**
+ * Run one stage on every element, using slice threads if they are available.
+ * @return the OR of all job return values, or the first error
+ */
+static int execute_elements(AVCodecContext *avctx, AACEncContext *s,
+                            int (*func)(AVCodecContext *c2, void *arg, int jobnr, int threadnr),
+                            ElementJobArg *job)
+{
+    int i, ret[AAC_MAX_CHANNELS], modes = 0;
+
+    update_thread_contexts(s);
+    avctx->execute2(avctx, func, job, ret, s->chan_map[0]);
+    for (i = 0; i < s->chan_map[0]; i++) {
+        if (ret[i] < 0)
+            return ret[i];
+        modes |= ret[i];
+    }
+    return modes;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
     AACEncContext *s = avctx->priv_data;
-    float **samples = s->planar_samples, *samples2, *la, *overlap;
     ChannelElement *cpe;
-    SingleChannelElement *sce;
-    IndividualChannelStream *ics;
-    int i, its, ch, w, chans, tag, start_ch, ret, frame_bits;
+    int i, its, ch, chans, tag, ret, frame_bits;
     int target_bits, rate_bits, too_many_bits, too_few_bits;
     int ms_mode = 0, is_mode = 0, tns_mode = 0, pred_mode = 0;
     int chan_el_counter[4];
     FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
+    ElementJobArg job = { windows, !frame };
 
     /* add current frame to queue */
     if (frame) {
@@ -856,220 +1214,66 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
     if (!avctx->frame_num)
         return 0;
 
-    start_ch = 0;
-    for (i = 0; i < s->chan_map[0]; i++) {
-        FFPsyWindowInfo* wi = windows + start_ch;
-        tag      = s->chan_map[i+1];
-        chans    = tag == TYPE_CPE ? 2 : 1;
-        cpe      = &s->cpe[i];
-        for (ch = 0; ch < chans; ch++) {
-            int k;
-            float clip_avoidance_factor;
-            sce = &cpe->ch[ch];
-            ics = &sce->ics;
-            s->cur_channel = start_ch + ch;
-            overlap  = &samples[s->cur_channel][0];
-            samples2 = overlap + 1024;
-            la       = samples2 + (448+64);
-            if (!frame)
-                la = NULL;
-            if (tag == TYPE_LFE) {
-                wi[ch].window_type[0] = wi[ch].window_type[1] = ONLY_LONG_SEQUENCE;
-                wi[ch].window_shape   = 0;
-                wi[ch].num_windows    = 1;
-                wi[ch].grouping[0]    = 1;
-                wi[ch].clipping[0]    = 0;
-
-                /* Only the lowest 12 coefficients are used in a LFE channel.
-                 * The expression below results in only the bottom 8 coefficients
-                 * being used for 11.025kHz to 16kHz sample rates.
-                 */
-                ics->num_swb = s->samplerate_index >= 8 ? 1 : 3;
-            } else {
-                wi[ch] = s->psy.model->window(&s->psy, samples2, la, s->cur_channel,
-                                              ics->window_sequence[0]);
-            }
-            ics->window_sequence[1] = ics->window_sequence[0];
-            ics->window_sequence[0] = wi[ch].window_type[0];
-            ics->use_kb_window[1]   = ics->use_kb_window[0];
-            ics->use_kb_window[0]   = wi[ch].window_shape;
-            ics->num_windows        = wi[ch].num_windows;
-            ics->swb_sizes          = s->psy.bands    [ics->num_windows == 8];
-            ics->num_swb            = tag == TYPE_LFE ? ics->num_swb : s->psy.num_bands[ics->num_windows == 8];
-            ics->max_sfb            = FFMIN(ics->max_sfb, ics->num_swb);
-            ics->swb_offset         = wi[ch].window_type[0] == EIGHT_SHORT_SEQUENCE ?
-                                        ff_swb_offset_128 [s->samplerate_index]:
-                                        ff_swb_offset_1024[s->samplerate_index];
-            ics->tns_max_bands      = wi[ch].window_type[0] == EIGHT_SHORT_SEQUENCE ?
-                                        ff_tns_max_bands_128 [s->samplerate_index]:
-                                        ff_tns_max_bands_1024[s->samplerate_index];
-
-            for (w = 0; w < ics->num_windows; w++)
-                ics->group_len[w] = wi[ch].grouping[w];
-
-            /* Calculate input sample maximums and evaluate clipping risk */
-            clip_avoidance_factor = 0.0f;
-            for (w = 0; w < ics->num_windows; w++) {
-                const float *wbuf = overlap + w * 128;
-                const int wlen = 2048 / ics->num_windows;
-                float max = 0;
-                int j;
-                /* mdct input is 2 * output */
-                for (j = 0; j < wlen; j++)
-                    max = FFMAX(max, fabsf(wbuf[j]));
-                wi[ch].clipping[w] = max;
-            }
-            for (w = 0; w < ics->num_windows; w++) {
-                if (wi[ch].clipping[w] > CLIP_AVOIDANCE_FACTOR) {
-                    ics->window_clipping[w] = 1;
-                    clip_avoidance_factor = FFMAX(clip_avoidance_factor, wi[ch].clipping[w]);
-                } else {
-                    ics->window_clipping[w] = 0;
-                }
-            }
-            if (clip_avoidance_factor > CLIP_AVOIDANCE_FACTOR) {
-                ics->clip_avoidance_factor = CLIP_AVOIDANCE_FACTOR / clip_avoidance_factor;
-            } else {
-                ics->clip_avoidance_factor = 1.0f;
-            }
-
-            apply_window_and_mdct(s, sce, overlap);
-
-            if (s->options.ltp && s->coder->update_ltp) {
-                s->coder->update_ltp(s, sce);
-                apply_window[sce->ics.window_sequence[0]](s->fdsp, sce, &sce->ltp_state[0]);
-                s->mdct1024_fn(s->mdct1024, sce->lcoeffs, sce->ret_buf, sizeof(float));
-            }
-
-            for (k = 0; k < 1024; k++) {
-                if (!(fabs(cpe->ch[ch].coeffs[k]) < 1E16)) { // Ensure headroom for energy calculation
-                    av_log(avctx, AV_LOG_ERROR, "Input contains (near) NaN/+-Inf\n");
-                    return AVERROR(EINVAL);
-                }
-            }
-            avoid_clipping(s, sce);
-        }
-        start_ch += chans;
+    if (s->nb_thread_ctx > 1) {
+        if ((ret = execute_elements(avctx, s, transform_element_job, &job)) < 0)
+            return ret;
+    } else {
+        for (i = 0; i < s->chan_map[0]; i++)
+            if ((ret = transform_element(avctx, s, windows, i, !frame)) < 0)
+                return ret;
     }
     if ((ret = ff_alloc_packet(avctx, avpkt, 8192 * s->channels)) < 0)
         return ret;
     frame_bits = its = 0;
     do {
+        /* The coder may retune the psy bandwidth while searching, and the
+         * analysis of the following elements depends on it. Only split the
+         * analysis from the searches once it has stopped changing. */
+        int cutoff = s->psy.cutoff;
+        int modes  = 0;
+
         init_put_bits(&s->pb, avpkt->data, avpkt->size);
 
         if ((avctx->frame_num & 0xFF)==1 && !(avctx->flags & AV_CODEC_FLAG_BITEXACT))
             put_bitstream_info(s, LIBAVCODEC_IDENT);
-        start_ch = 0;
         target_bits = 0;
+        if (s->nb_thread_ctx > 1 && s->psy_cutoff_settled) {
+            for (i = 0; i < s->chan_map[0]; i++)
+                target_bits += analyze_element(avctx, s, windows, i);
+            if ((ret = execute_elements(avctx, s, search_element_coeffs_job, &job)) < 0)
+                return ret;
+            modes |= ret;
+            for (i = 1; i < s->nb_thread_ctx; i++)
+                if (s->thread_ctx[i]->psy.cutoff != cutoff)
+                    s->psy.cutoff = s->thread_ctx[i]->psy.cutoff;
+            for (i = 0; i < s->chan_map[0]; i++)
+                search_element_pns(avctx, s, i);
+            if ((ret = execute_elements(avctx, s, search_element_tools_job, &job)) < 0)
+                return ret;
+            modes |= ret;
+        } else {
+            for (i = 0; i < s->chan_map[0]; i++) {
+                target_bits += analyze_element(avctx, s, windows, i);
+                modes |= search_element_coeffs(avctx, s, windows, i);
+                search_element_pns(avctx, s, i);
+                modes |= search_element_tools(avctx, s, i);
+            }
+        }
+        s->psy_cutoff_settled = s->psy.cutoff == cutoff;
+        if (modes & ELEMENT_TNS)
+            tns_mode = 1;
+        if (modes & ELEMENT_IS)
+            is_mode = 1;
+        if (modes & ELEMENT_PRED)
+            pred_mode = 1;
+
         memset(chan_el_counter, 0, sizeof(chan_el_counter));
         for (i = 0; i < s->chan_map[0]; i++) {
-            FFPsyWindowInfo* wi = windows + start_ch;
-            const float *coeffs[2];
-            tag      = s->chan_map[i+1];
-            chans    = tag == TYPE_CPE ? 2 : 1;
-            cpe      = &s->cpe[i];
-            cpe->common_window = 0;
-            memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
-            memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
+            tag   = s->chan_map[i+1];
+            chans = tag == TYPE_CPE ? 2 : 1;
+            cpe   = &s->cpe[i];
             put_bits(&s->pb, 3, tag);
             put_bits(&s->pb, 4, chan_el_counter[tag]++);
-            for (ch = 0; ch < chans; ch++) {
-                sce = &cpe->ch[ch];
-                coeffs[ch] = sce->coeffs;
-                sce->ics.predictor_present = 0;
-                sce->ics.ltp.present = 0;
-                memset(sce->ics.ltp.used, 0, sizeof(sce->ics.ltp.used));
-                memset(sce->ics.prediction_used, 0, sizeof(sce->ics.prediction_used));
-                memset(&sce->tns, 0, sizeof(TemporalNoiseShaping));
-                for (w = 0; w < 128; w++)
-                    if (sce->band_type[w] > RESERVED_BT)
-                        sce->band_type[w] = 0;
-            }
-            s->psy.bitres.alloc = -1;
-            s->psy.bitres.bits = s->last_frame_pb_count / s->channels;
-            s->psy.model->analyze(&s->psy, start_ch, coeffs, wi);
-            if (s->psy.bitres.alloc > 0) {
-                /* Lambda unused here on purpose, we need to take psy's unscaled allocation */
-                target_bits += s->psy.bitres.alloc
-                    * (s->lambda / (avctx->global_quality ? avctx->global_quality : 120));
-                s->psy.bitres.alloc /= chans;
-            }
-            s->cur_type = tag;
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                if (s->options.pns && s->coder->mark_pns)
-                    s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
-                s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
-            }
-            if (chans > 1
-                && wi[0].window_type[0] == wi[1].window_type[0]
-                && wi[0].window_shape   == wi[1].window_shape) {
-
-                cpe->common_window = 1;
-                for (w = 0; w < wi[0].num_windows; w++) {
-                    if (wi[0].grouping[w] != wi[1].grouping[w]) {
-                        cpe->common_window = 0;
-                        break;
-                    }
-                }
-            }
-            for (ch = 0; ch < chans; ch++) { /* TNS and PNS */
-                sce = &cpe->ch[ch];
-                s->cur_channel = start_ch + ch;
-                if (s->options.tns && s->coder->search_for_tns)
-                    s->coder->search_for_tns(s, sce);
-                if (s->options.tns && s->coder->apply_tns_filt)
-                    s->coder->apply_tns_filt(s, sce);
-                if (sce->tns.present)
-                    tns_mode = 1;
-                if (s->options.pns && s->coder->search_for_pns)
-                    s->coder->search_for_pns(s, avctx, sce);
-            }
-            s->cur_channel = start_ch;
-            if (s->options.intensity_stereo) { /* Intensity Stereo */
-                if (s->coder->search_for_is)
-                    s->coder->search_for_is(s, avctx, cpe);
-                if (cpe->is_mode) is_mode = 1;
-                apply_intensity_stereo(cpe);
-            }
-            if (s->options.pred) { /* Prediction */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->search_for_pred)
-                        s->coder->search_for_pred(s, sce);
-                    if (cpe->ch[ch].ics.predictor_present) pred_mode = 1;
-                }
-                if (s->coder->adjust_common_pred)
-                    s->coder->adjust_common_pred(s, cpe);
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->apply_main_pred)
-                        s->coder->apply_main_pred(s, sce);
-                }
-                s->cur_channel = start_ch;
-            }
-            if (s->options.mid_side) { /* Mid/Side stereo */
-                if (s->options.mid_side == -1 && s->coder->search_for_ms)
-                    s->coder->search_for_ms(s, cpe);
-                else if (cpe->common_window)
-                    memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
-                apply_mid_side_stereo(cpe);
-            }
-            adjust_frame_information(cpe, chans);
-            if (s->options.ltp) { /* LTP */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->coder->search_for_ltp)
-                        s->coder->search_for_ltp(s, sce, cpe->common_window);
-                    if (sce->ics.ltp.present) pred_mode = 1;
-                }
-                s->cur_channel = start_ch;
-                if (s->coder->adjust_common_ltp)
-                    s->coder->adjust_common_ltp(s, cpe);
-            }
             if (chans == 2) {
                 put_bits(&s->pb, 1, cpe->common_window);
                 if (cpe->common_window) {
@@ -1083,10 +1287,9 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                 }
             }
             for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
+                s->cur_channel = element_start_channel(s, i) + ch;
                 encode_individual_channel(avctx, s, &cpe->ch[ch], cpe->common_window);
             }
-            start_ch += chans;
         }
 
         if (avctx->flags & AV_CODEC_FLAG_QSCALE) {
@@ -1184,9 +1387,18 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 static av_cold int aac_encode_end(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
+    int i;
 
     av_log(avctx, AV_LOG_INFO, "Qavg: %.3f\n", s->lambda_count ? s->lambda_sum / s->lambda_count : NAN);
 
+    for (i = 1; i < s->nb_thread_ctx; i++) {
+        AACEncContext *ctx = s->thread_ctx[i];
+        av_tx_uninit(&ctx->mdct1024);
+        av_tx_uninit(&ctx->mdct128);
+        ff_lpc_end(&ctx->lpc);
+        av_freep(&s->thread_ctx[i]);
+    }
+    av_freep(&s->thread_ctx);
     av_tx_uninit(&s->mdct1024);
     av_tx_uninit(&s->mdct128);
     ff_psy_end(&s->psy);
@@ -1200,15 +1412,11 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
     return 0;
 }
 
-static av_cold int dsp_init(AVCodecContext *avctx, AACEncContext *s)
+static av_cold int mdct_init(AACEncContext *s)
 {
     int ret = 0;
     float scale = 32768.0f;
 
-    s->fdsp = avpriv_float_dsp_alloc(avctx->flags & AV_CODEC_FLAG_BITEXACT);
-    if (!s->fdsp)
-        return AVERROR(ENOMEM);
-
     if ((ret = av_tx_init(&s->mdct1024, &s->mdct1024_fn, AV_TX_FLOAT_MDCT, 0,
                           1024, &scale, 0)) < 0)
         return ret;
@@ -1219,6 +1427,55 @@ static av_cold int dsp_init(AVCodecContext *avctx, AACEncContext *s)
     return 0;
 }
 
+static av_cold int dsp_init(AVCodecContext *avctx, AACEncContext *s)
+{
+    s->fdsp = avpriv_float_dsp_alloc(avctx->flags & AV_CODEC_FLAG_BITEXACT);
+    if (!s->fdsp)
+        return AVERROR(ENOMEM);
+
+    return mdct_init(s);
+}
+
+/**
+ * Set up a copy of the encoder for each slice thread. The copies share all
+ * per-channel state with the main context and only own the scratch buffers
+ * and the transform and LPC contexts.
+ */
+static av_cold int init_thread_contexts(AVCodecContext *avctx, AACEncContext *s)
+{
+    int i, ret;
+
+    if (!(avctx->active_thread_type & FF_THREAD_SLICE) ||
+        avctx->thread_count <= 1 || s->chan_map[0] <= 1)
+        return 0;
+
+    s->thread_ctx = av_calloc(avctx->thread_count, sizeof(*s->thread_ctx));
+    if (!s->thread_ctx)
+        return AVERROR(ENOMEM);
+    s->thread_ctx[0] = s;
+    s->nb_thread_ctx = 1;
+
+    for (i = 1; i < avctx->thread_count; i++) {
+        AACEncContext *ctx = av_memdup(s, sizeof(*s));
+        if (!ctx)
+            return AVERROR(ENOMEM);
+        ctx->mdct1024            = NULL;
+        ctx->mdct128             = NULL;
+        ctx->lpc.windowed_buffer = NULL;
+        ctx->thread_ctx          = NULL;
+        ctx->nb_thread_ctx       = 0;
+        s->thread_ctx[s->nb_thread_ctx++] = ctx;
+
+        if ((ret = mdct_init(ctx)) < 0)
+            return ret;
+        if ((ret = ff_lpc_init(&ctx->lpc, 2*avctx->frame_size, TNS_MAX_ORDER,
+                               FF_LPC_TYPE_LEVINSON)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 static av_cold int alloc_buffers(AVCodecContext *avctx, AACEncContext *s)
 {
     int ch;
@@ -1384,7 +1641,7 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
 
     ff_af_queue_init(avctx, &s->afq);
 
-    return 0;
+    return init_thread_contexts(avctx, s);
 }
 
 #define AACENC_FLAGS AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_AUDIO_PARAM
@@ -1422,7 +1679,7 @@ const FFCodec ff_aac_encoder = {
     .p.type         = AVMEDIA_TYPE_AUDIO,
     .p.id           = AV_CODEC_ID_AAC,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
-                      AV_CODEC_CAP_SMALL_LAST_FRAME,
+                      AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(AACEncContext),
     .init           = aac_encode_init,
     FF_CODEC_ENCODE_CB(aac_encode_frame),
@@ -240,6 +240,8 @@ typedef struct AACEncContext {
     float lambda_sum;                            ///< sum(lambda), for Qvg reporting
     int lambda_count;                            ///< count(lambda), for Qvg reporting
     enum RawDataBlockType cur_type;              ///< channel group type cur_channel belongs to
+    int bitres_alloc[16];                        ///< psy bit reservoir allocation of each element
+    int psy_cutoff_settled;                      ///< set once the coder stopped retuning the psy bandwidth
 
     AudioFrameQueue afq;
     DECLARE_ALIGNED(32, int,   qcoefs)[96];      ///< quantized coefficients
@@ -250,6 +252,9 @@ typedef struct AACEncContext {
 
     AACEncDSPContext aacdsp;
 
+    struct AACEncContext **thread_ctx;           ///< per-thread copies for the element searches, [0] is this context
+    int nb_thread_ctx;
+
     struct {
         float *samples;
     } buffer;
@@ -671,6 +671,16 @@ static int get_pixel_format(AVCodecContext *avctx)
     if (!avctx->hwaccel) {
         av_log(avctx, AV_LOG_ERROR, "Your platform doesn't support"
                " hardware accelerated AV1 decoding.\n");
+#if CONFIG_LIBDAV1D_DECODER
+        av_log(avctx, AV_LOG_ERROR, "The native AV1 decoder has no software"
+               " decoding path, use the libdav1d decoder instead.\n");
+#elif CONFIG_LIBAOM_AV1_DECODER
+        av_log(avctx, AV_LOG_ERROR, "The native AV1 decoder has no software"
+               " decoding path, use the libaom-av1 decoder instead.\n");
+#else
+        av_log(avctx, AV_LOG_ERROR, "The native AV1 decoder has no software"
+               " decoding path, rebuild with libdav1d for software decoding.\n");
+#endif
         avctx->pix_fmt = AV_PIX_FMT_NONE;
         return AVERROR(ENOSYS);
     }
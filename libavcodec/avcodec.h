@@ -2086,6 +2086,18 @@ typedef struct AVCodecContext {
      */
     AVFrameSideData  **decoded_side_data;
     int             nb_decoded_side_data;
+
+    /**
+     * If nonzero and frame threading is used, run the decoding work of this
+     * context on a worker pool shared by all codec contexts with this option
+     * set, instead of on thread_count threads owned by this context.
+     * The frames of this context are then decoded one after the other, and
+     * thread_count sets the number of packets that can be queued.
+     *
+     * - encoding: unused
+     * - decoding: Set by user before avcodec_open2().
+     */
+    int shared_frame_threads;
 } AVCodecContext;
 
 /**
@@ -21,7 +21,9 @@
 #include "config.h"
 
 #include <stdbool.h>
+#include <string.h>
 
+#include "libavutil/error.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
 
@@ -43,8 +45,10 @@
 
 #endif //!HAVE_THREADS
 
+typedef struct ExecutorPool ExecutorPool;
+
 typedef struct ThreadInfo {
-    FFExecutor *e;
+    ExecutorPool *p;
     ExecutorThread thread;
 } ThreadInfo;
 
@@ -53,21 +57,50 @@ typedef struct Queue {
     FFTask *tail;
 } Queue;
 
-struct FFExecutor {
-    FFTaskCallbacks cb;
+/**
+ * Worker threads and their local contexts. A pool is either private to one
+ * executor or shared by every executor allocated by ff_executor_alloc_shared()
+ * with compatible parameters.
+ */
+struct ExecutorPool {
     int thread_count;
-    bool recursive;
+    int local_context_size;
+    int priorities;
+    int (*run)(FFTask *t, void *local_context, void *user_data);
+    int shared;
 
     ThreadInfo *threads;
     uint8_t *local_contexts;
 
     AVMutex lock;
     AVCond cond;
+    AVCond idle;                //signaled when a detaching executor has no running task
     int die;
 
+    // protected by lock
+    FFExecutor **executors;
+    int nb_executors;
+    int next;                   //round-robin cursor into executors
+
+    // protected by shared_lock
+    int refcount;
+    ExecutorPool *next_shared;
+};
+
+struct FFExecutor {
+    FFTaskCallbacks cb;
+    ExecutorPool *p;
+    bool recursive;
+    bool detaching;
+
+    // protected by p->lock
     Queue *q;
+    int nb_running;
 };
 
+static AVMutex shared_lock = AV_MUTEX_INITIALIZER;
+static ExecutorPool *shared_pools;
+
 static FFTask* remove_task(Queue *q)
 {
     FFTask *t = q->head;
@@ -89,20 +122,39 @@ static void add_task(Queue *q, FFTask *t)
         q->tail = q->tail->next = t;
 }
 
-static int run_one_task(FFExecutor *e, void *lc)
+// Pick the next task from the highest non-empty priority. Executors sharing
+// the pool are visited round-robin so a busy one cannot starve the others.
+static FFTask *pick_task(ExecutorPool *p, FFExecutor **owner)
 {
-    FFTaskCallbacks *cb = &e->cb;
-    FFTask *t = NULL;
+    for (int i = 0; i < p->priorities; i++) {
+        for (int j = 0; j < p->nb_executors; j++) {
+            const int idx  = (p->next + j) % p->nb_executors;
+            FFExecutor *e  = p->executors[idx];
+            FFTask *t      = remove_task(e->q + i);
+            if (t) {
+                p->next = (idx + 1) % p->nb_executors;
+                *owner  = e;
+                return t;
+            }
+        }
+    }
+    return NULL;
+}
 
-    for (int i = 0; i < e->cb.priorities && !t; i++)
-        t = remove_task(e->q + i);
+static int run_one_task(ExecutorPool *p, void *lc)
+{
+    FFExecutor *e;
+    FFTask *t = pick_task(p, &e);
 
     if (t) {
-        if (e->thread_count > 0)
-            ff_mutex_unlock(&e->lock);
-        cb->run(t, lc, cb->user_data);
-        if (e->thread_count > 0)
-            ff_mutex_lock(&e->lock);
+        e->nb_running++;
+        if (p->thread_count > 0)
+            ff_mutex_unlock(&p->lock);
+        p->run(t, lc, e->cb.user_data);
+        if (p->thread_count > 0)
+            ff_mutex_lock(&p->lock);
+        if (!--e->nb_running && e->detaching)
+            ff_cond_broadcast(&p->idle);
         return 1;
     }
     return 0;
@@ -111,52 +163,166 @@ static int run_one_task(FFExecutor *e, void *lc)
 #if HAVE_THREADS
 static void *executor_worker_task(void *data)
 {
-    ThreadInfo *ti = (ThreadInfo*)data;
-    FFExecutor *e  = ti->e;
-    void *lc       = e->local_contexts + (ti - e->threads) * e->cb.local_context_size;
+    ThreadInfo *ti   = (ThreadInfo*)data;
+    ExecutorPool *p  = ti->p;
+    void *lc         = p->local_contexts + (ti - p->threads) * p->local_context_size;
 
-    ff_mutex_lock(&e->lock);
+    ff_mutex_lock(&p->lock);
     while (1) {
-        if (e->die) break;
+        if (p->die) break;
 
-        if (!run_one_task(e, lc)) {
+        if (!run_one_task(p, lc)) {
             //no task in one loop
-            ff_cond_wait(&e->cond, &e->lock);
+            ff_cond_wait(&p->cond, &p->lock);
         }
     }
-    ff_mutex_unlock(&e->lock);
+    ff_mutex_unlock(&p->lock);
     return NULL;
 }
 #endif
 
-static void executor_free(FFExecutor *e, const int has_lock, const int has_cond)
+static void pool_free(ExecutorPool *p, const int has_lock, const int has_cond)
 {
-    if (e->thread_count) {
+    if (p->thread_count) {
         //signal die
-        ff_mutex_lock(&e->lock);
-        e->die = 1;
-        ff_cond_broadcast(&e->cond);
-        ff_mutex_unlock(&e->lock);
+        ff_mutex_lock(&p->lock);
+        p->die = 1;
+        ff_cond_broadcast(&p->cond);
+        ff_mutex_unlock(&p->lock);
 
-        for (int i = 0; i < e->thread_count; i++)
-            executor_thread_join(e->threads[i].thread, NULL);
+        for (int i = 0; i < p->thread_count; i++)
+            executor_thread_join(p->threads[i].thread, NULL);
+    }
+    if (has_cond) {
+        ff_cond_destroy(&p->cond);
+        ff_cond_destroy(&p->idle);
     }
-    if (has_cond)
-        ff_cond_destroy(&e->cond);
     if (has_lock)
-        ff_mutex_destroy(&e->lock);
+        ff_mutex_destroy(&p->lock);
 
-    av_free(e->threads);
-    av_free(e->q);
-    av_free(e->local_contexts);
+    av_free(p->threads);
+    av_free(p->local_contexts);
+    av_free(p->executors);
 
-    av_free(e);
+    av_free(p);
 }
 
-FFExecutor* ff_executor_alloc(const FFTaskCallbacks *cb, int thread_count)
+static ExecutorPool *pool_alloc(const FFTaskCallbacks *cb, int thread_count)
 {
-    FFExecutor *e;
+    ExecutorPool *p;
     int has_lock = 0, has_cond = 0;
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return NULL;
+    p->local_context_size = cb->local_context_size;
+    p->priorities         = cb->priorities;
+    p->run                = cb->run;
+    p->refcount           = 1;
+
+    p->local_contexts = av_calloc(FFMAX(thread_count, 1), p->local_context_size);
+    if (!p->local_contexts)
+        goto free_pool;
+
+    p->threads = av_calloc(FFMAX(thread_count, 1), sizeof(*p->threads));
+    if (!p->threads)
+        goto free_pool;
+
+    if (!thread_count)
+        return p;
+
+    has_lock = !ff_mutex_init(&p->lock, NULL);
+    has_cond = !ff_cond_init(&p->cond, NULL);
+    if (has_cond && ff_cond_init(&p->idle, NULL)) {
+        ff_cond_destroy(&p->cond);
+        has_cond = 0;
+    }
+
+    if (!has_lock || !has_cond)
+        goto free_pool;
+
+    for (/* nothing */; p->thread_count < thread_count; p->thread_count++) {
+        ThreadInfo *ti = p->threads + p->thread_count;
+        ti->p = p;
+        if (executor_thread_create(&ti->thread, NULL, executor_worker_task, ti))
+            goto free_pool;
+    }
+    return p;
+
+free_pool:
+    pool_free(p, has_lock, has_cond);
+    return NULL;
+}
+
+static void pool_unref(ExecutorPool *p)
+{
+    int thread_count = p->thread_count;
+
+    if (p->shared) {
+        ff_mutex_lock(&shared_lock);
+        if (--p->refcount) {
+            ff_mutex_unlock(&shared_lock);
+            return;
+        }
+        for (ExecutorPool **pp = &shared_pools; *pp; pp = &(*pp)->next_shared) {
+            if (*pp == p) {
+                *pp = p->next_shared;
+                break;
+            }
+        }
+        ff_mutex_unlock(&shared_lock);
+    }
+    pool_free(p, thread_count, thread_count);
+}
+
+static int attach(ExecutorPool *p, FFExecutor *e)
+{
+    int ret = 0;
+
+    if (p->thread_count)
+        ff_mutex_lock(&p->lock);
+    if (av_dynarray_add_nofree(&p->executors, &p->nb_executors, e) < 0)
+        ret = AVERROR(ENOMEM);
+    if (p->thread_count)
+        ff_mutex_unlock(&p->lock);
+
+    if (!ret)
+        e->p = p;
+    return ret;
+}
+
+static void detach(FFExecutor *e)
+{
+    ExecutorPool *p = e->p;
+
+    if (p->thread_count)
+        ff_mutex_lock(&p->lock);
+
+    e->detaching = true;
+    while (p->thread_count && e->nb_running)
+        ff_cond_wait(&p->idle, &p->lock);
+
+    for (int i = 0; i < p->nb_executors; i++) {
+        if (p->executors[i] == e) {
+            memmove(p->executors + i, p->executors + i + 1,
+                    (p->nb_executors - i - 1) * sizeof(*p->executors));
+            p->nb_executors--;
+            if (p->next > i)
+                p->next--;
+            if (p->next >= p->nb_executors)
+                p->next = 0;
+            break;
+        }
+    }
+
+    if (p->thread_count)
+        ff_mutex_unlock(&p->lock);
+}
+
+static FFExecutor *executor_alloc(const FFTaskCallbacks *cb)
+{
+    FFExecutor *e;
+
     if (!cb || !cb->user_data || !cb->run || !cb->priorities)
         return NULL;
 
@@ -165,68 +331,118 @@ FFExecutor* ff_executor_alloc(const FFTaskCallbacks *cb, int thread_count)
         return NULL;
     e->cb = *cb;
 
-    e->local_contexts = av_calloc(FFMAX(thread_count, 1), e->cb.local_context_size);
-    if (!e->local_contexts)
-        goto free_executor;
-
     e->q = av_calloc(e->cb.priorities, sizeof(Queue));
-    if (!e->q)
+    if (!e->q) {
+        av_free(e);
+        return NULL;
+    }
+    return e;
+}
+
+FFExecutor* ff_executor_alloc(const FFTaskCallbacks *cb, int thread_count)
+{
+    ExecutorPool *p;
+    FFExecutor *e = executor_alloc(cb);
+    if (!e)
+        return NULL;
+
+    p = pool_alloc(cb, thread_count);
+    if (!p)
         goto free_executor;
 
-    e->threads = av_calloc(FFMAX(thread_count, 1), sizeof(*e->threads));
-    if (!e->threads)
+    if (attach(p, e) < 0) {
+        pool_free(p, p->thread_count, p->thread_count);
         goto free_executor;
+    }
+    return e;
 
-    if (!thread_count)
-        return e;
+free_executor:
+    av_free(e->q);
+    av_free(e);
+    return NULL;
+}
 
-    has_lock = !ff_mutex_init(&e->lock, NULL);
-    has_cond = !ff_cond_init(&e->cond, NULL);
+FFExecutor* ff_executor_alloc_shared(const FFTaskCallbacks *cb, int thread_count)
+{
+    ExecutorPool *p;
+    FFExecutor *e;
 
-    if (!has_lock || !has_cond)
+    if (!thread_count || !HAVE_THREADS)
+        return ff_executor_alloc(cb, thread_count);
+
+    e = executor_alloc(cb);
+    if (!e)
+        return NULL;
+
+    ff_mutex_lock(&shared_lock);
+    for (p = shared_pools; p; p = p->next_shared) {
+        if (p->thread_count       == thread_count           &&
+            p->local_context_size == cb->local_context_size &&
+            p->priorities         == cb->priorities         &&
+            p->run                == cb->run) {
+            p->refcount++;
+            break;
+        }
+    }
+    if (!p) {
+        p = pool_alloc(cb, thread_count);
+        if (p) {
+            p->shared      = 1;
+            p->next_shared = shared_pools;
+            shared_pools   = p;
+        }
+    }
+    ff_mutex_unlock(&shared_lock);
+
+    if (!p)
         goto free_executor;
 
-    for (/* nothing */; e->thread_count < thread_count; e->thread_count++) {
-        ThreadInfo *ti = e->threads + e->thread_count;
-        ti->e = e;
-        if (executor_thread_create(&ti->thread, NULL, executor_worker_task, ti))
-            goto free_executor;
+    if (attach(p, e) < 0) {
+        pool_unref(p);
+        goto free_executor;
     }
     return e;
 
 free_executor:
-    executor_free(e, has_lock, has_cond);
+    av_free(e->q);
+    av_free(e);
     return NULL;
 }
 
 void ff_executor_free(FFExecutor **executor)
 {
-    int thread_count;
+    FFExecutor *e;
 
     if (!executor || !*executor)
         return;
-    thread_count = (*executor)->thread_count;
-    executor_free(*executor, thread_count, thread_count);
-    *executor = NULL;
+    e = *executor;
+
+    detach(e);
+    pool_unref(e->p);
+
+    av_free(e->q);
+    av_freep(executor);
 }
 
 void ff_executor_execute(FFExecutor *e, FFTask *t)
 {
-    if (e->thread_count)
-        ff_mutex_lock(&e->lock);
+    ExecutorPool *p = e->p;
+
+    if (p->thread_count)
+        ff_mutex_lock(&p->lock);
     if (t)
         add_task(e->q + t->priority % e->cb.priorities, t);
-    if (e->thread_count) {
-        ff_cond_signal(&e->cond);
-        ff_mutex_unlock(&e->lock);
+    if (p->thread_count) {
+        ff_cond_signal(&p->cond);
+        ff_mutex_unlock(&p->lock);
     }
 
-    if (!e->thread_count || !HAVE_THREADS) {
+    if (!p->thread_count || !HAVE_THREADS) {
         if (e->recursive)
             return;
         e->recursive = true;
         // We are running in a single-threaded environment, so we must handle all tasks ourselves
-        while (run_one_task(e, e->local_contexts))
+        while (run_one_task(p, p->local_contexts))
             /* nothing */;
         e->recursive = false;
     }
@@ -55,8 +55,25 @@ typedef struct FFTaskCallbacks {
  */
 FFExecutor* ff_executor_alloc(const FFTaskCallbacks *callbacks, int thread_count);
 
+/**
+ * Alloc executor sharing its worker threads with other executors
+ *
+ * All executors allocated by this function with the same thread_count and the same
+ * local_context_size, priorities and run callback use one process-wide set of worker
+ * threads. Each executor keeps its own task queues; among the ready tasks of the
+ * highest priority, the executors are served round-robin.
+ * The worker threads are released when the last executor using them is freed.
+ *
+ * @param callbacks callback structure for executor
+ * @param thread_count worker thread number, 0 is the same as ff_executor_alloc(callbacks, 0)
+ * @return return the executor
+ */
+FFExecutor* ff_executor_alloc_shared(const FFTaskCallbacks *callbacks, int thread_count);
+
 /**
  * Free executor
+ * The caller must make sure no task of this executor is still queued. A shared executor
+ * waits for its running tasks to finish before detaching from the worker threads.
  * @param e  pointer to executor
  */
 void ff_executor_free(FFExecutor **e);
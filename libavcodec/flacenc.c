@@ -49,6 +49,9 @@
 #define MIN_LPC_SHIFT       0
 #define MAX_LPC_SHIFT      15
 
+/* each job holds a full copy of FlacEncodeContext, several MB */
+#define MAX_JOBS            8
+
 enum CodingMode {
     CODING_MODE_RICE  = 4,
     CODING_MODE_RICE2 = 5,
@@ -103,6 +106,15 @@ typedef struct FlacFrame {
     int verbatim_only;
 } FlacFrame;
 
+struct FlacEncodeContext;
+
+typedef struct FlacEncodeJob {
+    struct FlacEncodeContext *ctx;  ///< private encoder state for one frame of a batch
+    AVPacket *pkt;                  ///< timestamps and opaque data of the input frame
+    uint8_t *buf;                   ///< coded frame
+    int size;                       ///< size of the coded frame
+} FlacEncodeJob;
+
 typedef struct FlacEncodeContext {
     AVClass *class;
     PutBitContext pb;
@@ -129,6 +141,13 @@ typedef struct FlacEncodeContext {
 
     int flushed;
     int64_t next_pts;
+
+    /* frames encoded in parallel with slice threads, used as a ring */
+    FlacEncodeJob *jobs;
+    int nb_jobs;
+    int job_head;                   ///< next coded frame to output
+    int nb_coded;                   ///< frames coded but not output yet
+    int nb_queued;                  ///< frames queued after the coded ones
 } FlacEncodeContext;
 
 
@@ -267,6 +286,47 @@ static av_cold void dprint_compression_options(FlacEncodeContext *s)
 }
 
 
+/**
+ * Allocate one copy of the encoder state per frame of a batch. Frames do not
+ * depend on each other apart from the header frame number, so a batch of
+ * them can be coded in parallel.
+ */
+static av_cold int init_jobs(AVCodecContext *avctx, FlacEncodeContext *s)
+{
+    int i, ret;
+
+    if (!(avctx->active_thread_type & FF_THREAD_SLICE) || avctx->thread_count <= 1)
+        return 0;
+
+    s->nb_jobs = FFMIN(avctx->thread_count, MAX_JOBS);
+    s->jobs = av_calloc(s->nb_jobs, sizeof(*s->jobs));
+    if (!s->jobs) {
+        s->nb_jobs = 0;
+        return AVERROR(ENOMEM);
+    }
+
+    for (i = 0; i < s->nb_jobs; i++) {
+        FlacEncodeJob *job = &s->jobs[i];
+
+        job->pkt = av_packet_alloc();
+        job->buf = av_malloc(s->max_framesize);
+        job->ctx = av_memdup(s, sizeof(*s));
+        if (!job->pkt || !job->buf || !job->ctx)
+            return AVERROR(ENOMEM);
+        job->ctx->lpc_ctx.windowed_buffer = NULL;
+        job->ctx->jobs                    = NULL;
+        job->ctx->nb_jobs                 = 0;
+
+        ret = ff_lpc_init(&job->ctx->lpc_ctx, avctx->frame_size,
+                          s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+
 static av_cold int flac_encode_init(AVCodecContext *avctx)
 {
     int freq = avctx->sample_rate;
@@ -467,12 +527,15 @@ static av_cold int flac_encode_init(AVCodecContext *avctx)
     ret = ff_lpc_init(&s->lpc_ctx, avctx->frame_size,
                       s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
 
+    if (ret < 0)
+        return ret;
+
     ff_bswapdsp_init(&s->bdsp);
     ff_flacencdsp_init(&s->flac_dsp);
 
     dprint_compression_options(s);
 
-    return ret;
+    return init_jobs(avctx, s);
 }
 
 
@@ -1561,9 +1624,9 @@ static void write_frame_footer(FlacEncodeContext *s)
 }
 
 
-static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
+static int write_frame(FlacEncodeContext *s, uint8_t *buf, int buf_size)
 {
-    init_put_bits(&s->pb, avpkt->data, avpkt->size);
+    init_put_bits(&s->pb, buf, buf_size);
     write_frame_header(s);
     write_subframes(s);
     write_frame_footer(s);
@@ -1616,6 +1679,141 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
 }
 
 
+/**
+ * Encode the samples already loaded into s->frame.
+ * @return the size of the coded frame, or a negative error code
+ */
+static int encode_block(FlacEncodeContext *s)
+{
+    int frame_bytes;
+
+    channel_decorrelation(s);
+
+    remove_wasted_bits(s);
+
+    frame_bytes = encode_frame(s);
+
+    /* Fall back on verbatim mode if the compressed frame is larger than it
+       would be if encoded uncompressed. */
+    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
+        s->frame.verbatim_only = 1;
+        frame_bytes = encode_frame(s);
+        if (frame_bytes < 0) {
+            av_log(s->avctx, AV_LOG_ERROR, "Bad frame count\n");
+            return frame_bytes;
+        }
+    }
+
+    return frame_bytes;
+}
+
+
+static int set_packet_props(AVCodecContext *avctx, AVPacket *pkt,
+                            const AVFrame *frame)
+{
+    pkt->pts      = frame->pts;
+    pkt->duration = frame->duration ? frame->duration :
+                    ff_samples_to_time_base(avctx, frame->nb_samples);
+
+    return ff_encode_reordered_opaque(avctx, pkt, frame);
+}
+
+
+static void update_framesize_stats(FlacEncodeContext *s, int out_bytes)
+{
+    if (out_bytes > s->max_encoded_framesize)
+        s->max_encoded_framesize = out_bytes;
+    if (out_bytes < s->min_framesize)
+        s->min_framesize = out_bytes;
+}
+
+
+/**
+ * Load a frame into the next free job. Everything that depends on the
+ * previous frames (frame number, MD5 sum, timestamps) is handled here so
+ * that the jobs themselves are independent.
+ */
+static int queue_frame(AVCodecContext *avctx, const AVFrame *frame)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacEncodeJob *job   = &s->jobs[(s->job_head + s->nb_coded + s->nb_queued) %
+                                    s->nb_jobs];
+    FlacEncodeContext *ctx = job->ctx;
+    int ret;
+
+    /* change max_framesize for small final frame */
+    if (frame->nb_samples < s->frame.blocksize) {
+        s->max_framesize = flac_get_max_frame_size(frame->nb_samples,
+                                                   s->channels,
+                                                   avctx->bits_per_raw_sample);
+    }
+    s->frame.blocksize = frame->nb_samples;
+
+    ctx->frame_count   = s->frame_count++;
+    ctx->max_framesize = s->max_framesize;
+    init_frame(ctx, frame->nb_samples);
+    copy_samples(ctx, frame->data[0]);
+
+    s->sample_count += frame->nb_samples;
+    if ((ret = update_md5_sum(s, frame->data[0])) < 0) {
+        av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+        return ret;
+    }
+
+    s->next_pts = frame->pts + ff_samples_to_time_base(avctx, frame->nb_samples);
+
+    if ((ret = set_packet_props(avctx, job->pkt, frame)) < 0)
+        return ret;
+
+    s->nb_queued++;
+    return 0;
+}
+
+
+static int encode_frame_job(AVCodecContext *avctx, void *arg,
+                            int jobnr, int threadnr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacEncodeJob *job   = &s->jobs[(s->job_head + s->nb_coded + jobnr) %
+                                    s->nb_jobs];
+    int frame_bytes;
+
+    frame_bytes = encode_block(job->ctx);
+    if (frame_bytes < 0) {
+        job->size = frame_bytes;
+        return frame_bytes;
+    }
+
+    job->size = write_frame(job->ctx, job->buf, frame_bytes);
+    return 0;
+}
+
+
+static int output_job(AVCodecContext *avctx, AVPacket *avpkt)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacEncodeJob *job   = &s->jobs[s->job_head];
+    int ret;
+
+    s->job_head = (s->job_head + 1) % s->nb_jobs;
+    s->nb_coded--;
+
+    if (job->size < 0) {
+        av_packet_unref(job->pkt);
+        return job->size;
+    }
+
+    if ((ret = ff_get_encode_buffer(avctx, job->pkt, job->size, 0)) < 0)
+        return ret;
+    memcpy(job->pkt->data, job->buf, job->size);
+    av_packet_move_ref(avpkt, job->pkt);
+
+    update_framesize_stats(s, job->size);
+
+    return 0;
+}
+
+
 static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                              const AVFrame *frame, int *got_packet_ptr)
 {
@@ -1624,6 +1822,27 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
     s = avctx->priv_data;
 
+    if (s->nb_jobs) {
+        if (frame && (ret = queue_frame(avctx, frame)) < 0)
+            return ret;
+
+        if (s->nb_queued == s->nb_jobs || (!frame && s->nb_queued)) {
+            avctx->execute2(avctx, encode_frame_job, NULL, NULL, s->nb_queued);
+            s->nb_coded += s->nb_queued;
+            s->nb_queued = 0;
+        }
+
+        if (s->nb_coded) {
+            if ((ret = output_job(avctx, avpkt)) < 0)
+                return ret;
+            *got_packet_ptr = 1;
+            return 0;
+        }
+
+        if (frame)
+            return 0;
+    }
+
     /* when the last block is reached, update the header in extradata */
     if (!frame) {
         s->max_framesize = s->max_encoded_framesize;
@@ -1657,27 +1876,14 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
     copy_samples(s, frame->data[0]);
 
-    channel_decorrelation(s);
-
-    remove_wasted_bits(s);
-
-    frame_bytes = encode_frame(s);
-
-    /* Fall back on verbatim mode if the compressed frame is larger than it
-       would be if encoded uncompressed. */
-    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
-        s->frame.verbatim_only = 1;
-        frame_bytes = encode_frame(s);
-        if (frame_bytes < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
-            return frame_bytes;
-        }
-    }
+    frame_bytes = encode_block(s);
+    if (frame_bytes < 0)
+        return frame_bytes;
 
     if ((ret = ff_get_encode_buffer(avctx, avpkt, frame_bytes, 0)) < 0)
         return ret;
 
-    out_bytes = write_frame(s, avpkt);
+    out_bytes = write_frame(s, avpkt->data, avpkt->size);
 
     s->frame_count++;
     s->sample_count += frame->nb_samples;
@@ -1685,15 +1891,15 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
         av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
         return ret;
     }
-    if (out_bytes > s->max_encoded_framesize)
-        s->max_encoded_framesize = out_bytes;
-    if (out_bytes < s->min_framesize)
-        s->min_framesize = out_bytes;
+    update_framesize_stats(s, out_bytes);
 
     s->next_pts = frame->pts + ff_samples_to_time_base(avctx, frame->nb_samples);
 
     av_shrink_packet(avpkt, out_bytes);
 
+    if ((ret = set_packet_props(avctx, avpkt, frame)) < 0)
+        return ret;
+
     *got_packet_ptr = 1;
     return 0;
 }
@@ -1703,6 +1909,17 @@ static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
     FlacEncodeContext *s = avctx->priv_data;
 
+    for (int i = 0; i < s->nb_jobs; i++) {
+        FlacEncodeJob *job = &s->jobs[i];
+
+        if (job->ctx)
+            ff_lpc_end(&job->ctx->lpc_ctx);
+        av_freep(&job->ctx);
+        av_freep(&job->buf);
+        av_packet_free(&job->pkt);
+    }
+    av_freep(&s->jobs);
+
     av_freep(&s->md5ctx);
     av_freep(&s->md5_buffer);
     ff_lpc_end(&s->lpc_ctx);
@@ -1755,6 +1972,7 @@ const FFCodec ff_flac_encoder = {
     .p.id           = AV_CODEC_ID_FLAC,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
                       AV_CODEC_CAP_SMALL_LAST_FRAME |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
     .priv_data_size = sizeof(FlacEncodeContext),
     .init           = flac_encode_init,
@@ -1764,5 +1982,5 @@ const FFCodec ff_flac_encoder = {
                                                      AV_SAMPLE_FMT_S32,
                                                      AV_SAMPLE_FMT_NONE },
     .p.priv_class   = &flac_encoder_class,
-    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP | FF_CODEC_CAP_EOF_FLUSH,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
 };
@@ -2662,11 +2662,15 @@ static void hls_decode_neighbour(HEVCLocalContext *lc,
     if (pps->tiles_enabled_flag) {
         if (x_ctb > 0 && pps->tile_id[ctb_addr_ts] != pps->tile_id[pps->ctb_addr_rs_to_ts[ctb_addr_rs - 1]])
             lc->boundary_flags |= BOUNDARY_LEFT_TILE;
-        if (x_ctb > 0 && l->tab_slice_address[ctb_addr_rs] != l->tab_slice_address[ctb_addr_rs - 1])
-            lc->boundary_flags |= BOUNDARY_LEFT_SLICE;
         if (y_ctb > 0 && pps->tile_id[ctb_addr_ts] != pps->tile_id[pps->ctb_addr_rs_to_ts[ctb_addr_rs - sps->ctb_width]])
             lc->boundary_flags |= BOUNDARY_UPPER_TILE;
-        if (y_ctb > 0 && l->tab_slice_address[ctb_addr_rs] != l->tab_slice_address[ctb_addr_rs - sps->ctb_width])
+        // with tile threading the neighbouring tile may still be decoding,
+        // the slice edges across tiles are derived once it is done
+        if (!(s->tile_threading && lc->boundary_flags & BOUNDARY_LEFT_TILE) &&
+            x_ctb > 0 && l->tab_slice_address[ctb_addr_rs] != l->tab_slice_address[ctb_addr_rs - 1])
+            lc->boundary_flags |= BOUNDARY_LEFT_SLICE;
+        if (!(s->tile_threading && lc->boundary_flags & BOUNDARY_UPPER_TILE) &&
+            y_ctb > 0 && l->tab_slice_address[ctb_addr_rs] != l->tab_slice_address[ctb_addr_rs - sps->ctb_width])
             lc->boundary_flags |= BOUNDARY_UPPER_SLICE;
     } else {
         if (ctb_addr_in_slice <= 0)
@@ -2725,11 +2729,12 @@ static int hls_decode_entry(HEVCContext *s, GetBitContext *gb)
 
         ctb_addr_ts++;
         ff_hevc_save_states(lc, pps, ctb_addr_ts);
-        ff_hevc_hls_filters(lc, l, pps, x_ctb, y_ctb, ctb_size);
+        if (!l->filter_deferred)
+            ff_hevc_hls_filters(lc, l, pps, x_ctb, y_ctb, ctb_size);
     }
 
     if (x_ctb + ctb_size >= sps->width &&
-        y_ctb + ctb_size >= sps->height)
+        y_ctb + ctb_size >= sps->height && !l->filter_deferred)
         ff_hevc_hls_filter(lc, l, pps, x_ctb, y_ctb, ctb_size);
 
     return ctb_addr_ts;
@@ -2856,25 +2861,8 @@ static int wpp_progress_init(HEVCContext *s, unsigned count)
     return 0;
 }
 
-static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
+static int alloc_local_ctx(HEVCContext *s)
 {
-    const HEVCPPS *const pps = s->pps;
-    const HEVCSPS *const sps = pps->sps;
-    const uint8_t *data = nal->data;
-    int length          = nal->size;
-    int *ret;
-    int64_t offset;
-    int64_t startheader, cmpt = 0;
-    int i, j, res = 0;
-
-    if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * sps->ctb_width >= sps->ctb_width * sps->ctb_height) {
-        av_log(s->avctx, AV_LOG_ERROR, "WPP ctb addresses are wrong (%d %d %d %d)\n",
-            s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets,
-            sps->ctb_width, sps->ctb_height
-        );
-        return AVERROR_INVALIDDATA;
-    }
-
     if (s->avctx->thread_count > s->nb_local_ctx) {
         HEVCLocalContext *tmp = av_malloc_array(s->avctx->thread_count, sizeof(*s->local_ctx));
 
@@ -2898,6 +2886,175 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         s->nb_local_ctx = s->avctx->thread_count;
     }
 
+    return 0;
+}
+
+static int hls_decode_entry_tile(AVCodecContext *avctx, void *arg,
+                                 int job, int thread)
+{
+    HEVCContext *const s = arg;
+    HEVCLocalContext *lc = &s->local_ctx[thread];
+    const HEVCLayerContext *const l = &s->layers[s->cur_layer];
+    const HEVCPPS   *const pps = s->pps;
+    const HEVCSPS   *const sps = pps->sps;
+    int ctb_addr_ts = pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+    int ctb_addr_rs = s->sh.slice_ctb_addr_rs;
+    int tile        = pps->tile_id[ctb_addr_ts] + job;
+    int col         = tile % pps->num_tile_columns;
+    int more_data   = 1;
+    int ret;
+
+    const uint8_t *data      = s->data + s->sh.offset[job];
+    const size_t   data_size = s->sh.size[job];
+
+    if (job) {
+        ctb_addr_rs = pps->tile_pos_rs[tile];
+        ctb_addr_ts = pps->ctb_addr_rs_to_ts[ctb_addr_rs];
+    }
+
+    lc->end_of_tiles_x = (pps->col_bd[col] + pps->column_width[col]) << sps->log2_ctb_size;
+
+    while (more_data && ctb_addr_ts < sps->ctb_size &&
+           pps->tile_id[ctb_addr_ts] == tile) {
+        int x_ctb, y_ctb;
+
+        ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+        x_ctb = (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / sps->ctb_width) << sps->log2_ctb_size;
+
+        hls_decode_neighbour(lc, l, pps, sps, x_ctb, y_ctb, ctb_addr_ts);
+
+        ret = ff_hevc_cabac_init(lc, pps, ctb_addr_ts, data, data_size, 1);
+        if (ret < 0)
+            goto error;
+
+        hls_sao_param(lc, l, pps, sps,
+                      x_ctb >> sps->log2_ctb_size, y_ctb >> sps->log2_ctb_size);
+
+        l->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        l->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        l->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
+        more_data = hls_coding_quadtree(lc, l, pps, sps, x_ctb, y_ctb, sps->log2_ctb_size, 0);
+        if (more_data < 0) {
+            ret = more_data;
+            goto error;
+        }
+
+        ctb_addr_ts++;
+    }
+
+    // every tile but the last one must be complete
+    if (!more_data != (job == s->sh.num_entry_point_offsets)) {
+        av_log(avctx, AV_LOG_ERROR, "Slice segment end does not match its entry points\n");
+        return AVERROR_INVALIDDATA;
+    }
+
+    if (job == s->sh.num_entry_point_offsets)
+        s->tile_end_thread = thread;
+
+    return 0;
+error:
+    l->tab_slice_address[ctb_addr_rs] = -1;
+    return ret;
+}
+
+static int hls_slice_data_tiles(HEVCContext *s)
+{
+    const HEVCLayerContext *const l = &s->layers[s->cur_layer];
+    const HEVCPPS *const pps = s->pps;
+    const HEVCSPS *const sps = pps->sps;
+    HEVCLocalContext *const lc = &s->local_ctx[0];
+    const HEVCLocalContext *end;
+    int ctb_addr_ts = pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+    int last_tile   = pps->tile_id[ctb_addr_ts] + s->sh.num_entry_point_offsets;
+    int first_qp_group, end_of_tiles_x;
+    int *ret;
+    int i, res = 0;
+
+    ret = av_calloc(s->sh.num_entry_point_offsets + 1, sizeof(*ret));
+    if (!ret)
+        return AVERROR(ENOMEM);
+
+    s->tile_end_thread = 0;
+    s->tile_threading  = 1;
+    s->avctx->execute2(s->avctx, hls_decode_entry_tile, s, ret, s->sh.num_entry_point_offsets + 1);
+    s->tile_threading  = 0;
+
+    for (i = 0; i <= s->sh.num_entry_point_offsets; i++) {
+        if (ret[i] < 0) {
+            res = ret[i];
+            break;
+        }
+    }
+    av_free(ret);
+
+    end            = &s->local_ctx[s->tile_end_thread];
+    first_qp_group = end->first_qp_group;
+    end_of_tiles_x = end->end_of_tiles_x;
+
+    // derive the boundary strengths of the edges between the tiles
+    if (!s->sh.disable_deblocking_filter_flag) {
+        for (; ctb_addr_ts < sps->ctb_size && pps->tile_id[ctb_addr_ts] <= last_tile; ctb_addr_ts++) {
+            int ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+            int x_ctb = (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size;
+            int y_ctb = (ctb_addr_rs / sps->ctb_width) << sps->log2_ctb_size;
+
+            if (l->tab_slice_address[ctb_addr_rs] != s->sh.slice_addr)
+                continue;
+
+            hls_decode_neighbour(lc, l, pps, sps, x_ctb, y_ctb, ctb_addr_ts);
+            ff_hevc_tile_boundary_strengths(lc, l, pps, x_ctb, y_ctb);
+        }
+    }
+
+    // continue any following slice segment from the end of the last tile
+    if (end != lc) {
+        memcpy(lc->cabac_state, end->cabac_state, sizeof(lc->cabac_state));
+        memcpy(lc->stat_coeff,  end->stat_coeff,  sizeof(lc->stat_coeff));
+        lc->qp_y     = end->qp_y;
+        lc->qPy_pred = end->qPy_pred;
+    }
+    lc->first_qp_group = first_qp_group;
+    lc->end_of_tiles_x = end_of_tiles_x;
+
+    return res;
+}
+
+static int hls_slice_data_parallel(HEVCContext *s, const H2645NAL *nal)
+{
+    const HEVCPPS *const pps = s->pps;
+    const HEVCSPS *const sps = pps->sps;
+    const uint8_t *data = nal->data;
+    int length          = nal->size;
+    int *ret;
+    int64_t offset;
+    int64_t startheader, cmpt = 0;
+    int i, j, res = 0;
+
+    if (pps->entropy_coding_sync_enabled_flag) {
+        if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * sps->ctb_width >= sps->ctb_width * sps->ctb_height) {
+            av_log(s->avctx, AV_LOG_ERROR, "WPP ctb addresses are wrong (%d %d %d %d)\n",
+                s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets,
+                sps->ctb_width, sps->ctb_height
+            );
+            return AVERROR_INVALIDDATA;
+        }
+    } else {
+        int tile = pps->tile_id[pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs]];
+
+        if (tile + s->sh.num_entry_point_offsets >= pps->num_tile_columns * pps->num_tile_rows) {
+            av_log(s->avctx, AV_LOG_ERROR, "Tile entry points are wrong (%d %d %d)\n",
+                   tile, s->sh.num_entry_point_offsets,
+                   pps->num_tile_columns * pps->num_tile_rows);
+            return AVERROR_INVALIDDATA;
+        }
+    }
+
+    res = alloc_local_ctx(s);
+    if (res < 0)
+        return res;
+
     offset = s->sh.data_offset;
 
     for (j = 0, cmpt = 0, startheader = offset + s->sh.entry_point_offset[0]; j < nal->skipped_bytes; j++) {
@@ -2937,8 +3094,13 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     for (i = 1; i < s->nb_local_ctx; i++) {
         s->local_ctx[i].first_qp_group = 1;
         s->local_ctx[i].qp_y = s->local_ctx[0].qp_y;
+        s->local_ctx[i].tu.cu_qp_offset_cb = 0;
+        s->local_ctx[i].tu.cu_qp_offset_cr = 0;
     }
 
+    if (!pps->entropy_coding_sync_enabled_flag)
+        return hls_slice_data_tiles(s);
+
     atomic_store(&s->wpp_err, 0);
     res = wpp_progress_init(s, s->sh.num_entry_point_offsets + 1);
     if (res < 0)
@@ -2948,8 +3110,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     if (!ret)
         return AVERROR(ENOMEM);
 
-    if (pps->entropy_coding_sync_enabled_flag)
-        s->avctx->execute2(s->avctx, hls_decode_entry_wpp, s->local_ctx, ret, s->sh.num_entry_point_offsets + 1);
+    s->avctx->execute2(s->avctx, hls_decode_entry_wpp, s->local_ctx, ret, s->sh.num_entry_point_offsets + 1);
 
     for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
         res += ret[i];
@@ -3007,7 +3168,15 @@ static int decode_slice_data(HEVCContext *s, const HEVCLayerContext *l,
     if (s->avctx->active_thread_type == FF_THREAD_SLICE  &&
         s->sh.num_entry_point_offsets > 0                &&
         pps->num_tile_rows == 1 && pps->num_tile_columns == 1)
-        return hls_slice_data_wpp(s, nal);
+        return hls_slice_data_parallel(s, nal);
+
+    // tiles are decoded in parallel when the slice segment starts a tile
+    if (l->filter_deferred && s->sh.num_entry_point_offsets > 0) {
+        int ctb_addr_ts = pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+
+        if (!ctb_addr_ts || pps->tile_id[ctb_addr_ts] != pps->tile_id[ctb_addr_ts - 1])
+            return hls_slice_data_parallel(s, nal);
+    }
 
     return hls_decode_entry(s, gb);
 }
@@ -3241,6 +3410,16 @@ static int hevc_frame_start(HEVCContext *s, HEVCLayerContext *l,
     if (pps->tiles_enabled_flag)
         s->local_ctx[0].end_of_tiles_x = pps->column_width[0] << sps->log2_ctb_size;
 
+    // with slice threading, tiles without WPP are decoded in parallel and
+    // the in-loop filters run over the whole picture afterwards; the filters
+    // of 16x16 CTBs reach across more than one CTB for chroma, so these stay
+    // in decoding order
+    l->filter_deferred = s->avctx->active_thread_type == FF_THREAD_SLICE &&
+                         !s->avctx->hwaccel && s->layers_active_decode == 1 &&
+                         pps->tiles_enabled_flag && !pps->entropy_coding_sync_enabled_flag &&
+                         pps->num_tile_columns * pps->num_tile_rows > 1 &&
+                         sps->log2_ctb_size > 4;
+
     if (new_sequence) {
         ret = ff_hevc_output_frames(s, prev_layers_active_decode, prev_layers_active_output,
                                     0, 0, s->sh.no_output_of_prior_pics_flag);
@@ -3401,6 +3580,48 @@ static int verify_md5(HEVCContext *s, AVFrame *frame)
     return err;
     }
 
+static int hls_filter_row(AVCodecContext *avctx, void *arg, int job, int thread)
+{
+    HEVCContext *const s = arg;
+    HEVCLocalContext *lc = &s->local_ctx[thread];
+    const HEVCLayerContext *const l = &s->layers[s->cur_layer];
+    const HEVCPPS *const pps = l->cur_frame->pps;
+    const HEVCSPS *const sps = pps->sps;
+    int ctb_size = 1 << sps->log2_ctb_size;
+    int y_ctb    = job << sps->log2_ctb_size;
+
+    // same two CTB lag to the row above as in WPP decoding
+    for (int x = 0; x < sps->ctb_width; x++) {
+        if (job)
+            ff_thread_progress_await(&s->wpp_progress[job - 1],
+                                     FFMIN(x + 2, sps->ctb_width));
+        ff_hevc_hls_filter(lc, l, pps, x << sps->log2_ctb_size, y_ctb, ctb_size);
+        ff_thread_progress_report(&s->wpp_progress[job], x + 1);
+    }
+
+    return 0;
+}
+
+static int hevc_frame_filter(HEVCContext *s, HEVCLayerContext *l)
+{
+    const HEVCSPS *const sps = l->cur_frame->pps->sps;
+    int ret;
+
+    l->filter_deferred = 0;
+
+    ret = alloc_local_ctx(s);
+    if (ret < 0)
+        return ret;
+
+    ret = wpp_progress_init(s, sps->ctb_height);
+    if (ret < 0)
+        return ret;
+
+    s->avctx->execute2(s->avctx, hls_filter_row, s, NULL, sps->ctb_height);
+
+    return 0;
+}
+
 static int hevc_frame_end(HEVCContext *s, HEVCLayerContext *l)
 {
     HEVCFrame *out = l->cur_frame;
@@ -3698,6 +3919,12 @@ fail:
         if (!l->cur_frame)
             continue;
 
+        if (l->filter_deferred) {
+            int err = hevc_frame_filter(s, l);
+            if (ret >= 0)
+                ret = err;
+        }
+
         if (ret >= 0)
             ret = hevc_frame_end(s, l);
 
@@ -480,6 +480,10 @@ typedef struct HEVCLayerContext {
     uint8_t                *sao_pixel_buffer_h[3];
     uint8_t                *sao_pixel_buffer_v[3];
 
+    // the in-loop filters of cur_frame run in a separate pass once all of
+    // its slices are decoded, so that its tiles can be decoded in parallel
+    int                     filter_deferred;
+
     struct FFRefStructPool *tab_mvf_pool;
     struct FFRefStructPool *rpl_tab_pool;
 } HEVCLayerContext;
@@ -545,6 +549,12 @@ typedef struct HEVCContext {
 
     atomic_int wpp_err;
 
+    // set while the tiles of a slice segment are decoded in parallel;
+    // boundary strengths of the tile edges are derived afterwards
+    int tile_threading;
+    // local context that decoded the last tile of the slice segment
+    int tile_end_thread;
+
     const uint8_t *data;
 
     H2645Packet pkt;
@@ -703,6 +713,8 @@ void ff_hevc_set_qPy(HEVCLocalContext *lc,
 void ff_hevc_deblocking_boundary_strengths(HEVCLocalContext *lc, const HEVCLayerContext *l,
                                            const HEVCPPS *pps,
                                            int x0, int y0, int log2_trafo_size);
+void ff_hevc_tile_boundary_strengths(HEVCLocalContext *lc, const HEVCLayerContext *l,
+                                     const HEVCPPS *pps, int x_ctb, int y_ctb);
 int ff_hevc_cu_qp_delta_sign_flag(HEVCLocalContext *lc);
 int ff_hevc_cu_qp_delta_abs(HEVCLocalContext *lc);
 int ff_hevc_cu_chroma_qp_offset_flag(HEVCLocalContext *lc);
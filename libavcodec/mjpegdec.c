@@ -53,6 +53,7 @@
 #include "jpeglsdec.h"
 #include "profiles.h"
 #include "put_bits.h"
+#include "thread.h"
 #include "exif.h"
 #include "bytestream.h"
 #include "tiff_common.h"
@@ -753,7 +754,7 @@ int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
         }
 
         av_frame_unref(s->picture_ptr);
-        if (ff_get_buffer(s->avctx, s->picture_ptr, AV_GET_BUFFER_FLAG_REF) < 0)
+        if (ff_thread_get_buffer(s->avctx, s->picture_ptr, AV_GET_BUFFER_FLAG_REF) < 0)
             return -1;
         s->picture_ptr->pict_type = AV_PICTURE_TYPE_I;
         s->picture_ptr->flags |= AV_FRAME_FLAG_KEY;
@@ -813,10 +814,11 @@ int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
     return 0;
 }
 
-static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
+static inline int mjpeg_decode_dc(MJpegDecodeContext *s, GetBitContext *gb,
+                                  int dc_index)
 {
     int code;
-    code = get_vlc2(&s->gb, s->vlcs[0][dc_index].table, 9, 2);
+    code = get_vlc2(gb, s->vlcs[0][dc_index].table, 9, 2);
     if (code < 0 || code > 16) {
         av_log(s->avctx, AV_LOG_WARNING,
                "mjpeg_decode_dc: bad vlc: %d:%d (%p)\n",
@@ -825,46 +827,47 @@ static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
     }
 
     if (code)
-        return get_xbits(&s->gb, code);
+        return get_xbits(gb, code);
     else
         return 0;
 }
 
 /* decode block and dequantize */
-static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
+static int decode_block(MJpegDecodeContext *s, GetBitContext *gb,
+                        int16_t *block, int *last_dc,
                         int dc_index, int ac_index, uint16_t *quant_matrix)
 {
     int code, i, j, level, val;
 
     /* DC coef */
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
     }
-    val = val * (unsigned)quant_matrix[0] + s->last_dc[component];
-    s->last_dc[component] = val;
+    val = val * (unsigned)quant_matrix[0] + *last_dc;
+    *last_dc = val;
     block[0] = av_clip_int16(val);
     /* AC coefs */
     i = 0;
-    {OPEN_READER(re, &s->gb);
+    {OPEN_READER(re, gb);
     do {
-        UPDATE_CACHE(re, &s->gb);
-        GET_VLC(code, re, &s->gb, s->vlcs[1][ac_index].table, 9, 2);
+        UPDATE_CACHE(re, gb);
+        GET_VLC(code, re, gb, s->vlcs[1][ac_index].table, 9, 2);
 
         i += ((unsigned)code) >> 4;
             code &= 0xf;
         if (code) {
             if (code > MIN_CACHE_BITS - 16)
-                UPDATE_CACHE(re, &s->gb);
+                UPDATE_CACHE(re, gb);
 
             {
-                int cache = GET_CACHE(re, &s->gb);
+                int cache = GET_CACHE(re, gb);
                 int sign  = (~cache) >> 31;
                 level     = (NEG_USR32(sign ^ cache,code) ^ sign) - sign;
             }
 
-            LAST_SKIP_BITS(re, &s->gb, code);
+            LAST_SKIP_BITS(re, gb, code);
 
             if (i > 63) {
                 av_log(s->avctx, AV_LOG_ERROR, "error count: %d\n", i);
@@ -874,7 +877,7 @@ static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
             block[j] = level * quant_matrix[i];
         }
     } while (i < 63);
-    CLOSE_READER(re, &s->gb);}
+    CLOSE_READER(re, gb);}
 
     return 0;
 }
@@ -885,7 +888,7 @@ static int decode_dc_progressive(MJpegDecodeContext *s, int16_t *block,
 {
     unsigned val;
     s->bdsp.clear_block(block);
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, &s->gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
@@ -1179,7 +1182,7 @@ static int ljpeg_decode_rgb_scan(MJpegDecodeContext *s, int nb_components, int p
                 topleft[i] = top[i];
                 top[i]     = buffer[mb_x][i];
 
-                dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                 if(dc == 0xFFFFF)
                     return -1;
 
@@ -1313,7 +1316,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for(j=0; j<n; j++) {
                         int pred, dc;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if (   h * mb_x + x >= s->width
@@ -1384,7 +1387,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for (j = 0; j < n; j++) {
                         int pred;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if (   h * mb_x + x >= s->width
@@ -1453,6 +1456,169 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
+static int decode_scan_slice(AVCodecContext *avctx, void *arg,
+                             int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    MJpegSlice *slice     = &s->slices[jobnr];
+    const uint8_t *src    = s->slice_data + slice->start;
+    const uint8_t *end    = s->slice_data + slice->end;
+    uint8_t *buf          = s->slice_buffer + (size_t)threadnr * s->slice_stride;
+    uint8_t *dst          = buf;
+    int16_t *block        = s->slice_blocks[threadnr];
+    int bytes_per_pixel   = 1 + (s->bits > 8);
+    int last_dc[MAX_COMPONENTS];
+    int chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
+    int i, mb, mb_end;
+    GetBitContext gb;
+
+    /* remove the byte stuffing of this restart interval */
+    while (src < end) {
+        const uint8_t *ff = memchr(src, 0xFF, end - src);
+        if (!ff)
+            ff = end - 1;
+        memcpy(dst, src, ff - src + 1);
+        dst += ff - src + 1;
+        src  = ff + 1;
+        while (src < end && *src == 0xFF)
+            src++;
+        if (src < end && !*src)
+            src++;
+    }
+    memset(dst, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    init_get_bits8(&gb, buf, dst - buf);
+
+    av_pix_fmt_get_chroma_sub_sample(avctx->pix_fmt, &chroma_h_shift,
+                                     &chroma_v_shift);
+    chroma_width  = AV_CEIL_RSHIFT(s->width,  chroma_h_shift);
+    chroma_height = AV_CEIL_RSHIFT(s->height, chroma_v_shift);
+
+    for (i = 0; i < s->slice_nb_components; i++)
+        last_dc[i] = 4 << s->bits;
+
+    mb     = jobnr * s->restart_interval;
+    mb_end = FFMIN(mb + s->restart_interval, s->mb_width * s->mb_height);
+    for (; mb < mb_end; mb++) {
+        int mb_x = mb % s->mb_width;
+        int mb_y = mb / s->mb_width;
+
+        if (get_bits_left(&gb) < 0) {
+            av_log(avctx, AV_LOG_ERROR, "overread %d\n", -get_bits_left(&gb));
+            return slice->ret = AVERROR_INVALIDDATA;
+        }
+        for (i = 0; i < s->slice_nb_components; i++) {
+            int n = s->nb_blocks[i];
+            int c = s->comp_index[i];
+            int h = s->h_scount[i];
+            int v = s->v_scount[i];
+            int x = 0, y = 0, j;
+
+            for (j = 0; j < n; j++) {
+                int block_offset = (((s->linesize[c] * (v * mb_y + y) * 8) +
+                                     (h * mb_x + x) * 8 * bytes_per_pixel) >> avctx->lowres);
+                uint8_t *ptr = NULL;
+
+                if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? chroma_width  : s->width)
+                    && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? chroma_height : s->height))
+                    ptr = s->picture_ptr->data[c] + block_offset;
+
+                s->bdsp.clear_block(block);
+                if (decode_block(s, &gb, block, &last_dc[i],
+                                 s->dc_index[i], s->ac_index[i],
+                                 s->quant_matrixes[s->quant_sindex[i]]) < 0) {
+                    av_log(avctx, AV_LOG_ERROR,
+                           "error y=%d x=%d\n", mb_y, mb_x);
+                    return slice->ret = AVERROR_INVALIDDATA;
+                }
+                if (ptr && s->linesize[c]) {
+                    s->idsp.idct_put(ptr, s->linesize[c], block);
+                    if (s->bits & 7)
+                        shift_output(s, ptr, s->linesize[c]);
+                }
+                if (++x == h) {
+                    x = 0;
+                    y++;
+                }
+            }
+        }
+    }
+    return slice->ret = 0;
+}
+
+/**
+ * Decode a sequential scan with one job per restart interval.
+ *
+ * @return AVERROR(EAGAIN) if the restart markers do not split the scan
+ *         cleanly, in which case it has to be decoded serially
+ */
+static int decode_scan_slices(MJpegDecodeContext *s, int nb_components)
+{
+    int bytes_to_start = get_bits_count(&s->gb) / 8;
+    const uint8_t *start, *end, *ptr;
+    int64_t nb_slices, buffer_size;
+    int i, n = 0, max_len = 0;
+
+    nb_slices = ((int64_t)s->mb_width * s->mb_height + s->restart_interval - 1) /
+                s->restart_interval;
+    if (nb_slices < 2 || nb_slices > INT_MAX / sizeof(*s->slices) ||
+        bytes_to_start > s->raw_scan_buffer_size)
+        return AVERROR(EAGAIN);
+
+    av_fast_malloc(&s->slices, &s->slices_size, nb_slices * sizeof(*s->slices));
+    if (!s->slices)
+        return AVERROR(ENOMEM);
+
+    /* locate the restart markers in the escaped data */
+    start = ptr = s->raw_scan_buffer + bytes_to_start;
+    end   = s->raw_scan_buffer + s->raw_scan_buffer_size;
+    s->slices[0].start = 0;
+    for (;;) {
+        const uint8_t *ff = memchr(ptr, 0xFF, end - ptr);
+        int code = -1;
+
+        if (ff) {
+            ptr = ff + 1;
+            while (ptr < end && *ptr == 0xFF)
+                ptr++;
+            if (ptr < end)
+                code = *ptr++;
+            if (!code)
+                continue;
+        } else {
+            ff = end;
+        }
+        s->slices[n].end = ff - start;
+        max_len = FFMAX(max_len, s->slices[n].end - s->slices[n].start);
+        if (code < RST0 || code > RST7)
+            break;
+        if (code != RST0 + (n & 7) || n + 1 >= nb_slices)
+            return AVERROR(EAGAIN);
+        s->slices[++n].start = ptr - start;
+    }
+    if (n + 1 != nb_slices)
+        return AVERROR(EAGAIN);
+
+    s->slice_stride = FFALIGN(max_len + AV_INPUT_BUFFER_PADDING_SIZE, 64);
+    buffer_size     = (int64_t)s->slice_stride * s->avctx->thread_count;
+    if (buffer_size > UINT_MAX)
+        return AVERROR(EAGAIN);
+    av_fast_malloc(&s->slice_buffer, &s->slice_buffer_size, buffer_size);
+    av_fast_malloc(&s->slice_blocks, &s->slice_blocks_size,
+                   s->avctx->thread_count * sizeof(*s->slice_blocks));
+    if (!s->slice_buffer || !s->slice_blocks)
+        return AVERROR(ENOMEM);
+
+    s->slice_data          = start;
+    s->slice_nb_components = nb_components;
+    s->avctx->execute2(s->avctx, decode_scan_slice, NULL, NULL, nb_slices);
+
+    skip_bits_long(&s->gb, get_bits_left(&s->gb));
+    for (i = 0; i < nb_slices; i++)
+        if (s->slices[i].ret < 0)
+            return s->slices[i].ret;
+    return 0;
+}
+
 static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
                              int Al, const uint8_t *mb_bitmask,
                              int mb_bitmask_size,
@@ -1488,6 +1654,15 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
         s->coefs_finished[c] |= 1;
     }
 
+    if (s->avctx->active_thread_type & FF_THREAD_SLICE &&
+        s->restart_interval && s->raw_scan_buffer &&
+        !mb_bitmask && !s->progressive && !s->interlaced &&
+        s->avctx->codec_id != AV_CODEC_ID_THP) {
+        int ret = decode_scan_slices(s, nb_components);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+    }
+
     for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
         for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
             const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
@@ -1529,7 +1704,7 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
 
                         } else {
                             s->bdsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
+                            if (decode_block(s, &s->gb, s->block, &s->last_dc[i],
                                              s->dc_index[i], s->ac_index[i],
                                              s->quant_matrixes[s->quant_sindex[i]]) < 0) {
                                 av_log(s->avctx, AV_LOG_ERROR,
@@ -2233,6 +2408,28 @@ found:
     return val;
 }
 
+/**
+ * Return the marker terminating the scan whose header starts at buf,
+ * skipping byte stuffing and restart markers, or -1 if there is none.
+ */
+static int scan_end_marker(const uint8_t *buf, const uint8_t *buf_end)
+{
+    if (buf_end - buf < 2 || buf_end - buf < AV_RB16(buf))
+        return -1;
+    buf += AV_RB16(buf);
+
+    while ((buf = memchr(buf, 0xFF, buf_end - buf))) {
+        while (buf < buf_end && *buf == 0xFF)
+            buf++;
+        if (buf == buf_end)
+            break;
+        if (*buf && (*buf < RST0 || *buf > RST7))
+            return *buf;
+        buf++;
+    }
+    return -1;
+}
+
 int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                          const uint8_t **buf_ptr, const uint8_t *buf_end,
                          const uint8_t **unescaped_buf_ptr,
@@ -2579,6 +2776,14 @@ eoi_parser:
                 break;
             }
 
+            /* If only the EOI follows this scan, nothing the next frame
+             * depends on changes anymore, so let it start. Interlaced
+             * pictures and hwaccels finish their setup with the packet. */
+            if (avctx->active_thread_type & FF_THREAD_FRAME &&
+                !avctx->hwaccel && !s->interlaced && s->got_picture &&
+                scan_end_marker(s->raw_scan_buffer, buf_end) == EOI)
+                ff_thread_finish_setup(avctx);
+
             if ((ret = ff_mjpeg_decode_sos(s, NULL, 0, NULL)) < 0 &&
                 (avctx->err_recognition & AV_EF_EXPLODE))
                 goto fail;
@@ -2968,6 +3173,10 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
     av_freep(&s->hwaccel_picture_private);
     av_freep(&s->jls_state);
 
+    av_freep(&s->slices);
+    av_freep(&s->slice_buffer);
+    av_freep(&s->slice_blocks);
+
     return 0;
 }
 
@@ -2996,6 +3205,107 @@ static const AVClass mjpegdec_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_THREADS
+static int update_huffman_tables(MJpegDecodeContext *dst,
+                                 const MJpegDecodeContext *src)
+{
+    int class, index, i, n, ret;
+
+    for (class = 0; class < 2; class++) {
+        for (index = 0; index < 4; index++) {
+            const uint8_t *lengths = src->raw_huffman_lengths[class][index];
+            const uint8_t *values  = src->raw_huffman_values[class][index];
+            uint8_t bits_table[17] = { 0 };
+
+            if (!src->vlcs[class][index].table)
+                continue;
+            for (i = 0, n = 0; i < 16; i++)
+                n += lengths[i];
+            if (dst->vlcs[class][index].table &&
+                !memcmp(dst->raw_huffman_lengths[class][index], lengths, 16) &&
+                !memcmp(dst->raw_huffman_values[class][index], values, n))
+                continue;
+
+            memcpy(bits_table + 1, lengths, 16);
+            ff_vlc_free(&dst->vlcs[class][index]);
+            if ((ret = ff_mjpeg_build_vlc(&dst->vlcs[class][index], bits_table,
+                                          values, class > 0, dst->avctx)) < 0)
+                return ret;
+            if (class > 0) {
+                ff_vlc_free(&dst->vlcs[2][index]);
+                if ((ret = ff_mjpeg_build_vlc(&dst->vlcs[2][index], bits_table,
+                                              values, 0, dst->avctx)) < 0)
+                    return ret;
+            }
+            memcpy(dst->raw_huffman_lengths[class][index], lengths, 16);
+            memcpy(dst->raw_huffman_values[class][index], values, 256);
+        }
+    }
+    return 0;
+}
+
+static int mjpeg_update_thread_context(AVCodecContext *dst,
+                                       const AVCodecContext *src)
+{
+    MJpegDecodeContext *sdst = dst->priv_data;
+    const MJpegDecodeContext *ssrc = src->priv_data;
+    int ret;
+
+    if (dst == src)
+        return 0;
+
+    if ((ret = update_huffman_tables(sdst, ssrc)) < 0)
+        return ret;
+    memcpy(sdst->quant_matrixes, ssrc->quant_matrixes, sizeof(sdst->quant_matrixes));
+    memcpy(sdst->qscale,         ssrc->qscale,         sizeof(sdst->qscale));
+
+    sdst->first_picture      = ssrc->first_picture;
+    sdst->interlaced         = ssrc->interlaced;
+    sdst->bottom_field       = ssrc->bottom_field;
+    sdst->interlace_polarity = ssrc->interlace_polarity;
+    sdst->buggy_avid         = ssrc->buggy_avid;
+    sdst->cs_itu601          = ssrc->cs_itu601;
+    sdst->multiscope         = ssrc->multiscope;
+    sdst->flipped            = ssrc->flipped;
+    sdst->rgb                = ssrc->rgb;
+    sdst->rct                = ssrc->rct;
+    sdst->pegasus_rct        = ssrc->pegasus_rct;
+    sdst->colr               = ssrc->colr;
+    sdst->xfrm               = ssrc->xfrm;
+
+    sdst->width         = ssrc->width;
+    sdst->height        = ssrc->height;
+    sdst->bits          = ssrc->bits;
+    sdst->nb_components = ssrc->nb_components;
+    sdst->h_max         = ssrc->h_max;
+    sdst->v_max         = ssrc->v_max;
+    sdst->pix_desc      = ssrc->pix_desc;
+    memcpy(sdst->component_id, ssrc->component_id, sizeof(sdst->component_id));
+    memcpy(sdst->quant_index,  ssrc->quant_index,  sizeof(sdst->quant_index));
+    memcpy(sdst->h_count,      ssrc->h_count,      sizeof(sdst->h_count));
+    memcpy(sdst->v_count,      ssrc->v_count,      sizeof(sdst->v_count));
+
+    sdst->hwaccel_pix_fmt    = ssrc->hwaccel_pix_fmt;
+    sdst->hwaccel_sw_pix_fmt = ssrc->hwaccel_sw_pix_fmt;
+
+    /* The second field of a picture split over two packets is decoded
+     * into the picture of the first one; both fields only touch their
+     * own lines. */
+    sdst->got_picture = 0;
+    if (ssrc->got_picture && ssrc->interlaced &&
+        ssrc->bottom_field == !ssrc->interlace_polarity) {
+        if ((ret = av_frame_replace(sdst->picture_ptr, ssrc->picture_ptr)) < 0)
+            return ret;
+        memcpy(sdst->linesize, ssrc->linesize, sizeof(sdst->linesize));
+        sdst->got_picture = 1;
+    }
+
+    init_idct(dst);
+
+    return 0;
+}
+#endif
+
 const FFCodec ff_mjpeg_decoder = {
     .p.name         = "mjpeg",
     CODEC_LONG_NAME("MJPEG (Motion JPEG)"),
@@ -3005,8 +3315,10 @@ const FFCodec ff_mjpeg_decoder = {
     .init           = ff_mjpeg_decode_init,
     .close          = ff_mjpeg_decode_end,
     FF_CODEC_DECODE_CB(ff_mjpeg_decode_frame),
+    UPDATE_THREAD_CONTEXT(mjpeg_update_thread_context),
     .flush          = decode_flush,
-    .p.capabilities = AV_CODEC_CAP_DR1,
+    .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .p.max_lowres   = 3,
     .p.priv_class   = &mjpegdec_class,
     .p.profiles     = NULL_IF_CONFIG_SMALL(ff_mjpeg_profiles),
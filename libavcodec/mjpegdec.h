@@ -51,6 +51,11 @@ typedef struct ICCEntry {
 
 struct JLSState;
 
+typedef struct MJpegSlice {
+    int start, end;     ///< offsets of the entropy-coded data in the scan
+    int ret;
+} MJpegSlice;
+
 typedef struct MJpegDecodeContext {
     AVClass *class;
     AVCodecContext *avctx;
@@ -165,6 +170,17 @@ typedef struct MJpegDecodeContext {
     enum AVPixelFormat hwaccel_pix_fmt;
     void *hwaccel_picture_private;
     struct JLSState *jls_state;
+
+    /* restart intervals of the current scan, decoded in parallel */
+    MJpegSlice *slices;
+    unsigned int slices_size;
+    const uint8_t *slice_data;      ///< start of the entropy-coded data
+    uint8_t *slice_buffer;          ///< unescaped data, one stride per thread
+    unsigned int slice_buffer_size;
+    int slice_stride;
+    int16_t (*slice_blocks)[64];    ///< one block per thread
+    unsigned int slice_blocks_size;
+    int slice_nb_components;
 } MJpegDecodeContext;
 
 int ff_mjpeg_build_vlc(VLC *vlc, const uint8_t *bits_table,
@@ -29,6 +29,7 @@
 #include "codec_desc.h"
 #include "codec_internal.h"
 #include "decode.h"
+#include "executor.h"
 #include "hwaccel_internal.h"
 #include "hwconfig.h"
 #include "internal.h"
@@ -81,6 +82,12 @@ typedef struct ThreadFrameProgress {
 typedef struct PerThreadContext {
     struct FrameThreadContext *parent;
 
+    FFTask         task;            ///< Decoding job, when running on the shared pool.
+    /**
+     * Thread whose job must be queued on the shared pool once this thread
+     * is done decoding. Protected by progress_mutex.
+     */
+    struct PerThreadContext *next_job;
     pthread_t      thread;
     int            thread_init;
     unsigned       pthread_init_cnt;///< Number of successfully initialized mutexes/conditions
@@ -150,6 +157,12 @@ typedef struct FrameThreadContext {
     int next_decoding;             ///< The next context to submit a packet to.
     int next_finished;             ///< The next context to return output from.
 
+    /**
+     * Shared worker pool running the decoding jobs, if shared_frame_threads
+     * is set.
+     */
+    FFExecutor *executor;
+
     /* hwaccel state for thread-unsafe hwaccels is temporarily stored here in
      * order to transfer its ownership to the next decoding thread without the
      * need for extra synchronization */
@@ -239,106 +252,141 @@ static void decoded_frames_free(DecodedFrames *df)
 }
 
 /**
- * Codec worker thread.
+ * Decode the packet submitted to a thread.
  *
  * Automatically calls ff_thread_finish_setup() if the codec does
  * not provide an update_thread_context method, or if the codec returns
  * before calling it.
  */
-static attribute_align_arg void *frame_worker_thread(void *arg)
+static void frame_worker_decode(PerThreadContext *p)
 {
-    PerThreadContext *p = arg;
     AVCodecContext *avctx = p->avctx;
     const FFCodec *codec = ffcodec(avctx->codec);
+    PerThreadContext *next_job;
+    int ret;
 
-    thread_set_name(p);
+    if (!codec->update_thread_context)
+        ff_thread_finish_setup(avctx);
 
-    pthread_mutex_lock(&p->mutex);
-    while (1) {
-        int ret;
+    /* If a decoder supports hwaccel, then it must call ff_get_format().
+     * Since that call must happen before ff_thread_finish_setup(), the
+     * decoder is required to implement update_thread_context() and call
+     * ff_thread_finish_setup() manually. Therefore the above
+     * ff_thread_finish_setup() call did not happen and hwaccel_serializing
+     * cannot be true here. */
+    av_assert0(!p->hwaccel_serializing);
 
-        while (atomic_load(&p->state) == STATE_INPUT_READY && !p->die)
-            pthread_cond_wait(&p->input_cond, &p->mutex);
+    /* if the previous thread uses thread-unsafe hwaccel then we take the
+     * lock to ensure the threads don't run concurrently */
+    if (hwaccel_serial(avctx)) {
+        pthread_mutex_lock(&p->parent->hwaccel_mutex);
+        p->hwaccel_serializing = 1;
+    }
 
-        if (p->die) break;
+    ret = 0;
+    while (ret >= 0) {
+        AVFrame *frame;
 
-        if (!codec->update_thread_context)
-            ff_thread_finish_setup(avctx);
-
-        /* If a decoder supports hwaccel, then it must call ff_get_format().
-         * Since that call must happen before ff_thread_finish_setup(), the
-         * decoder is required to implement update_thread_context() and call
-         * ff_thread_finish_setup() manually. Therefore the above
-         * ff_thread_finish_setup() call did not happen and hwaccel_serializing
-         * cannot be true here. */
-        av_assert0(!p->hwaccel_serializing);
-
-        /* if the previous thread uses thread-unsafe hwaccel then we take the
-         * lock to ensure the threads don't run concurrently */
-        if (hwaccel_serial(avctx)) {
-            pthread_mutex_lock(&p->parent->hwaccel_mutex);
-            p->hwaccel_serializing = 1;
+        /* get the frame which will store the output */
+        frame = decoded_frames_get_free(&p->df);
+        if (!frame) {
+            p->result = AVERROR(ENOMEM);
+            goto alloc_fail;
         }
 
-        ret = 0;
-        while (ret >= 0) {
-            AVFrame *frame;
-
-            /* get the frame which will store the output */
-            frame = decoded_frames_get_free(&p->df);
-            if (!frame) {
-                p->result = AVERROR(ENOMEM);
-                goto alloc_fail;
-            }
-
-            /* do the actual decoding */
-            ret = ff_decode_receive_frame_internal(avctx, frame);
-            if (ret == 0)
-                p->df.nb_f++;
-            else if (ret < 0 && frame->buf[0])
-                av_frame_unref(frame);
+        /* do the actual decoding */
+        ret = ff_decode_receive_frame_internal(avctx, frame);
+        if (ret == 0)
+            p->df.nb_f++;
+        else if (ret < 0 && frame->buf[0])
+            av_frame_unref(frame);
 
-            p->result = (ret == AVERROR(EAGAIN)) ? 0 : ret;
-        }
+        p->result = (ret == AVERROR(EAGAIN)) ? 0 : ret;
+    }
 
-        if (atomic_load(&p->state) == STATE_SETTING_UP)
-            ff_thread_finish_setup(avctx);
+    if (atomic_load(&p->state) == STATE_SETTING_UP)
+        ff_thread_finish_setup(avctx);
 
 alloc_fail:
-        if (p->hwaccel_serializing) {
-            /* wipe hwaccel state for thread-unsafe hwaccels to avoid stale
-             * pointers lying around;
-             * the state was transferred to FrameThreadContext in
-             * ff_thread_finish_setup(), so nothing is leaked */
-            avctx->hwaccel                     = NULL;
-            avctx->hwaccel_context             = NULL;
-            avctx->internal->hwaccel_priv_data = NULL;
-
-            p->hwaccel_serializing = 0;
-            pthread_mutex_unlock(&p->parent->hwaccel_mutex);
-        }
-        av_assert0(!avctx->hwaccel ||
-                   (ffhwaccel(avctx->hwaccel)->caps_internal & HWACCEL_CAP_THREAD_SAFE));
+    if (p->hwaccel_serializing) {
+        /* wipe hwaccel state for thread-unsafe hwaccels to avoid stale
+         * pointers lying around;
+         * the state was transferred to FrameThreadContext in
+         * ff_thread_finish_setup(), so nothing is leaked */
+        avctx->hwaccel                     = NULL;
+        avctx->hwaccel_context             = NULL;
+        avctx->internal->hwaccel_priv_data = NULL;
+
+        p->hwaccel_serializing = 0;
+        pthread_mutex_unlock(&p->parent->hwaccel_mutex);
+    }
+    av_assert0(!avctx->hwaccel ||
+               (ffhwaccel(avctx->hwaccel)->caps_internal & HWACCEL_CAP_THREAD_SAFE));
 
-        if (p->async_serializing) {
-            p->async_serializing = 0;
+    if (p->async_serializing) {
+        p->async_serializing = 0;
 
-            async_unlock(p->parent);
-        }
+        async_unlock(p->parent);
+    }
+
+    pthread_mutex_lock(&p->progress_mutex);
+
+    atomic_store(&p->state, STATE_INPUT_READY);
+    next_job    = p->next_job;
+    p->next_job = NULL;
+
+    pthread_cond_broadcast(&p->progress_cond);
+    pthread_cond_signal(&p->output_cond);
+    pthread_mutex_unlock(&p->progress_mutex);
+
+    /* the context cannot be freed before next_job is done, as it is not
+     * STATE_INPUT_READY */
+    if (next_job)
+        ff_executor_execute(next_job->parent->executor, &next_job->task);
+}
+
+/**
+ * Codec worker thread.
+ */
+static attribute_align_arg void *frame_worker_thread(void *arg)
+{
+    PerThreadContext *p = arg;
+
+    thread_set_name(p);
 
-        pthread_mutex_lock(&p->progress_mutex);
+    pthread_mutex_lock(&p->mutex);
+    while (1) {
+        while (atomic_load(&p->state) == STATE_INPUT_READY && !p->die)
+            pthread_cond_wait(&p->input_cond, &p->mutex);
 
-        atomic_store(&p->state, STATE_INPUT_READY);
+        if (p->die) break;
 
-        pthread_cond_broadcast(&p->progress_cond);
-        pthread_cond_signal(&p->output_cond);
-        pthread_mutex_unlock(&p->progress_mutex);
+        frame_worker_decode(p);
     }
     pthread_mutex_unlock(&p->mutex);
 
     return NULL;
 }
 
+/**
+ * Decoding job run on the shared worker pool.
+ *
+ * A job is only queued once the job submitted before it on the same context
+ * is done, see submit_packet(). As a frame only depends on frames submitted
+ * before it, all the progress it can wait for has then been reported, and
+ * the job never blocks the worker running it.
+ */
+static int frame_worker_task(FFTask *t, void *local_context, void *user_data)
+{
+    PerThreadContext *p = (PerThreadContext *)((char *)t - offsetof(PerThreadContext, task));
+
+    pthread_mutex_lock(&p->mutex);
+    frame_worker_decode(p);
+    pthread_mutex_unlock(&p->mutex);
+
+    return 0;
+}
+
 /**
  * Update the next thread's AVCodecContext with values from the reference thread's context.
  *
@@ -554,9 +602,27 @@ static int submit_packet(PerThreadContext *p, AVCodecContext *user_avctx,
     }
 
     atomic_store(&p->state, STATE_SETTING_UP);
-    pthread_cond_signal(&p->input_cond);
+    if (!fctx->executor)
+        pthread_cond_signal(&p->input_cond);
     pthread_mutex_unlock(&p->mutex);
 
+    if (fctx->executor) {
+        int queue = 1;
+
+        /* let the previous job queue this one when it is done instead of
+         * having a worker wait for its progress */
+        if (prev_thread) {
+            pthread_mutex_lock(&prev_thread->progress_mutex);
+            if (atomic_load(&prev_thread->state) != STATE_INPUT_READY) {
+                prev_thread->next_job = p;
+                queue = 0;
+            }
+            pthread_mutex_unlock(&prev_thread->progress_mutex);
+        }
+        if (queue)
+            ff_executor_execute(fctx->executor, &p->task);
+    }
+
     fctx->prev_thread = p;
     fctx->next_decoding = (fctx->next_decoding + 1) % p->avctx->thread_count;
 
@@ -750,16 +816,24 @@ void ff_frame_thread_free(AVCodecContext *avctx, int thread_count)
 {
     FrameThreadContext *fctx = avctx->internal->thread_ctx;
     const FFCodec *codec = ffcodec(avctx->codec);
+    int pool = !!fctx->executor;
     int i;
 
+    /* A job queued on the shared pool, or waiting for the previous job to
+     * queue it, is not STATE_INPUT_READY until it is done, so this also
+     * drains them; freeing the executor then waits for the workers to
+     * return from the last ones. */
     park_frame_worker_threads(fctx, thread_count);
+    ff_executor_free(&fctx->executor);
 
     for (i = 0; i < thread_count; i++) {
         PerThreadContext *p = &fctx->threads[i];
         AVCodecContext *ctx = p->avctx;
 
+        av_assert0(!p->next_job);
+
         if (ctx->internal) {
-            if (p->thread_init == INITIALIZED) {
+            if (p->thread_init == INITIALIZED && !pool) {
                 pthread_mutex_lock(&p->mutex);
                 p->die = 1;
                 pthread_cond_signal(&p->input_cond);
@@ -910,9 +984,11 @@ static av_cold int init_thread(PerThreadContext *p, int *threads_to_free,
 
     atomic_init(&p->debug_threads, (copy->debug & FF_DEBUG_THREADS) != 0);
 
-    err = AVERROR(pthread_create(&p->thread, NULL, frame_worker_thread, p));
-    if (err < 0)
-        return err;
+    if (!fctx->executor) {
+        err = AVERROR(pthread_create(&p->thread, NULL, frame_worker_thread, p));
+        if (err < 0)
+            return err;
+    }
     p->thread_init = INITIALIZED;
 
     return 0;
@@ -965,6 +1041,21 @@ int ff_frame_thread_init(AVCodecContext *avctx)
         goto error;
     }
 
+    if (avctx->shared_frame_threads) {
+        FFTaskCallbacks callbacks = {
+            fctx,
+            0,
+            1,
+            frame_worker_task,
+        };
+
+        fctx->executor = ff_executor_alloc_shared(&callbacks, av_cpu_count());
+        if (!fctx->executor) {
+            err = AVERROR(ENOMEM);
+            goto error;
+        }
+    }
+
     for (; i < thread_count; ) {
         PerThreadContext *p  = &fctx->threads[i];
         int first = !i;
@@ -26,6 +26,7 @@
 #include "libavcodec/refstruct.h"
 #include "libavutil/cpu.h"
 #include "libavutil/mem.h"
+#include "libavutil/opt.h"
 #include "libavutil/thread.h"
 
 #include "dec.h"
@@ -1030,7 +1031,7 @@ static av_cold int vvc_decode_free(AVCodecContext *avctx)
 
     ff_cbs_fragment_free(&s->current_frame);
     vvc_decode_flush(avctx);
-    ff_vvc_executor_free(&s->executor);
+    ff_vvc_executor_free(s);
     if (s->fcs) {
         for (int i = 0; i < s->nb_fcs; i++)
             frame_context_free(s->fcs + i);
@@ -1083,9 +1084,9 @@ static av_cold int vvc_decode_init(AVCodecContext *avctx)
 
     if (thread_count == 1)
         thread_count = 0;
-    s->executor = ff_vvc_executor_alloc(s, thread_count);
-    if (!s->executor)
-        return AVERROR(ENOMEM);
+    ret = ff_vvc_executor_init(s, thread_count);
+    if (ret < 0)
+        return ret;
 
     s->eos = 1;
     GDR_SET_RECOVERED(s);
@@ -1094,12 +1095,30 @@ static av_cold int vvc_decode_init(AVCodecContext *avctx)
     return 0;
 }
 
+#define OFFSET(x) offsetof(VVCContext, x)
+#define PAR (AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_VIDEO_PARAM)
+static const AVOption options[] = {
+    { "shared_executor", "share worker threads with other VVC decoders using the same thread count",
+        OFFSET(shared_executor), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "task_stats", "log the number of tasks and their queueing time per decoding stage",
+        OFFSET(collect_task_stats), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { NULL },
+};
+
+static const AVClass vvc_decoder_class = {
+    .class_name = "VVC decoder",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 const FFCodec ff_vvc_decoder = {
     .p.name         = "vvc",
     .p.long_name    = NULL_IF_CONFIG_SMALL("VVC (Versatile Video Coding)"),
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_VVC,
     .priv_data_size = sizeof(VVCContext),
+    .p.priv_class   = &vvc_decoder_class,
     .init           = vvc_decode_init,
     .close          = vvc_decode_free,
     FF_CODEC_DECODE_CB(vvc_decode_frame),
@@ -210,6 +210,7 @@ typedef struct VVCFrameContext {
 } VVCFrameContext;
 
 typedef struct VVCContext {
+    const AVClass *class;
     struct AVCodecContext *avctx;
 
     CodedBitstreamContext *cbc;
@@ -235,6 +236,9 @@ typedef struct VVCContext {
     uint16_t seq_output;
 
     struct FFExecutor *executor;
+    struct VVCTaskStats *task_stats;    ///< NULL unless collect_task_stats is set
+    int shared_executor;
+    int collect_task_stats;
 
     VVCFrameContext *fcs;
     int nb_fcs;
@@ -25,6 +25,7 @@
 #include "libavcodec/executor.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 
 #include "thread.h"
 #include "ctu.h"
@@ -76,8 +77,15 @@ typedef struct VVCTask {
     // tasks with target scores met are ready for scheduling
     atomic_uchar score[VVC_TASK_STAGE_LAST];
     atomic_uchar target_inter_score;
+
+    int64_t queued_time;            //when the task was handed to the executor
 } VVCTask;
 
+typedef struct VVCTaskStats {
+    uint64_t nb_tasks[VVC_TASK_STAGE_LAST];     ///< tasks handed to the executor, by stage
+    int64_t wait_time[VVC_TASK_STAGE_LAST];     ///< time spent queued in the executor, in microseconds
+} VVCTaskStats;
+
 typedef struct VVCRowThread {
     atomic_int col_progress[VVC_PROGRESS_LAST];
 } VVCRowThread;
@@ -98,6 +106,10 @@ typedef struct VVCFrameThread {
     atomic_int nb_scheduled_tasks;
     atomic_int nb_scheduled_listeners;
 
+    // per stage stats, folded into VVCTaskStats when the frame is done
+    atomic_int nb_stage_tasks[VVC_TASK_STAGE_LAST];
+    atomic_int_least64_t stage_wait_time[VVC_TASK_STAGE_LAST];
+
     int row_progress[VVC_PROGRESS_LAST];
 
     AVMutex lock;
@@ -125,6 +137,10 @@ static void add_task(VVCContext *s, VVCTask *t)
     };
 
     atomic_fetch_add(&ft->nb_scheduled_tasks, 1);
+    if (s->task_stats) {
+        atomic_fetch_add(&ft->nb_stage_tasks[t->stage], 1);
+        t->queued_time = av_gettime_relative();
+    }
     task->priority = priorities[t->stage];
     ff_executor_execute(s->executor, task);
 }
@@ -669,6 +685,8 @@ static int task_run(FFTask *_t, void *local_context, void *user_data)
     VVCLocalContext *lc = local_context;
     VVCFrameThread *ft  = t->fc->ft;
 
+    if (s->task_stats)
+        atomic_fetch_add(&ft->stage_wait_time[t->stage], av_gettime_relative() - t->queued_time);
     lc->fc = t->fc;
 
     do {
@@ -684,7 +702,7 @@ static int task_run(FFTask *_t, void *local_context, void *user_data)
     return 0;
 }
 
-FFExecutor* ff_vvc_executor_alloc(VVCContext *s, const int thread_count)
+int ff_vvc_executor_init(VVCContext *s, const int thread_count)
 {
     FFTaskCallbacks callbacks = {
         s,
@@ -692,12 +710,45 @@ FFExecutor* ff_vvc_executor_alloc(VVCContext *s, const int thread_count)
         PRIORITY_LOWEST + 1,
         task_run,
     };
-    return ff_executor_alloc(&callbacks, thread_count);
+
+    if (s->collect_task_stats) {
+        s->task_stats = av_mallocz(sizeof(*s->task_stats));
+        if (!s->task_stats)
+            return AVERROR(ENOMEM);
+    }
+
+    if (s->shared_executor)
+        s->executor = ff_executor_alloc_shared(&callbacks, thread_count);
+    else
+        s->executor = ff_executor_alloc(&callbacks, thread_count);
+    if (!s->executor)
+        return AVERROR(ENOMEM);
+
+    return 0;
 }
 
-void ff_vvc_executor_free(FFExecutor **e)
+static void task_stats_log(VVCContext *s)
 {
-    ff_executor_free(e);
+    const VVCTaskStats *st = s->task_stats;
+
+    if (!st->nb_tasks[VVC_TASK_STAGE_INIT])
+        return;
+
+    for (int i = 0; i < VVC_TASK_STAGE_LAST; i++) {
+        if (!st->nb_tasks[i])
+            continue;
+        av_log(s->avctx, AV_LOG_VERBOSE, "stage %-4s: %10"PRIu64" tasks, average wait %.1f us\n",
+            task_name[i], st->nb_tasks[i], (double)st->wait_time[i] / st->nb_tasks[i]);
+    }
+}
+
+void ff_vvc_executor_free(VVCContext *s)
+{
+    ff_executor_free(&s->executor);
+    if (s->task_stats) {
+        task_stats_log(s);
+        av_freep(&s->task_stats);
+    }
 }
 
 void ff_vvc_frame_thread_free(VVCFrameContext *fc)
@@ -839,6 +890,13 @@ int ff_vvc_frame_wait(VVCContext *s, VVCFrameContext *fc)
     ff_mutex_unlock(&ft->lock);
     ff_vvc_report_frame_finished(fc->ref);
 
+    if (s->task_stats) {
+        for (int i = 0; i < VVC_TASK_STAGE_LAST; i++) {
+            s->task_stats->nb_tasks[i]  += atomic_exchange(&ft->nb_stage_tasks[i], 0);
+            s->task_stats->wait_time[i] += atomic_exchange(&ft->stage_wait_time[i], 0);
+        }
+    }
+
 #ifdef VVC_THREAD_DEBUG
     av_log(s->avctx, AV_LOG_DEBUG, "frame %5d done\r\n", (int)fc->decode_order);
 #endif
@@ -453,6 +453,13 @@ unsigned avfilter_filter_pad_count(const AVFilter *filter, int is_output);
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Activate filters in independent branches of a graph concurrently, e.g. the
+ * chains following the outputs of a split filter. Only valid for
+ * AVFilterGraph.thread_type.
+ */
+#define AVFILTER_THREAD_BRANCH (1 << 1)
+
 /** An instance of a filter */
 struct AVFilterContext {
     const AVClass *av_class;        ///< needed for av_log() and filters common options
@@ -796,6 +803,9 @@ typedef struct AVFilterGraph {
      * bit AND with AVFilterContext.thread_type to get the final mask used for
      * determining allowed threading types. I.e. a threading type needs to be
      * set in both to be allowed.
+     *
+     * AVFILTER_THREAD_BRANCH is not enabled by default; it is only used when
+     * the graph uses its internal multithreading implementation.
      */
     int thread_type;
 
@@ -25,6 +25,7 @@
 #ifndef AVFILTER_AVFILTER_INTERNAL_H
 #define AVFILTER_AVFILTER_INTERNAL_H
 
+#include <stdatomic.h>
 #include <stdint.h>
 
 #include "avfilter.h"
@@ -79,6 +80,12 @@ typedef struct FilterLinkInternal {
      */
     int age_index;
 
+    /**
+     * Number of frames that had to be copied by
+     * ff_inlink_make_frame_writable() because their data was shared.
+     */
+    int64_t frame_copies;
+
     /** stage of the initialization of the link properties (dimensions, etc) */
     enum {
         AVLINK_UNINIT = 0,      ///< not started
@@ -107,8 +114,16 @@ typedef struct FFFilterContext {
      * Ready status of the filter.
      * A non-0 value means that the filter needs activating;
      * a higher value suggests a more urgent activation.
+     * Atomic because filters activated concurrently may mark a common
+     * upstream filter ready.
+     */
+    atomic_uint ready;
+
+    /**
+     * Scratch state used when selecting filters for concurrent activation,
+     * see ff_filter_graph_run_once().
      */
-    unsigned ready;
+    unsigned branch_state;
 
     ///< parsed expression
     struct AVExpr *enable;
@@ -145,6 +160,13 @@ typedef struct FFFilterGraph {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+
+    /**
+     * Filters activated concurrently in one round and their return codes.
+     * Only allocated when branch threading is in use.
+     */
+    AVFilterContext **branch_filters;
+    int              *branch_rets;
 } FFFilterGraph;
 
 static inline FFFilterGraph *fffiltergraph(AVFilterGraph *graph)
@@ -192,6 +214,21 @@ int ff_graph_thread_init(FFFilterGraph *graph);
 
 void ff_graph_thread_free(FFFilterGraph *graph);
 
+/**
+ * Set up the worker pool used to activate independent branches of the graph
+ * concurrently.
+ *
+ * @return 1 if branch threading is available, 0 if it is not, a negative
+ *         error code on failure
+ */
+int ff_graph_branch_thread_init(FFFilterGraph *graph);
+
+/**
+ * Activate graph->branch_filters[0..nb_filters-1] concurrently and store
+ * the results in graph->branch_rets.
+ */
+void ff_graph_branch_execute(FFFilterGraph *graph, int nb_filters);
+
 /**
  * Negotiate the media format, dimensions, etc of all inputs to a filter.
  *
@@ -49,6 +49,7 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, F|V|A, .unit = "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = F|V|A, .unit = "thread_type" },
+        { "branch", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_BRANCH }, .flags = F|V|A, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads), AV_OPT_TYPE_INT,
         { .i64 = 0 }, 0, INT_MAX, F|V|A, .unit = "threads"},
         {"auto", "autodetect a suitable number of threads to use", 0, AV_OPT_TYPE_CONST, {.i64 = 0 }, .flags = F|V|A, .unit = "threads"},
@@ -78,6 +79,15 @@ int ff_graph_thread_init(FFFilterGraph *graph)
     graph->p.nb_threads  = 1;
     return 0;
 }
+
+int ff_graph_branch_thread_init(FFFilterGraph *graph)
+{
+    return 0;
+}
+
+void ff_graph_branch_execute(FFFilterGraph *graph, int nb_filters)
+{
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -128,6 +138,8 @@ void avfilter_graph_free(AVFilterGraph **graphp)
     ff_graph_thread_free(graphi);
 
     av_freep(&graphi->sink_links);
+    av_freep(&graphi->branch_filters);
+    av_freep(&graphi->branch_rets);
 
     av_opt_free(graph);
 
@@ -1291,6 +1303,41 @@ static int graph_config_pointers(AVFilterGraph *graph, void *log_ctx)
     return 0;
 }
 
+static int graph_config_branches(AVFilterGraph *graph, void *log_ctx)
+{
+    FFFilterGraph *graphi = fffiltergraph(graph);
+    unsigned i;
+    int ret;
+
+    av_freep(&graphi->branch_filters);
+    av_freep(&graphi->branch_rets);
+
+    if (!(graph->thread_type & AVFILTER_THREAD_BRANCH) || graph->nb_filters < 3)
+        return 0;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        if (f->filter->flags_internal & FF_FILTER_FLAG_GRAPH_WIDE) {
+            av_log(log_ctx, AV_LOG_VERBOSE, "Filter '%s' accesses the whole graph, "
+                   "not activating branches concurrently\n", f->name);
+            return 0;
+        }
+    }
+
+    ret = ff_graph_branch_thread_init(graphi);
+    if (ret <= 0)
+        return ret;
+
+    graphi->branch_filters = av_calloc(graph->nb_filters, sizeof(*graphi->branch_filters));
+    graphi->branch_rets    = av_calloc(graph->nb_filters, sizeof(*graphi->branch_rets));
+    if (!graphi->branch_filters || !graphi->branch_rets) {
+        av_freep(&graphi->branch_filters);
+        av_freep(&graphi->branch_rets);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
 int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
 {
     int ret;
@@ -1305,6 +1352,8 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = graph_config_pointers(graphctx, log_ctx)))
         return ret;
+    if ((ret = graph_config_branches(graphctx, log_ctx)))
+        return ret;
 
     return 0;
 }
@@ -1469,21 +1518,113 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     return 0;
 }
 
+enum {
+    BRANCH_FREE = 0,
+    BRANCH_FEEDS,   ///< only feeds filters selected for activation
+    BRANCH_BUSY,    ///< selected, or fed by a selected filter
+};
+
+/*
+   Filters activated concurrently must not touch the same links or filter
+   state. Activating a filter only affects its own links and the ready
+   field of its neighbours, and the latter is atomic. So two filters can be
+   activated together if they are not adjacent and every neighbour they
+   have in common is upstream of both of them, like the outputs of a split
+   filter. Sinks update the graph-wide age heap, so at most one of them is
+   selected per round.
+ */
+static int branch_can_select(AVFilterContext *f, int *sink_selected)
+{
+    unsigned i;
+
+    if (fffilterctx(f)->branch_state != BRANCH_FREE)
+        return 0;
+    for (i = 0; i < f->nb_outputs; i++)
+        if (fffilterctx(f->outputs[i]->dst)->branch_state != BRANCH_FREE)
+            return 0;
+    for (i = 0; i < f->nb_inputs; i++)
+        if (fffilterctx(f->inputs[i]->src)->branch_state == BRANCH_BUSY)
+            return 0;
+    if (!f->nb_outputs) {
+        if (*sink_selected)
+            return 0;
+        *sink_selected = 1;
+    }
+    return 1;
+}
+
+static void branch_mark(AVFilterContext *f, int select)
+{
+    unsigned i;
+
+    fffilterctx(f)->branch_state = select ? BRANCH_BUSY : BRANCH_FREE;
+    for (i = 0; i < f->nb_outputs; i++)
+        fffilterctx(f->outputs[i]->dst)->branch_state = select ? BRANCH_BUSY : BRANCH_FREE;
+    for (i = 0; i < f->nb_inputs; i++) {
+        FFFilterContext *src = fffilterctx(f->inputs[i]->src);
+        if (!select)
+            src->branch_state = BRANCH_FREE;
+        else if (src->branch_state == BRANCH_FREE)
+            src->branch_state = BRANCH_FEEDS;
+    }
+}
+
+static int graph_run_branches(FFFilterGraph *graphi, AVFilterContext *first)
+{
+    AVFilterGraph *graph = &graphi->p;
+    int sink_selected = 0, nb = 0, ret = 0;
+    unsigned i;
+
+    branch_can_select(first, &sink_selected);
+    branch_mark(first, 1);
+    graphi->branch_filters[nb++] = first;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        if (f != first &&
+            atomic_load_explicit(&fffilterctx(f)->ready, memory_order_relaxed) &&
+            branch_can_select(f, &sink_selected)) {
+            branch_mark(f, 1);
+            graphi->branch_filters[nb++] = f;
+        }
+    }
+
+    for (i = 0; i < nb; i++)
+        branch_mark(graphi->branch_filters[i], 0);
+
+    if (nb == 1)
+        return ff_filter_activate(first);
+
+    ff_graph_branch_execute(graphi, nb);
+    for (i = 0; i < nb && ret >= 0; i++)
+        ret = graphi->branch_rets[i];
+    return ret;
+}
+
 int ff_filter_graph_run_once(AVFilterGraph *graph)
 {
+    FFFilterGraph *graphi = fffiltergraph(graph);
     FFFilterContext *ctxi;
-    unsigned i;
+    unsigned i, ready;
 
     av_assert0(graph->nb_filters);
-    ctxi = fffilterctx(graph->filters[0]);
+    ctxi  = fffilterctx(graph->filters[0]);
+    ready = atomic_load_explicit(&ctxi->ready, memory_order_relaxed);
     for (i = 1; i < graph->nb_filters; i++) {
         FFFilterContext *ctxi_other = fffilterctx(graph->filters[i]);
+        unsigned ready_other = atomic_load_explicit(&ctxi_other->ready,
+                                                    memory_order_relaxed);
 
-        if (ctxi_other->ready > ctxi->ready)
-            ctxi = ctxi_other;
+        if (ready_other > ready) {
+            ctxi  = ctxi_other;
+            ready = ready_other;
+        }
     }
 
-    if (!ctxi->ready)
+    if (!ready)
         return AVERROR(EAGAIN);
+    if (graphi->branch_filters)
+        return graph_run_branches(graphi, &ctxi->p);
     return ff_filter_activate(&ctxi->p);
 }
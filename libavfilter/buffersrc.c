@@ -321,6 +321,27 @@ unsigned av_buffersrc_get_nb_failed_requests(AVFilterContext *buffer_src)
     return ((BufferSourceContext *)buffer_src->priv)->nb_failed_requests;
 }
 
+static uint64_t link_frame_copies(AVFilterLink *link)
+{
+    AVFilterContext *dst = link->dst;
+    uint64_t copies = ff_link_internal(link)->frame_copies;
+
+    /* past a filter with several inputs, frames are no longer ours alone */
+    if (dst && dst->nb_inputs == 1)
+        for (unsigned i = 0; i < dst->nb_outputs; i++)
+            if (dst->outputs[i])
+                copies += link_frame_copies(dst->outputs[i]);
+
+    return copies;
+}
+
+uint64_t av_buffersrc_get_nb_frame_copies(AVFilterContext *buffer_src)
+{
+    if (!buffer_src->nb_outputs || !buffer_src->outputs[0])
+        return 0;
+    return link_frame_copies(buffer_src->outputs[0]);
+}
+
 #define OFFSET(x) offsetof(BufferSourceContext, x)
 #define A AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_AUDIO_PARAM
 #define V AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
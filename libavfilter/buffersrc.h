@@ -63,6 +63,16 @@ enum {
  */
 unsigned av_buffersrc_get_nb_failed_requests(AVFilterContext *buffer_src);
 
+/**
+ * Get the number of frames from this source that filters had to copy
+ * because they needed to write into them while their data was shared.
+ *
+ * Only copies made on links fed by this source alone are counted, i.e.
+ * up to the first filter with several inputs. The graph must not be
+ * running while this is called.
+ */
+uint64_t av_buffersrc_get_nb_frame_copies(AVFilterContext *buffer_src);
+
 /**
  * This structure contains the parameters describing the frames that will be
  * passed to this filter.
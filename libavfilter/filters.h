@@ -205,6 +205,13 @@ static inline FilterLink* ff_filter_link(AVFilterLink *link)
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * The filter accesses filters of the graph other than its direct neighbours,
+ * e.g. to send them commands. Graphs containing such a filter never activate
+ * filters concurrently.
+ */
+#define FF_FILTER_FLAG_GRAPH_WIDE (1 << 1)
+
 /**
  * Find the index of a link.
  *
@@ -21,6 +21,7 @@
  * Libavfilter multithreading support
  */
 
+#include <stdatomic.h>
 #include <stddef.h>
 
 #include "libavutil/error.h"
@@ -40,6 +41,12 @@ typedef struct ThreadContext {
     AVFilterContext *ctx;
     void *arg;
     int   *rets;
+
+    /* set while the slice threads are running jobs for a filter */
+    atomic_int busy;
+
+    /* workers activating independent branches of the graph */
+    AVSliceThread *branch_thread;
 } ThreadContext;
 
 static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
@@ -50,8 +57,17 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
         c->rets[jobnr] = ret;
 }
 
+static void branch_worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    ThreadContext *c = priv;
+    FFFilterGraph *graphi = fffiltergraph(c->graph);
+
+    graphi->branch_rets[jobnr] = ff_filter_activate(graphi->branch_filters[jobnr]);
+}
+
 static void slice_thread_uninit(ThreadContext *c)
 {
+    avpriv_slicethread_free(&c->branch_thread);
     avpriv_slicethread_free(&c->thread);
 }
 
@@ -59,15 +75,32 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
                           void *arg, int *ret, int nb_jobs)
 {
     ThreadContext *c = fffiltergraph(ctx->graph)->thread;
+    int busy = 0;
 
     if (nb_jobs <= 0)
         return 0;
+
+    /* Filters in concurrently activated branches cannot share the slice
+     * threads; run the jobs on the calling thread while they are in use. */
+    if (!atomic_compare_exchange_strong_explicit(&c->busy, &busy, 1,
+                                                 memory_order_acquire,
+                                                 memory_order_relaxed)) {
+        for (int i = 0; i < nb_jobs; i++) {
+            int r = func(ctx, arg, i, nb_jobs);
+            if (ret)
+                ret[i] = r;
+        }
+        return 0;
+    }
+
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+
+    atomic_store_explicit(&c->busy, 0, memory_order_release);
     return 0;
 }
 
@@ -92,6 +125,7 @@ int ff_graph_thread_init(FFFilterGraph *graphi)
     graphi->thread = av_mallocz(sizeof(ThreadContext));
     if (!graphi->thread)
         return AVERROR(ENOMEM);
+    ((ThreadContext *)graphi->thread)->graph = graph;
 
     ret = thread_init_internal(graphi->thread, graph->nb_threads);
     if (ret <= 1) {
@@ -107,6 +141,33 @@ int ff_graph_thread_init(FFFilterGraph *graphi)
     return 0;
 }
 
+int ff_graph_branch_thread_init(FFFilterGraph *graph)
+{
+    ThreadContext *c = graph->thread;
+    int nb_threads;
+
+    /* not available with a caller-provided execute() */
+    if (!c)
+        return 0;
+    if (c->branch_thread)
+        return 1;
+
+    nb_threads = avpriv_slicethread_create(&c->branch_thread, c, branch_worker_func,
+                                           NULL, graph->p.nb_threads);
+    if (nb_threads <= 1) {
+        avpriv_slicethread_free(&c->branch_thread);
+        return FFMIN(nb_threads, 0);
+    }
+    return 1;
+}
+
+void ff_graph_branch_execute(FFFilterGraph *graph, int nb_filters)
+{
+    ThreadContext *c = graph->thread;
+
+    avpriv_slicethread_execute(c->branch_thread, nb_filters, 0);
+}
+
 void ff_graph_thread_free(FFFilterGraph *graph)
 {
     if (graph->thread)
@@ -0,0 +1,424 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * scale one input to several output resolutions at once
+ *
+ * Outputs are produced from the largest to the smallest. With cascading
+ * enabled, every output is scaled from the smallest already produced
+ * picture that covers it, so the source is only read and converted for
+ * the top output and the lower ones work on progressively smaller
+ * intermediates.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "video.h"
+
+typedef struct ScaleOutput {
+    int w, h;
+    /* index of the output this one is scaled from, -1 for the input */
+    int src;
+    struct SwsContext *sws;
+    /* source properties sws was configured for */
+    int sws_w, sws_h, sws_format, sws_range;
+} ScaleOutput;
+
+typedef struct MultiScaleContext {
+    const AVClass *class;
+
+    char *sizes_str;
+    char *flags_str;
+    int cascade;
+
+    ScaleOutput *outs;
+    int nb_outs;
+    /* output indices, largest first */
+    int *order;
+    AVFrame **frames;
+} MultiScaleContext;
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    MultiScaleContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    const ScaleOutput *out = &s->outs[FF_OUTLINK_IDX(outlink)];
+
+    outlink->w = out->w;
+    outlink->h = out->h;
+
+    if (inlink->sample_aspect_ratio.num)
+        outlink->sample_aspect_ratio = av_mul_q((AVRational){ outlink->h * inlink->w,
+                                                              outlink->w * inlink->h },
+                                                inlink->sample_aspect_ratio);
+    else
+        outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
+
+    av_log(ctx, AV_LOG_VERBOSE, "output%d: w:%d h:%d -> w:%d h:%d from %s\n",
+           FF_OUTLINK_IDX(outlink), inlink->w, inlink->h, outlink->w, outlink->h,
+           out->src < 0 ? "input" : ctx->output_pads[out->src].name);
+
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    MultiScaleContext *s = ctx->priv;
+    char *sizes, *p, *saveptr = NULL;
+    int ret = 0;
+
+    if (!s->sizes_str || !*s->sizes_str) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes specified\n");
+        return AVERROR(EINVAL);
+    }
+
+    sizes = av_strdup(s->sizes_str);
+    if (!sizes)
+        return AVERROR(ENOMEM);
+
+    for (p = av_strtok(sizes, "|", &saveptr); p;
+         p = av_strtok(NULL, "|", &saveptr)) {
+        ScaleOutput *out;
+        AVFilterPad pad = { 0 };
+
+        out = av_dynarray2_add((void **)&s->outs, &s->nb_outs, sizeof(*s->outs), NULL);
+        if (!out) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        memset(out, 0, sizeof(*out));
+
+        ret = av_parse_video_size(&out->w, &out->h, p);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid output size '%s'\n", p);
+            goto fail;
+        }
+
+        pad.type         = AVMEDIA_TYPE_VIDEO;
+        pad.config_props = config_output;
+        pad.name         = av_asprintf("output%d", s->nb_outs - 1);
+        if (!pad.name) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        ret = ff_append_outpad_free_name(ctx, &pad);
+        if (ret < 0)
+            goto fail;
+    }
+
+    s->order  = av_calloc(s->nb_outs, sizeof(*s->order));
+    s->frames = av_calloc(s->nb_outs, sizeof(*s->frames));
+    if (!s->order || !s->frames) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    for (int i = 0; i < s->nb_outs; i++) {
+        int64_t area = (int64_t)s->outs[i].w * s->outs[i].h;
+        int j = i;
+
+        /* stable insertion sort, largest area first */
+        while (j > 0 && (int64_t)s->outs[s->order[j - 1]].w *
+                                  s->outs[s->order[j - 1]].h < area) {
+            s->order[j] = s->order[j - 1];
+            j--;
+        }
+        s->order[j] = i;
+    }
+
+    for (int i = 0; i < s->nb_outs; i++) {
+        ScaleOutput *out = &s->outs[s->order[i]];
+        int64_t best = INT64_MAX;
+
+        out->src = -1;
+        if (!s->cascade)
+            continue;
+
+        /* the smallest larger picture that covers this one in both directions */
+        for (int j = 0; j < i; j++) {
+            const ScaleOutput *src = &s->outs[s->order[j]];
+            int64_t area = (int64_t)src->w * src->h;
+
+            if (src->w >= out->w && src->h >= out->h && area < best) {
+                out->src = s->order[j];
+                best     = area;
+            }
+        }
+    }
+
+fail:
+    av_free(sizes);
+    return ret;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    MultiScaleContext *s = ctx->priv;
+
+    for (int i = 0; i < s->nb_outs; i++)
+        sws_freeContext(s->outs[i].sws);
+    av_freep(&s->outs);
+    av_freep(&s->order);
+    av_freep(&s->frames);
+    s->nb_outs = 0;
+}
+
+static int query_formats(const AVFilterContext *ctx,
+                         AVFilterFormatsConfig **cfg_in,
+                         AVFilterFormatsConfig **cfg_out)
+{
+    const AVPixFmtDescriptor *desc = NULL;
+    AVFilterFormats *formats = NULL;
+    int ret;
+
+    /* one format for the input and every output, so that each output is a
+     * plain resize and intermediates can be reused as sources */
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        enum AVPixelFormat pix_fmt = av_pix_fmt_desc_get_id(desc);
+
+        if (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM |
+                           AV_PIX_FMT_FLAG_PAL))
+            continue;
+        if (sws_isSupportedInput(pix_fmt) && sws_isSupportedOutput(pix_fmt) &&
+            (ret = ff_add_format(&formats, pix_fmt)) < 0)
+            return ret;
+    }
+
+    return ff_set_common_formats2(ctx, cfg_in, cfg_out, formats);
+}
+
+static int setup_sws(AVFilterContext *ctx, ScaleOutput *out, const AVFrame *src)
+{
+    MultiScaleContext *s = ctx->priv;
+    struct SwsContext *sws;
+    int range = src->color_range == AVCOL_RANGE_JPEG;
+    int ret;
+
+    if (out->sws && out->sws_w == src->width && out->sws_h == src->height &&
+        out->sws_format == src->format && out->sws_range == range)
+        return 0;
+
+    sws_freeContext(out->sws);
+    out->sws = NULL;
+
+    sws = sws_alloc_context();
+    if (!sws)
+        return AVERROR(ENOMEM);
+
+    if ((ret = av_opt_set(sws, "sws_flags", s->flags_str, 0)) < 0 ||
+        (ret = av_opt_set_int(sws, "threads", ff_filter_get_nb_threads(ctx), 0)) < 0)
+        goto fail;
+
+    av_opt_set_int(sws, "srcw",       src->width,  0);
+    av_opt_set_int(sws, "srch",       src->height, 0);
+    av_opt_set_int(sws, "src_format", src->format, 0);
+    av_opt_set_int(sws, "dstw",       out->w,      0);
+    av_opt_set_int(sws, "dsth",       out->h,      0);
+    av_opt_set_int(sws, "dst_format", src->format, 0);
+    av_opt_set_int(sws, "src_range",  range,       0);
+    av_opt_set_int(sws, "dst_range",  range,       0);
+
+    if ((ret = sws_init_context(sws, NULL, NULL)) < 0)
+        goto fail;
+
+    out->sws        = sws;
+    out->sws_w      = src->width;
+    out->sws_h      = src->height;
+    out->sws_format = src->format;
+    out->sws_range  = range;
+
+    return 0;
+fail:
+    sws_freeContext(sws);
+    return ret;
+}
+
+static int scale_output(AVFilterContext *ctx, int idx, const AVFrame *src)
+{
+    MultiScaleContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[idx];
+    ScaleOutput *out = &s->outs[idx];
+    AVFrame *dst;
+    int ret;
+
+    if (src->width == out->w && src->height == out->h) {
+        s->frames[idx] = av_frame_clone(src);
+        return s->frames[idx] ? 0 : AVERROR(ENOMEM);
+    }
+
+    ret = setup_sws(ctx, out, src);
+    if (ret < 0)
+        return ret;
+
+    dst = ff_get_video_buffer(outlink, out->w, out->h);
+    if (!dst)
+        return AVERROR(ENOMEM);
+
+    ret = av_frame_copy_props(dst, src);
+    if (ret < 0)
+        goto fail;
+
+    av_reduce(&dst->sample_aspect_ratio.num, &dst->sample_aspect_ratio.den,
+              (int64_t)src->sample_aspect_ratio.num * out->h * src->width,
+              (int64_t)src->sample_aspect_ratio.den * out->w * src->height,
+              INT_MAX);
+
+    ret = sws_scale_frame(out->sws, dst, src);
+    if (ret < 0)
+        goto fail;
+
+    s->frames[idx] = dst;
+    return 0;
+fail:
+    av_frame_free(&dst);
+    return ret;
+}
+
+static int filter_frame(AVFilterContext *ctx, AVFrame *in)
+{
+    MultiScaleContext *s = ctx->priv;
+    int ret = 0;
+
+    /* an output is needed if its link is open or a needed output is
+     * scaled from it; walk from the smallest upwards to propagate this */
+    for (int i = s->nb_outs - 1; i >= 0; i--) {
+        int idx = s->order[i];
+        int needed = !ff_outlink_get_status(ctx->outputs[idx]);
+
+        for (int j = i + 1; j < s->nb_outs && !needed; j++)
+            needed = s->outs[s->order[j]].src == idx && s->frames[s->order[j]];
+        /* placeholder until the real frame is produced below */
+        s->frames[idx] = needed ? in : NULL;
+    }
+
+    for (int i = 0; i < s->nb_outs; i++) {
+        int idx = s->order[i];
+        const ScaleOutput *out = &s->outs[idx];
+
+        if (!s->frames[idx])
+            continue;
+        ret = scale_output(ctx, idx, out->src < 0 ? in : s->frames[out->src]);
+        if (ret < 0) {
+            s->frames[idx] = NULL;
+            goto end;
+        }
+    }
+
+    for (int i = 0; i < s->nb_outs; i++) {
+        AVFrame *frame = s->frames[i];
+
+        if (!frame || ff_outlink_get_status(ctx->outputs[i]))
+            continue;
+        s->frames[i] = NULL;
+        ret = ff_filter_frame(ctx->outputs[i], frame);
+        if (ret < 0)
+            goto end;
+    }
+
+end:
+    for (int i = 0; i < s->nb_outs; i++) {
+        if (s->frames[i] != in)
+            av_frame_free(&s->frames[i]);
+        s->frames[i] = NULL;
+    }
+    av_frame_free(&in);
+    return ret;
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFrame *in;
+    int status, ret, nb_eofs = 0;
+    int64_t pts;
+
+    for (int i = 0; i < ctx->nb_outputs; i++)
+        nb_eofs += ff_outlink_get_status(ctx->outputs[i]) == AVERROR_EOF;
+
+    if (nb_eofs == ctx->nb_outputs) {
+        ff_inlink_set_status(inlink, AVERROR_EOF);
+        return 0;
+    }
+
+    ret = ff_inlink_consume_frame(inlink, &in);
+    if (ret < 0)
+        return ret;
+    if (ret > 0) {
+        ret = filter_frame(ctx, in);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        for (int i = 0; i < ctx->nb_outputs; i++) {
+            if (ff_outlink_get_status(ctx->outputs[i]))
+                continue;
+            ff_outlink_set_status(ctx->outputs[i], status, pts);
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < ctx->nb_outputs; i++) {
+        if (ff_outlink_get_status(ctx->outputs[i]))
+            continue;
+
+        if (ff_outlink_frame_wanted(ctx->outputs[i])) {
+            ff_inlink_request_frame(inlink);
+            return 0;
+        }
+    }
+
+    return FFERROR_NOT_READY;
+}
+
+#define OFFSET(x) offsetof(MultiScaleContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_FILTERING_PARAM
+static const AVOption multiscale_options[] = {
+    { "sizes",   "set the '|'-separated list of output sizes", OFFSET(sizes_str), AV_OPT_TYPE_STRING, { .str = NULL },      0, 0, FLAGS },
+    { "flags",   "set libswscale scaling flags",               OFFSET(flags_str), AV_OPT_TYPE_STRING, { .str = "bicubic" }, 0, 0, FLAGS },
+    { "cascade", "scale smaller outputs from larger ones",     OFFSET(cascade),   AV_OPT_TYPE_BOOL,   { .i64 = 1 },         0, 1, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(multiscale);
+
+const AVFilter ff_vf_multiscale = {
+    .name          = "multiscale",
+    .description   = NULL_IF_CONFIG_SMALL("Scale the input video to several sizes."),
+    .priv_size     = sizeof(MultiScaleContext),
+    .priv_class    = &multiscale_class,
+    .init          = init,
+    .uninit        = uninit,
+    .activate      = activate,
+    FILTER_INPUTS(ff_video_default_filterpad),
+    .outputs       = NULL,
+    FILTER_QUERY_FUNC2(query_formats),
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+};
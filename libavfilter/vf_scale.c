@@ -133,6 +133,14 @@ typedef struct ScaleContext {
     const AVClass *class;
     struct SwsContext *sws;     ///< software scaler context
     struct SwsContext *isws[2]; ///< software scaler context for interlaced material
+    /**
+     * Copies of sws, isws[0] and isws[1] scaling the other output slices when
+     * the work is split across the filtergraph threads, nb_slices - 1 each.
+     */
+    struct SwsContext **slice_sws[3];
+    int *slice_ret;
+    int nb_slices;
+    int slice_threads;          ///< scale in the filtergraph thread pool
     // context used for forwarding options to sws
     struct SwsContext *sws_opts;
     FFFrameSync fs;
@@ -182,6 +190,11 @@ typedef struct ScaleContext {
 
 } ScaleContext;
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int idx;                    ///< 0 for sws, 1 + field for isws[field]
+} ThreadData;
+
 const AVFilter ff_vf_scale2ref;
 
 static int config_props(AVFilterLink *outlink);
@@ -437,12 +450,16 @@ static av_cold int init(AVFilterContext *ctx)
                 return ret;
         }
 
-    // use generic thread-count if the user did not set it explicitly
+    // if the user did not set a thread count explicitly, split the frames
+    // into slices scaled by single-threaded contexts in the filtergraph
+    // thread pool
     ret = av_opt_get_int(scale->sws_opts, "threads", 0, &threads);
     if (ret < 0)
         return ret;
-    if (!threads)
-        av_opt_set_int(scale->sws_opts, "threads", ff_filter_get_nb_threads(ctx), 0);
+    if (!threads) {
+        av_opt_set_int(scale->sws_opts, "threads", 1, 0);
+        scale->slice_threads = 1;
+    }
 
     if (ctx->filter != &ff_vf_scale2ref && scale->uses_ref) {
         AVFilterPad pad = {
@@ -457,6 +474,36 @@ static av_cold int init(AVFilterContext *ctx)
     return 0;
 }
 
+/**
+ * @return whether the initialized context uses error diffusion dithering,
+ *         which requires scaling the rows in order
+ */
+static int uses_error_diffusion(struct SwsContext *sws)
+{
+    const AVOption *ed = av_opt_find(sws, "ed", "sws_dither", 0, 0);
+    int64_t dither;
+
+    return ed && av_opt_get_int(sws, "sws_dither", 0, &dither) >= 0 &&
+           dither == ed->default_val.i64;
+}
+
+static void free_sws_contexts(ScaleContext *scale)
+{
+    for (int i = 0; i < FF_ARRAY_ELEMS(scale->slice_sws); i++) {
+        if (scale->slice_sws[i]) {
+            for (int j = 0; j < scale->nb_slices - 1; j++)
+                sws_freeContext(scale->slice_sws[i][j]);
+            av_freep(&scale->slice_sws[i]);
+        }
+    }
+    av_freep(&scale->slice_ret);
+    sws_freeContext(scale->sws);
+    sws_freeContext(scale->isws[0]);
+    sws_freeContext(scale->isws[1]);
+    scale->isws[0] = scale->isws[1] = scale->sws = NULL;
+    scale->nb_slices = 0;
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     ScaleContext *scale = ctx->priv;
@@ -465,10 +512,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     scale->w_pexpr = scale->h_pexpr = NULL;
     ff_framesync_uninit(&scale->fs);
     sws_freeContext(scale->sws_opts);
-    sws_freeContext(scale->sws);
-    sws_freeContext(scale->isws[0]);
-    sws_freeContext(scale->isws[1]);
-    scale->sws = NULL;
+    free_sws_contexts(scale);
 }
 
 static int query_formats(const AVFilterContext *ctx,
@@ -713,13 +757,7 @@ static int config_props(AVFilterLink *outlink)
     if (in_colorspace == -1 /* auto */)
         in_colorspace = inlink0->colorspace;
 
-    if (scale->sws)
-        sws_freeContext(scale->sws);
-    if (scale->isws[0])
-        sws_freeContext(scale->isws[0]);
-    if (scale->isws[1])
-        sws_freeContext(scale->isws[1]);
-    scale->isws[0] = scale->isws[1] = scale->sws = NULL;
+    free_sws_contexts(scale);
     if (inlink0->w == outlink->w &&
         inlink0->h == outlink->h &&
         in_range == outlink->color_range &&
@@ -731,63 +769,88 @@ static int config_props(AVFilterLink *outlink)
         struct SwsContext **swscs[3] = {&scale->sws, &scale->isws[0], &scale->isws[1]};
         int i;
 
-        for (i = 0; i < 3; i++) {
-            int in_full, out_full, brightness, contrast, saturation;
-            int h_chr_pos, v_chr_pos;
-            const int *inv_table, *table;
-            struct SwsContext *const s = sws_alloc_context();
-            if (!s)
+        scale->nb_slices = scale->slice_threads ? ff_filter_get_nb_threads(ctx) : 1;
+        if (scale->nb_slices > 1) {
+            scale->slice_ret = av_calloc(scale->nb_slices, sizeof(*scale->slice_ret));
+            if (!scale->slice_ret)
+                return AVERROR(ENOMEM);
+        }
+        for (i = 0; i < 3 && scale->nb_slices > 1; i++) {
+            scale->slice_sws[i] = av_calloc(scale->nb_slices - 1,
+                                            sizeof(*scale->slice_sws[i]));
+            if (!scale->slice_sws[i])
                 return AVERROR(ENOMEM);
-            *swscs[i] = s;
-
-            ret = av_opt_copy(s, scale->sws_opts);
-            if (ret < 0)
-                return ret;
-
-            av_opt_set_int(s, "srcw", inlink0 ->w, 0);
-            av_opt_set_int(s, "srch", inlink0 ->h >> !!i, 0);
-            av_opt_set_int(s, "src_format", inlink0->format, 0);
-            av_opt_set_int(s, "dstw", outlink->w, 0);
-            av_opt_set_int(s, "dsth", outlink->h >> !!i, 0);
-            av_opt_set_int(s, "dst_format", outfmt, 0);
-            if (in_range != AVCOL_RANGE_UNSPECIFIED)
-                av_opt_set_int(s, "src_range",
-                               in_range == AVCOL_RANGE_JPEG, 0);
-            if (outlink->color_range != AVCOL_RANGE_UNSPECIFIED)
-                av_opt_set_int(s, "dst_range",
-                               outlink->color_range == AVCOL_RANGE_JPEG, 0);
-
-            calc_chroma_pos(&h_chr_pos, &v_chr_pos, scale->in_chroma_loc,
-                            scale->in_h_chr_pos, scale->in_v_chr_pos,
-                            desc->log2_chroma_w, desc->log2_chroma_h, i);
-            av_opt_set_int(s, "src_h_chr_pos", h_chr_pos, 0);
-            av_opt_set_int(s, "src_v_chr_pos", v_chr_pos, 0);
-
-            calc_chroma_pos(&h_chr_pos, &v_chr_pos, scale->out_chroma_loc,
-                            scale->out_h_chr_pos, scale->out_v_chr_pos,
-                            outdesc->log2_chroma_w, outdesc->log2_chroma_h, i);
-            av_opt_set_int(s, "dst_h_chr_pos", h_chr_pos, 0);
-            av_opt_set_int(s, "dst_v_chr_pos", v_chr_pos, 0);
-
-            if ((ret = sws_init_context(s, NULL, NULL)) < 0)
-                return ret;
-
-            sws_getColorspaceDetails(s, (int **)&inv_table, &in_full,
-                                     (int **)&table, &out_full,
-                                     &brightness, &contrast, &saturation);
 
-            if (scale->in_color_matrix == -1 /* auto */)
-                inv_table = sws_getCoefficients(inlink0->colorspace);
-            else if (scale->in_color_matrix != AVCOL_SPC_UNSPECIFIED)
-                inv_table = sws_getCoefficients(scale->in_color_matrix);
-            if (outlink->colorspace != AVCOL_SPC_UNSPECIFIED)
-                table = sws_getCoefficients(outlink->colorspace);
-            else if (scale->in_color_matrix != AVCOL_SPC_UNSPECIFIED)
-                table = inv_table;
+            if (!scale->interlaced)
+                break;
+        }
 
-            sws_setColorspaceDetails(s, inv_table, in_full,
-                                     table, out_full,
-                                     brightness, contrast, saturation);
+        for (i = 0; i < 3; i++) {
+            for (int j = 0; j < scale->nb_slices; j++) {
+                int in_full, out_full, brightness, contrast, saturation;
+                int h_chr_pos, v_chr_pos;
+                const int *inv_table, *table;
+                struct SwsContext *const s = sws_alloc_context();
+                if (!s)
+                    return AVERROR(ENOMEM);
+                if (j)
+                    scale->slice_sws[i][j - 1] = s;
+                else
+                    *swscs[i] = s;
+
+                ret = av_opt_copy(s, scale->sws_opts);
+                if (ret < 0)
+                    return ret;
+
+                av_opt_set_int(s, "srcw", inlink0 ->w, 0);
+                av_opt_set_int(s, "srch", inlink0 ->h >> !!i, 0);
+                av_opt_set_int(s, "src_format", inlink0->format, 0);
+                av_opt_set_int(s, "dstw", outlink->w, 0);
+                av_opt_set_int(s, "dsth", outlink->h >> !!i, 0);
+                av_opt_set_int(s, "dst_format", outfmt, 0);
+                if (in_range != AVCOL_RANGE_UNSPECIFIED)
+                    av_opt_set_int(s, "src_range",
+                                   in_range == AVCOL_RANGE_JPEG, 0);
+                if (outlink->color_range != AVCOL_RANGE_UNSPECIFIED)
+                    av_opt_set_int(s, "dst_range",
+                                   outlink->color_range == AVCOL_RANGE_JPEG, 0);
+
+                calc_chroma_pos(&h_chr_pos, &v_chr_pos, scale->in_chroma_loc,
+                                scale->in_h_chr_pos, scale->in_v_chr_pos,
+                                desc->log2_chroma_w, desc->log2_chroma_h, i);
+                av_opt_set_int(s, "src_h_chr_pos", h_chr_pos, 0);
+                av_opt_set_int(s, "src_v_chr_pos", v_chr_pos, 0);
+
+                calc_chroma_pos(&h_chr_pos, &v_chr_pos, scale->out_chroma_loc,
+                                scale->out_h_chr_pos, scale->out_v_chr_pos,
+                                outdesc->log2_chroma_w, outdesc->log2_chroma_h, i);
+                av_opt_set_int(s, "dst_h_chr_pos", h_chr_pos, 0);
+                av_opt_set_int(s, "dst_v_chr_pos", v_chr_pos, 0);
+
+                if ((ret = sws_init_context(s, NULL, NULL)) < 0)
+                    return ret;
+
+                sws_getColorspaceDetails(s, (int **)&inv_table, &in_full,
+                                         (int **)&table, &out_full,
+                                         &brightness, &contrast, &saturation);
+
+                if (scale->in_color_matrix == -1 /* auto */)
+                    inv_table = sws_getCoefficients(inlink0->colorspace);
+                else if (scale->in_color_matrix != AVCOL_SPC_UNSPECIFIED)
+                    inv_table = sws_getCoefficients(scale->in_color_matrix);
+                if (outlink->colorspace != AVCOL_SPC_UNSPECIFIED)
+                    table = sws_getCoefficients(outlink->colorspace);
+                else if (scale->in_color_matrix != AVCOL_SPC_UNSPECIFIED)
+                    table = inv_table;
+
+                sws_setColorspaceDetails(s, inv_table, in_full,
+                                         table, out_full,
+                                         brightness, contrast, saturation);
+
+                // swscale may pick error diffusion by itself
+                if (!i && !j && uses_error_diffusion(s))
+                    scale->nb_slices = 1;
+            }
 
             if (!scale->interlaced)
                 break;
@@ -877,9 +940,61 @@ static void frame_offset(AVFrame *frame, int dir, int is_pal)
     }
 }
 
-static int scale_field(ScaleContext *scale, AVFrame *dst, AVFrame *src,
+static int scale_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ScaleContext *scale = ctx->priv;
+    ThreadData *td = arg;
+    struct SwsContext *sws = jobnr   ? scale->slice_sws[td->idx][jobnr - 1] :
+                             td->idx ? scale->isws[td->idx - 1] : scale->sws;
+    const int align        = sws_receive_slice_alignment(sws);
+    const int slice_height = FFALIGN((td->out->height + nb_jobs - 1) / nb_jobs, align);
+    const int slice_start  = jobnr * slice_height;
+    const int slice_end    = FFMIN(slice_start + slice_height, td->out->height);
+    int ret;
+
+    if (slice_end <= slice_start)
+        return 0;
+
+    ret = sws_frame_start(sws, td->out, td->in);
+    if (ret < 0)
+        return ret;
+
+    ret = sws_send_slice(sws, 0, td->in->height);
+    if (ret >= 0)
+        ret = sws_receive_slice(sws, slice_start, slice_end - slice_start);
+
+    sws_frame_end(sws);
+
+    return ret;
+}
+
+/**
+ * Scale src into dst, splitting the output into slices across the filtergraph
+ * threads if possible.
+ *
+ * @param idx 0 to use sws, 1 + field to use isws[field]
+ */
+static int scale_slices(AVFilterContext *ctx, int idx, AVFrame *dst, AVFrame *src)
+{
+    ScaleContext *scale = ctx->priv;
+    ThreadData td = { .in = src, .out = dst, .idx = idx };
+
+    if (scale->nb_slices <= 1)
+        return sws_scale_frame(idx ? scale->isws[idx - 1] : scale->sws, dst, src);
+
+    ff_filter_execute(ctx, scale_slice, &td, scale->slice_ret, scale->nb_slices);
+
+    for (int i = 0; i < scale->nb_slices; i++)
+        if (scale->slice_ret[i] < 0)
+            return scale->slice_ret[i];
+
+    return 0;
+}
+
+static int scale_field(AVFilterContext *ctx, AVFrame *dst, AVFrame *src,
                        int field)
 {
+    ScaleContext *scale = ctx->priv;
     int orig_h_src = src->height;
     int orig_h_dst = dst->height;
     int ret;
@@ -898,7 +1013,7 @@ static int scale_field(ScaleContext *scale, AVFrame *dst, AVFrame *src,
     src->height /= 2;
     dst->height /= 2;
 
-    ret = sws_scale_frame(scale->isws[field], dst, src);
+    ret = scale_slices(ctx, 1 + field, dst, src);
     if (ret < 0)
         return ret;
 
@@ -1045,11 +1160,11 @@ scale:
 
     if (scale->interlaced>0 || (scale->interlaced<0 &&
         (in->flags & AV_FRAME_FLAG_INTERLACED))) {
-        ret = scale_field(scale, out, in, 0);
+        ret = scale_field(ctx, out, in, 0);
         if (ret >= 0)
-            ret = scale_field(scale, out, in, 1);
+            ret = scale_field(ctx, out, in, 1);
     } else {
-        ret = sws_scale_frame(scale->sws, out, in);
+        ret = scale_slices(ctx, 0, out, in);
     }
 
     if (ret < 0)
@@ -1336,7 +1451,7 @@ const AVFilter ff_vf_scale = {
     FILTER_QUERY_FUNC2(query_formats),
     .activate        = activate,
     .process_command = process_command,
-    .flags           = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags           = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
 
 static const AVClass *scale2ref_child_class_iterate(void **iter)
@@ -1404,4 +1519,5 @@ const AVFilter ff_vf_scale2ref = {
     FILTER_OUTPUTS(avfilter_vf_scale2ref_outputs),
     FILTER_QUERY_FUNC2(query_formats),
     .process_command = process_command,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
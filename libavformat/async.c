@@ -44,6 +44,7 @@
 #define BUFFER_CAPACITY         (4 * 1024 * 1024)
 #define READ_BACK_CAPACITY      (4 * 1024 * 1024)
 #define SHORT_SEEK_THRESHOLD    (256 * 1024)
+#define MAX_RANGES              16
 
 typedef struct RingBuffer
 {
@@ -51,6 +52,7 @@ typedef struct RingBuffer
     int           read_back_capacity;
 
     int           read_pos;
+    int64_t       start;    ///< position in the input of the first byte
 } RingBuffer;
 
 typedef struct AsyncContext {
@@ -69,7 +71,16 @@ typedef struct AsyncContext {
 
     int64_t         logical_pos;
     int64_t         logical_size;
-    RingBuffer      ring;
+
+    /* rings[0] is being filled, the others keep the ranges read before the
+     * last seeks, most recently used first */
+    RingBuffer      rings[MAX_RANGES];
+    int             nb_rings;
+
+    int64_t         stat_bytes;
+    int             stat_seeks;
+    int             stat_fast_seeks;
+    int             stat_range_seeks;
 
     pthread_cond_t  cond_wakeup_main;
     pthread_cond_t  cond_wakeup_background;
@@ -78,6 +89,10 @@ typedef struct AsyncContext {
 
     int             abort_request;
     AVIOInterruptCB interrupt_callback;
+
+    int             buffer_size;
+    int             read_back_size;
+    int             nb_ranges;
 } AsyncContext;
 
 static int ring_init(RingBuffer *ring, unsigned int capacity, int read_back_capacity)
@@ -96,10 +111,11 @@ static void ring_destroy(RingBuffer *ring)
     av_fifo_freep2(&ring->fifo);
 }
 
-static void ring_reset(RingBuffer *ring)
+static void ring_reset(RingBuffer *ring, int64_t start)
 {
     av_fifo_reset2(ring->fifo);
     ring->read_pos = 0;
+    ring->start    = start;
 }
 
 static int ring_size(RingBuffer *ring)
@@ -123,6 +139,7 @@ static int ring_read(RingBuffer *ring, void *dest, int buf_size)
 
     if (ring->read_pos > ring->read_back_capacity) {
         av_fifo_drain2(ring->fifo, ring->read_pos - ring->read_back_capacity);
+        ring->start   += ring->read_pos - ring->read_back_capacity;
         ring->read_pos = ring->read_back_capacity;
     }
 
@@ -167,6 +184,49 @@ static int ring_drain(RingBuffer *ring, int offset)
     return 0;
 }
 
+static int64_t ring_end(RingBuffer *ring)
+{
+    return ring->start + av_fifo_can_read(ring->fifo);
+}
+
+/**
+ * Find the ring a seek to pos should continue with. Returns the index of a
+ * kept range holding pos, or -1 if the input has to be read from pos.
+ */
+static int find_range(AsyncContext *c, int64_t pos)
+{
+    for (int i = 1; i < c->nb_rings; i++) {
+        RingBuffer *ring = &c->rings[i];
+        if (pos >= ring->start && pos <= ring_end(ring))
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Make rings[idx] the one being filled, keeping the others in most
+ * recently used order. With idx < 0 a newly allocated ring, or the least
+ * recently used one, is reset to start at pos.
+ */
+static void switch_range(AsyncContext *c, int idx, int64_t pos)
+{
+    RingBuffer ring;
+
+    if (idx < 0) {
+        if (c->nb_rings < c->nb_ranges &&
+            ring_init(&c->rings[c->nb_rings], c->buffer_size, c->read_back_size) >= 0)
+            c->nb_rings++;
+        idx = c->nb_rings - 1;
+        ring_reset(&c->rings[idx], pos);
+    } else {
+        c->rings[idx].read_pos = pos - c->rings[idx].start;
+    }
+
+    ring = c->rings[idx];
+    memmove(&c->rings[1], &c->rings[0], idx * sizeof(*c->rings));
+    c->rings[0] = ring;
+}
+
 static int async_check_interrupt(void *arg)
 {
     URLContext *h   = arg;
@@ -185,7 +245,7 @@ static void *async_buffer_task(void *arg)
 {
     URLContext   *h    = arg;
     AsyncContext *c    = h->priv_data;
-    RingBuffer   *ring = &c->ring;
+    RingBuffer   *ring = &c->rings[0];
     int           ret  = 0;
     int64_t       seek_ret;
 
@@ -204,11 +264,19 @@ static void *async_buffer_task(void *arg)
         }
 
         if (c->seek_request) {
-            seek_ret = ffurl_seek(c->inner, c->seek_pos, c->seek_whence);
+            /* continue reading the input where a kept range ends */
+            int idx = find_range(c, c->seek_pos);
+            seek_ret = ffurl_seek(c->inner, idx < 0 ? c->seek_pos : ring_end(&c->rings[idx]),
+                                  c->seek_whence);
             if (seek_ret >= 0) {
                 c->io_eof_reached = 0;
                 c->io_error       = 0;
-                ring_reset(ring);
+                switch_range(c, idx, c->seek_pos);
+                seek_ret = c->seek_pos;
+                if (idx < 0)
+                    c->stat_seeks++;
+                else
+                    c->stat_range_seeks++;
             }
 
             c->seek_completed = 1;
@@ -234,6 +302,8 @@ static void *async_buffer_task(void *arg)
         ret = ring_write(ring, h, to_copy);
 
         pthread_mutex_lock(&c->mutex);
+        if (ret > 0)
+            c->stat_bytes += ret;
         if (ret <= 0) {
             c->io_eof_reached = 1;
             if (c->inner_io_error < 0)
@@ -255,9 +325,10 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "async:", &arg);
 
-    ret = ring_init(&c->ring, BUFFER_CAPACITY, READ_BACK_CAPACITY);
+    ret = ring_init(&c->rings[0], c->buffer_size, c->read_back_size);
     if (ret < 0)
         goto fifo_fail;
+    c->nb_rings = 1;
 
     /* wrap interrupt callback */
     c->interrupt_callback = h->interrupt_callback;
@@ -309,7 +380,7 @@ cond_wakeup_main_fail:
 mutex_fail:
     ffurl_closep(&c->inner);
 url_fail:
-    ring_destroy(&c->ring);
+    ring_destroy(&c->rings[0]);
 fifo_fail:
     return ret;
 }
@@ -328,11 +399,16 @@ static int async_close(URLContext *h)
     if (ret != 0)
         av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", av_err2str(ret));
 
+    av_log(h, AV_LOG_VERBOSE, "Statistics: %"PRId64" bytes read, %d seeks, "
+           "%d seeks in buffer, %d seeks in kept ranges\n",
+           c->stat_bytes, c->stat_seeks, c->stat_fast_seeks, c->stat_range_seeks);
+
     pthread_cond_destroy(&c->cond_wakeup_background);
     pthread_cond_destroy(&c->cond_wakeup_main);
     pthread_mutex_destroy(&c->mutex);
     ffurl_closep(&c->inner);
-    ring_destroy(&c->ring);
+    for (int i = 0; i < c->nb_rings; i++)
+        ring_destroy(&c->rings[i]);
 
     return 0;
 }
@@ -340,7 +416,7 @@ static int async_close(URLContext *h)
 static int async_read_internal(URLContext *h, void *dest, int size)
 {
     AsyncContext *c       = h->priv_data;
-    RingBuffer   *ring    = &c->ring;
+    RingBuffer   *ring    = &c->rings[0];
     int     read_complete = !dest;
     int           to_read = size;
     int           ret     = 0;
@@ -392,7 +468,7 @@ static int async_read(URLContext *h, unsigned char *buf, int size)
 static int64_t async_seek(URLContext *h, int64_t pos, int whence)
 {
     AsyncContext *c    = h->priv_data;
-    RingBuffer   *ring = &c->ring;
+    RingBuffer   *ring = &c->rings[0];
     int64_t       ret;
     int64_t       new_logical_pos;
     int fifo_size;
@@ -434,6 +510,7 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
             ring_drain(ring, pos_delta);
             c->logical_pos = new_logical_pos;
         }
+        c->stat_fast_seeks++;
 
         return c->logical_pos;
     } else if (c->logical_size <= 0) {
@@ -476,6 +553,12 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
 #define D AV_OPT_FLAG_DECODING_PARAM
 
 static const AVOption options[] = {
+    { "buffer_size", "Size of the read-ahead buffer",
+        OFFSET(buffer_size), AV_OPT_TYPE_INT, { .i64 = BUFFER_CAPACITY }, 4096, INT_MAX / 2, D },
+    { "read_back_size", "Size of the data kept behind the read position",
+        OFFSET(read_back_size), AV_OPT_TYPE_INT, { .i64 = READ_BACK_CAPACITY }, 0, INT_MAX / 2, D },
+    { "ranges", "Number of input ranges kept for seeking back to them",
+        OFFSET(nb_ranges), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, MAX_RANGES, D },
     {NULL},
 };
 
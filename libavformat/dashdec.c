@@ -20,16 +20,19 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 #include <libxml/parser.h>
+#include <stdatomic.h>
 #include <time.h>
 #include "libavutil/bprint.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
 #include "internal.h"
 #include "avio_internal.h"
 #include "dash.h"
 #include "demux.h"
+#include "segfetch.h"
 #include "url.h"
 
 #define INITIAL_BUFFER_SIZE 32768
@@ -118,6 +121,10 @@ struct representation {
     uint32_t init_sec_buf_read_offset;
     int64_t cur_timestamp;
     int is_restart_needed;
+    int input_read_done;
+
+    /* Fragments downloaded ahead of the current one, if enabled */
+    SegPrefetch prefetch;
 };
 
 typedef struct DASHContext {
@@ -154,6 +161,16 @@ typedef struct DASHContext {
     AVDictionary *avio_opts;
     int max_url_size;
     char *cenc_decryption_key;
+    int http_persistent;
+    int prefetch_fragments;
+    int prefetch_size;
+
+    /* Bytes currently buffered by prefetching, over all representations */
+    atomic_int prefetch_used;
+
+    /* Persistent HTTP connections with no request in flight, shared by all
+     * representations */
+    SegConnPool conn_pool;
 
     /* Flags for init section*/
     int is_init_section_common_video;
@@ -350,6 +367,7 @@ static void free_timelines_list(struct representation *pls)
 
 static void free_representation(struct representation *pls)
 {
+    ff_seg_prefetch_free(&pls->prefetch);
     free_fragment_list(pls);
     free_timelines_list(pls);
     free_fragment(&pls->cur_seg);
@@ -401,6 +419,18 @@ static void free_subtitle_list(DASHContext *c)
     c->n_subtitles = 0;
 }
 
+/* Close a connection whose response has been read completely, keeping it
+ * for the next request to the same server if http_persistent is set. */
+static void release_connection(AVFormatContext *s, AVIOContext **pb)
+{
+    DASHContext *c = s->priv_data;
+
+    if (c->http_persistent)
+        ff_seg_conn_pool_put(s, &c->conn_pool, pb);
+    else
+        ff_format_io_close(s, pb);
+}
+
 static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
                     AVDictionary **opts, AVDictionary *opts2, int *is_http)
 {
@@ -446,7 +476,32 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     av_freep(pb);
     av_dict_copy(&tmp, *opts, 0);
     av_dict_copy(&tmp, opts2, 0);
-    ret = avio_open2(pb, url, AVIO_FLAG_READ, c->interrupt_callback, &tmp);
+
+    if (c->http_persistent && av_strstart(proto_name, "http", NULL)) {
+        av_dict_set(&tmp, "multiple_requests", "1", 0);
+        *pb = ff_seg_conn_pool_get(&c->conn_pool, url);
+    }
+    if (*pb) {
+        /* do not inherit the byte range of the previous request */
+        av_dict_set(&tmp, "offset", "0", AV_DICT_DONT_OVERWRITE);
+        av_dict_set(&tmp, "end_offset", "0", AV_DICT_DONT_OVERWRITE);
+        ret = ff_seg_keepalive_request(s, pb, url, &tmp);
+        if (ret == AVERROR_EXIT) {
+            av_dict_free(&tmp);
+            return ret;
+        } else if (ret < 0) {
+            if (ret != AVERROR_EOF)
+                av_log(s, AV_LOG_WARNING,
+                       "keepalive request failed for '%s' with error: '%s' when opening url, retrying with new connection\n",
+                       url, av_err2str(ret));
+            av_dict_free(&tmp);
+            av_dict_copy(&tmp, *opts, 0);
+            av_dict_copy(&tmp, opts2, 0);
+            av_dict_set(&tmp, "multiple_requests", "1", 0);
+        }
+    }
+    if (!*pb)
+        ret = avio_open2(pb, url, AVIO_FLAG_READ, c->interrupt_callback, &tmp);
     if (ret >= 0) {
         // update cookies on http response with setcookies.
         char *new_cookies = NULL;
@@ -1582,29 +1637,68 @@ finish:
     return ret;
 }
 
+static struct fragment *copy_fragment(const struct fragment *src)
+{
+    struct fragment *seg = av_mallocz(sizeof(struct fragment));
+    if (!seg) {
+        return NULL;
+    }
+    seg->url = av_strdup(src->url);
+    if (!seg->url) {
+        av_free(seg);
+        return NULL;
+    }
+    seg->size = src->size;
+    seg->url_offset = src->url_offset;
+    return seg;
+}
+
+static struct fragment *get_template_fragment(struct representation *pls, int64_t seq_no)
+{
+    DASHContext *c = pls->parent->priv_data;
+    struct fragment *seg;
+    char *tmpfilename;
+
+    if (!pls->url_template) {
+        av_log(pls->parent, AV_LOG_ERROR, "Cannot get fragment, missing template URL\n");
+        return NULL;
+    }
+    seg = av_mallocz(sizeof(struct fragment));
+    if (!seg) {
+        return NULL;
+    }
+    tmpfilename = av_mallocz(c->max_url_size);
+    if (!tmpfilename) {
+        av_free(seg);
+        return NULL;
+    }
+    ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, seq_no, 0, get_segment_start_time_based_on_timeline(pls, seq_no));
+    seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
+    if (!seg->url) {
+        av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
+        seg->url = av_strdup(pls->url_template);
+        if (!seg->url) {
+            av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
+            av_free(tmpfilename);
+            av_free(seg);
+            return NULL;
+        }
+    }
+    av_free(tmpfilename);
+    seg->size = -1;
+
+    return seg;
+}
+
 static struct fragment *get_current_fragment(struct representation *pls)
 {
     int64_t min_seq_no = 0;
     int64_t max_seq_no = 0;
-    struct fragment *seg = NULL;
-    struct fragment *seg_ptr = NULL;
     DASHContext *c = pls->parent->priv_data;
 
     while (( !ff_check_interrupt(c->interrupt_callback)&& pls->n_fragments > 0)) {
         if (pls->cur_seq_no < pls->n_fragments) {
-            seg_ptr = pls->fragments[pls->cur_seq_no];
-            seg = av_mallocz(sizeof(struct fragment));
-            if (!seg) {
-                return NULL;
-            }
-            seg->url = av_strdup(seg_ptr->url);
-            if (!seg->url) {
-                av_free(seg);
-                return NULL;
-            }
-            seg->size = seg_ptr->size;
-            seg->url_offset = seg_ptr->url_offset;
-            return seg;
+            return copy_fragment(pls->fragments[pls->cur_seq_no]);
         } else if (c->is_live) {
             refresh_manifest(pls->parent);
         } else {
@@ -1624,45 +1718,12 @@ static struct fragment *get_current_fragment(struct representation *pls)
         } else if (pls->cur_seq_no > max_seq_no) {
             av_log(pls->parent, AV_LOG_VERBOSE, "new fragment: min[%"PRId64"] max[%"PRId64"]\n", min_seq_no, max_seq_no);
         }
-        seg = av_mallocz(sizeof(struct fragment));
-        if (!seg) {
-            return NULL;
-        }
+        return get_template_fragment(pls, pls->cur_seq_no);
     } else if (pls->cur_seq_no <= pls->last_seq_no) {
-        seg = av_mallocz(sizeof(struct fragment));
-        if (!seg) {
-            return NULL;
-        }
-    }
-    if (seg) {
-        char *tmpfilename;
-        if (!pls->url_template) {
-            av_log(pls->parent, AV_LOG_ERROR, "Cannot get fragment, missing template URL\n");
-            av_free(seg);
-            return NULL;
-        }
-        tmpfilename = av_mallocz(c->max_url_size);
-        if (!tmpfilename) {
-            av_free(seg);
-            return NULL;
-        }
-        ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, pls->cur_seq_no, 0, get_segment_start_time_based_on_timeline(pls, pls->cur_seq_no));
-        seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
-        if (!seg->url) {
-            av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
-            seg->url = av_strdup(pls->url_template);
-            if (!seg->url) {
-                av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
-                av_free(tmpfilename);
-                av_free(seg);
-                return NULL;
-            }
-        }
-        av_free(tmpfilename);
-        seg->size = -1;
+        return get_template_fragment(pls, pls->cur_seq_no);
     }
 
-    return seg;
+    return NULL;
 }
 
 static int read_from_url(struct representation *pls, struct fragment *seg,
@@ -1674,7 +1735,9 @@ static int read_from_url(struct representation *pls, struct fragment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, pls->cur_seg_size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    ret = ff_seg_prefetch_read(&pls->prefetch, buf, buf_size);
+    if (!ret)
+        ret = pls->input ? avio_read(pls->input, buf, buf_size) : AVERROR_EOF;
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1719,6 +1782,7 @@ static int update_init_section(struct representation *pls)
     DASHContext *c = pls->parent->priv_data;
     int64_t sec_size;
     int64_t urlsize;
+    int complete;
     int ret;
 
     if (!pls->init_section || pls->init_sec_buf)
@@ -1742,13 +1806,19 @@ static int update_init_section(struct representation *pls)
            "Downloading an initialization section of size %"PRId64"\n",
            sec_size);
 
+    /* the connection can be reused only if the whole response gets read */
+    complete = sec_size <= max_init_section_size &&
+               (pls->init_section->size >= 0 || urlsize >= 0);
     sec_size = FFMIN(sec_size, max_init_section_size);
 
     av_fast_malloc(&pls->init_sec_buf, &pls->init_sec_buf_size, sec_size);
 
     ret = read_from_url(pls, pls->init_section, pls->init_sec_buf,
                         pls->init_sec_buf_size);
-    ff_format_io_close(pls->parent, &pls->input);
+    if (complete && ret == sec_size)
+        release_connection(pls->parent, &pls->input);
+    else
+        ff_format_io_close(pls->parent, &pls->input);
 
     if (ret < 0)
         return ret;
@@ -1759,10 +1829,124 @@ static int update_init_section(struct representation *pls)
     return 0;
 }
 
+/* Fragment seq_no of a static presentation, without refreshing anything. */
+static int prefetch_get_segment(void *opaque, int64_t seq_no, SegPrefetchEntry *e)
+{
+    struct representation *pls = opaque;
+    DASHContext *c = pls->parent->priv_data;
+    struct fragment *seg;
+
+    if (pls->n_fragments)
+        seg = seq_no < pls->n_fragments ? copy_fragment(pls->fragments[seq_no]) : NULL;
+    else if (pls->url_template && seq_no <= pls->last_seq_no)
+        seg = get_template_fragment(pls, seq_no);
+    else
+        seg = NULL;
+    if (!seg)
+        return AVERROR_EOF;
+
+    e->url        = seg->url;
+    e->url_offset = seg->url_offset;
+    e->size       = seg->size;
+    av_free(seg);
+    if (av_dict_copy(&e->avio_opts, c->avio_opts, 0) < 0)
+        return AVERROR(ENOMEM);
+    return 1;
+}
+
+static int prefetch_open(void *opaque, SegPrefetchEntry *e)
+{
+    struct representation *pls = opaque;
+    DASHContext *c = pls->parent->priv_data;
+    AVDictionary *opts = NULL;
+    char *url;
+    int ret;
+
+    url = av_mallocz(c->max_url_size);
+    if (!url)
+        return AVERROR(ENOMEM);
+
+    if (e->size >= 0) {
+        av_dict_set_int(&opts, "offset", e->url_offset, 0);
+        av_dict_set_int(&opts, "end_offset", e->url_offset + e->size, 0);
+    }
+
+    ff_make_absolute_url(url, c->max_url_size, c->base_url, e->url);
+    av_log(pls->parent, AV_LOG_VERBOSE, "DASH prefetch for url '%s', offset %"PRId64"\n",
+           url, e->url_offset);
+    ret = open_url(pls->parent, &e->input, url, &e->avio_opts, opts, NULL);
+
+    av_free(url);
+    av_dict_free(&opts);
+    return ret;
+}
+
+static void prefetch_release(void *opaque, AVIOContext **pb)
+{
+    struct representation *pls = opaque;
+
+    release_connection(pls->parent, pb);
+}
+
+/* Queue the fragments following the current one for download, dropping
+ * the ones that are no longer ahead of it. */
+static void prefetch_schedule(DASHContext *c, struct representation *pls)
+{
+    SegPrefetch *p = &pls->prefetch;
+
+    if (!p->entries) {
+        int ret;
+
+        p->opaque      = pls;
+        p->get_segment = prefetch_get_segment;
+        p->open        = prefetch_open;
+        p->release     = prefetch_release;
+        p->max_size    = c->prefetch_size;
+        p->budget_used = &c->prefetch_used;
+        ret = ff_seg_prefetch_init(p, pls->parent, c->prefetch_fragments + 1,
+                                   "dash-prefetch");
+        if (ret < 0) {
+            av_log(pls->parent, AV_LOG_WARNING,
+                   "Failed to start prefetching, disabling\n");
+            ff_seg_prefetch_free(p);
+            c->prefetch_fragments = 0;
+            return;
+        }
+    }
+
+    ff_seg_prefetch_schedule(p, pls->cur_seq_no + 1,
+                             pls->cur_seq_no + c->prefetch_fragments);
+}
+
+/* Make the prefetched copy of the current fragment, if any, the input. */
+static int prefetch_take(struct representation *pls, struct fragment *seg)
+{
+    if (!ff_seg_prefetch_take(&pls->prefetch, pls->cur_seq_no, seg->url,
+                              seg->url_offset, seg->size, &pls->input))
+        return 0;
+
+    /* see open_input() */
+    pls->cur_seg_offset = 0;
+    pls->cur_seg_size   = seg->size;
+    return 1;
+}
+
+/* Close the input of a representation, keeping its connection if the
+ * current fragment was read completely. */
+static void close_input(struct representation *pls)
+{
+    if (pls->input_read_done)
+        release_connection(pls->parent, &pls->input);
+    else
+        ff_format_io_close(pls->parent, &pls->input);
+    pls->input_read_done = 0;
+    ff_seg_prefetch_buf_free(&pls->prefetch);
+}
+
 static int64_t seek_data(void *opaque, int64_t offset, int whence)
 {
     struct representation *v = opaque;
-    if (v->n_fragments && !v->init_sec_data_len) {
+    if (v->n_fragments && !v->init_sec_data_len && v->input && !v->prefetch.buf) {
         return avio_seek(v->input, offset, whence);
     }
 
@@ -1776,7 +1960,7 @@ static int read_data(void *opaque, uint8_t *buf, int buf_size)
     DASHContext *c = v->parent->priv_data;
 
 restart:
-    if (!v->input) {
+    if (!v->input && !v->prefetch.buf) {
         free_fragment(&v->cur_seg);
         v->cur_seg = get_current_fragment(v);
         if (!v->cur_seg) {
@@ -1789,7 +1973,10 @@ restart:
         if (ret)
             goto end;
 
-        ret = open_input(c, v, v->cur_seg);
+        if (c->prefetch_fragments && prefetch_take(v, v->cur_seg))
+            ret = 0;
+        else
+            ret = open_input(c, v, v->cur_seg);
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback)) {
                 ret = AVERROR_EXIT;
@@ -1799,6 +1986,9 @@ restart:
             v->cur_seq_no++;
             goto restart;
         }
+
+        if (c->prefetch_fragments && !c->is_live)
+            prefetch_schedule(c, v);
     }
 
     if (v->init_sec_buf_read_offset < v->init_sec_data_len) {
@@ -1821,6 +2011,8 @@ restart:
     ret = read_from_url(v, v->cur_seg, buf, buf_size);
     if (ret > 0)
         goto end;
+    if (!ret || ret == AVERROR_EOF)
+        v->input_read_done = 1;
 
     if (c->is_live || v->cur_seq_no < v->last_seq_no) {
         if (!v->is_restart_needed)
@@ -2023,6 +2215,9 @@ static int dash_read_header(AVFormatContext *s)
 
     c->interrupt_callback = &s->interrupt_callback;
 
+    if ((ret = ff_seg_conn_pool_init(&c->conn_pool)) < 0)
+        return ret;
+
     if ((ret = ffio_copy_url_options(s->pb, &c->avio_opts)) < 0)
         return ret;
 
@@ -2147,7 +2342,8 @@ static void recheck_discard_flags(AVFormatContext *s, struct representation **p,
             av_log(s, AV_LOG_INFO, "Now receiving stream_index %d\n", pls->stream_index);
         } else if (!needed && pls->ctx) {
             close_demux_for_component(pls);
-            ff_format_io_close(pls->parent, &pls->input);
+            ff_seg_prefetch_flush(&pls->prefetch);
+            close_input(pls);
             av_log(s, AV_LOG_INFO, "No longer receiving stream_index %d\n", pls->stream_index);
         }
     }
@@ -2209,7 +2405,7 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
             cur->cur_seg_offset = 0;
             cur->init_sec_buf_read_offset = 0;
             cur->is_restart_needed = 0;
-            ff_format_io_close(cur->parent, &cur->input);
+            close_input(cur);
             ret = reopen_demux_for_component(s, cur);
         }
     }
@@ -2222,6 +2418,7 @@ static int dash_close(AVFormatContext *s)
     free_audio_list(c);
     free_video_list(c);
     free_subtitle_list(c);
+    ff_seg_conn_pool_uninit(s, &c->conn_pool);
     av_dict_free(&c->avio_opts);
     av_freep(&c->base_url);
     return 0;
@@ -2247,7 +2444,8 @@ static int dash_seek(AVFormatContext *s, struct representation *pls, int64_t see
         return av_seek_frame(pls->ctx, -1, seek_pos_msec * 1000, flags);
     }
 
-    ff_format_io_close(pls->parent, &pls->input);
+    ff_seg_prefetch_flush(&pls->prefetch);
+    close_input(pls);
 
     // find the nearest fragment
     if (pls->n_timelines > 0 && pls->fragment_timescale > 0) {
@@ -2346,6 +2544,12 @@ static const AVOption dash_options[] = {
         {.str = "aac,m4a,m4s,m4v,mov,mp4,webm,ts"},
         INT_MIN, INT_MAX, FLAGS},
     { "cenc_decryption_key", "Media decryption key (hex)", OFFSET(cenc_decryption_key), AV_OPT_TYPE_STRING, {.str = NULL}, INT_MIN, INT_MAX, .flags = FLAGS },
+    {"http_persistent", "Use persistent HTTP connections, shared by all representations",
+        OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS },
+    {"prefetch_fragments", "Number of fragments to download ahead of the current one in each representation, 0 = disable",
+        OFFSET(prefetch_fragments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
+    {"prefetch_size", "Maximum number of bytes buffered by prefetching over all representations",
+        OFFSET(prefetch_size), AV_OPT_TYPE_INT, {.i64 = 32 * 1024 * 1024}, 4096, INT_MAX, FLAGS},
     {NULL}
 };
 
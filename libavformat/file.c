@@ -19,6 +19,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _GNU_SOURCE     /* Needed for O_DIRECT */
+
 #include "config_components.h"
 
 #include "libavutil/avstring.h"
@@ -39,6 +41,12 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_LINUX_IO_URING_H
+#include <stdatomic.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -96,9 +104,15 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int io_uring;
+    int queue_depth;
+    int direct;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
+#if HAVE_LINUX_IO_URING_H
+    struct FileURing *ur;
+#endif
 } FileContext;
 
 static const AVOption file_options[] = {
@@ -106,6 +120,9 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring", "Use io_uring with read-ahead or write-behind", offsetof(FileContext, io_uring), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "queue_depth", "Number of io_uring blocks in flight", offsetof(FileContext, queue_depth), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, 64, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "direct", "Bypass the page cache when reading with io_uring", offsetof(FileContext, direct), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -136,10 +153,383 @@ static const AVClass fd_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_LINUX_IO_URING_H
+
+/* Size of the io_uring blocks, a multiple of the O_DIRECT alignment */
+#define URING_BLOCK_SIZE 262144
+#define URING_ALIGN      4096
+
+enum URingBlockState {
+    URING_BLOCK_IDLE,
+    URING_BLOCK_PENDING,
+    URING_BLOCK_DONE,
+};
+
+typedef struct URingBlock {
+    uint8_t *data;
+    int64_t offset;
+    int len;            ///< bytes to write, or bytes read / error code once done
+    int state;
+} URingBlock;
+
+typedef struct FileURing {
+    int fd;
+    int write;
+
+    atomic_uint *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    atomic_uint *cq_head, *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    uint8_t *sq_map, *cq_map;
+    size_t sq_map_size, cq_map_size, sqes_size;
+    int nb_unsubmitted;
+
+    /* Blocks are used in order starting at head. When reading, the blocks
+     * from head cover consecutive offsets of the file and the idle ones are
+     * at the end. When writing, head is the block being filled. */
+    uint8_t *buf;
+    URingBlock *blocks;
+    int nb_blocks;
+    int head;
+    int nb_pending;
+    int64_t pos;
+    int64_t next_offset;
+    int error;
+} FileURing;
+
+static void uring_free(FileURing **pur)
+{
+    FileURing *ur = *pur;
+
+    if (!ur)
+        return;
+    if (ur->sqes)
+        munmap(ur->sqes, ur->sqes_size);
+    if (ur->cq_map && ur->cq_map != ur->sq_map)
+        munmap(ur->cq_map, ur->cq_map_size);
+    if (ur->sq_map)
+        munmap(ur->sq_map, ur->sq_map_size);
+    if (ur->fd >= 0)
+        close(ur->fd);
+    av_free(ur->buf);
+    av_free(ur->blocks);
+    av_freep(pur);
+}
+
+static void *uring_map(int fd, size_t size, off_t offset)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, offset);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+static int uring_init(URLContext *h, int write)
+{
+    FileContext *c = h->priv_data;
+    struct io_uring_params p = { 0 };
+    FileURing *ur;
+    uint8_t *data;
+    int ret;
+
+    ur = c->ur = av_mallocz(sizeof(*ur));
+    if (!ur)
+        return AVERROR(ENOMEM);
+    ur->write     = write;
+    ur->nb_blocks = c->queue_depth;
+
+    ur->fd = syscall(__NR_io_uring_setup, ur->nb_blocks, &p);
+    if (ur->fd < 0) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+
+    ur->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ur->cq_map_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        ur->sq_map_size = ur->cq_map_size = FFMAX(ur->sq_map_size, ur->cq_map_size);
+    ur->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    ur->sq_map = uring_map(ur->fd, ur->sq_map_size, IORING_OFF_SQ_RING);
+    if (ur->sq_map && p.features & IORING_FEAT_SINGLE_MMAP)
+        ur->cq_map = ur->sq_map;
+    else if (ur->sq_map)
+        ur->cq_map = uring_map(ur->fd, ur->cq_map_size, IORING_OFF_CQ_RING);
+    ur->sqes = uring_map(ur->fd, ur->sqes_size, IORING_OFF_SQES);
+    if (!ur->sq_map || !ur->cq_map || !ur->sqes) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+
+    ur->sq_tail  = (atomic_uint *)(ur->sq_map + p.sq_off.tail);
+    ur->sq_mask  = *(unsigned *)(ur->sq_map + p.sq_off.ring_mask);
+    ur->sq_array = (unsigned *)(ur->sq_map + p.sq_off.array);
+    ur->cq_head  = (atomic_uint *)(ur->cq_map + p.cq_off.head);
+    ur->cq_tail  = (atomic_uint *)(ur->cq_map + p.cq_off.tail);
+    ur->cq_mask  = *(unsigned *)(ur->cq_map + p.cq_off.ring_mask);
+    ur->cqes     = (struct io_uring_cqe *)(ur->cq_map + p.cq_off.cqes);
+
+    ur->buf    = av_malloc(ur->nb_blocks * URING_BLOCK_SIZE + URING_ALIGN - 1);
+    ur->blocks = av_calloc(ur->nb_blocks, sizeof(*ur->blocks));
+    if (!ur->buf || !ur->blocks) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    data = (uint8_t *)FFALIGN((uintptr_t)ur->buf, URING_ALIGN);
+    for (int i = 0; i < ur->nb_blocks; i++)
+        ur->blocks[i].data = data + i * URING_BLOCK_SIZE;
+
+    return 0;
+fail:
+    uring_free(&c->ur);
+    return ret;
+}
+
+/**
+ * Submit the queued requests, and wait for at least one completion if wait
+ * is set.
+ */
+static int uring_submit(FileURing *ur, int wait)
+{
+    int ret;
+
+    if (!ur->nb_unsubmitted && !wait)
+        return 0;
+    do {
+        ret = syscall(__NR_io_uring_enter, ur->fd, ur->nb_unsubmitted, wait,
+                      wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+        return AVERROR(errno);
+    ur->nb_unsubmitted -= ret;
+    return 0;
+}
+
+static void uring_queue(FileContext *c, int idx)
+{
+    FileURing *ur = c->ur;
+    URingBlock *b = &ur->blocks[idx];
+    unsigned tail = atomic_load_explicit(ur->sq_tail, memory_order_relaxed);
+    struct io_uring_sqe *sqe = &ur->sqes[tail & ur->sq_mask];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = ur->write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd        = c->fd;
+    sqe->addr      = (uintptr_t)b->data;
+    sqe->len       = ur->write ? b->len : URING_BLOCK_SIZE;
+    sqe->off       = b->offset;
+    sqe->user_data = idx;
+    ur->sq_array[tail & ur->sq_mask] = tail & ur->sq_mask;
+    atomic_store_explicit(ur->sq_tail, tail + 1, memory_order_release);
+
+    b->state = URING_BLOCK_PENDING;
+    ur->nb_pending++;
+    ur->nb_unsubmitted++;
+}
+
+static int uring_reap(FileContext *c, int wait)
+{
+    FileURing *ur = c->ur;
+    unsigned head = atomic_load_explicit(ur->cq_head, memory_order_relaxed);
+    int ret;
+
+    while (head == atomic_load_explicit(ur->cq_tail, memory_order_acquire)) {
+        if (!wait)
+            return 0;
+        ret = uring_submit(ur, 1);
+        if (ret < 0)
+            return ret;
+    }
+
+    do {
+        const struct io_uring_cqe *cqe = &ur->cqes[head & ur->cq_mask];
+        URingBlock *b = &ur->blocks[cqe->user_data];
+        int res = cqe->res;
+
+        if (ur->write) {
+            /* complete short writes synchronously, they should not happen
+             * with regular files */
+            while (res >= 0 && res < b->len) {
+                ret = pwrite(c->fd, b->data + res, b->len - res, b->offset + res);
+                if (ret < 0 && errno == EINTR)
+                    continue;
+                if (ret <= 0) {
+                    res = ret < 0 ? -errno : -EIO;
+                    break;
+                }
+                res += ret;
+            }
+            if (res < 0 && !ur->error)
+                ur->error = AVERROR(-res);
+            b->len   = 0;
+            b->state = URING_BLOCK_IDLE;
+        } else {
+            b->len   = res < 0 ? AVERROR(-res) : res;
+            b->state = URING_BLOCK_DONE;
+        }
+        ur->nb_pending--;
+        head++;
+    } while (head != atomic_load_explicit(ur->cq_tail, memory_order_acquire));
+    atomic_store_explicit(ur->cq_head, head, memory_order_release);
+
+    return 0;
+}
+
+static int uring_drain(FileContext *c)
+{
+    while (c->ur->nb_pending) {
+        int ret = uring_reap(c, 1);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static int uring_read(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    FileURing *ur = c->ur;
+    URingBlock *b = &ur->blocks[ur->head];
+    int off, ret;
+
+    /* keep all the idle blocks reading ahead */
+    for (int i = 0; i < ur->nb_blocks; i++) {
+        int idx = (ur->head + i) % ur->nb_blocks;
+        if (ur->blocks[idx].state != URING_BLOCK_IDLE)
+            continue;
+        ur->blocks[idx].offset = ur->next_offset;
+        ur->next_offset += URING_BLOCK_SIZE;
+        uring_queue(c, idx);
+    }
+    ret = uring_submit(ur, 0);
+    if (ret < 0)
+        return ret;
+
+    while (b->state == URING_BLOCK_PENDING) {
+        ret = uring_reap(c, 1);
+        if (ret < 0)
+            return ret;
+    }
+    if (b->len < 0)
+        return b->len;
+
+    off = ur->pos - b->offset;
+    if (off >= b->len)
+        return AVERROR_EOF;
+    size = FFMIN3(size, c->blocksize, b->len - off);
+    memcpy(buf, b->data + off, size);
+    ur->pos += size;
+
+    if (ur->pos == b->offset + URING_BLOCK_SIZE) {
+        b->state = URING_BLOCK_IDLE;
+        ur->head = (ur->head + 1) % ur->nb_blocks;
+    }
+    return size;
+}
+
+static int uring_write(URLContext *h, const unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    FileURing *ur = c->ur;
+    URingBlock *b = &ur->blocks[ur->head];
+    int ret;
+
+    while (b->state == URING_BLOCK_PENDING) {
+        ret = uring_reap(c, 1);
+        if (ret < 0)
+            return ret;
+    }
+    if (ur->error)
+        return ur->error;
+
+    if (!b->len)
+        b->offset = ur->pos;
+    size = FFMIN3(size, c->blocksize, URING_BLOCK_SIZE - b->len);
+    memcpy(b->data + b->len, buf, size);
+    b->len  += size;
+    ur->pos += size;
+
+    if (b->len == URING_BLOCK_SIZE) {
+        uring_queue(c, ur->head);
+        ur->head = (ur->head + 1) % ur->nb_blocks;
+        ret = uring_submit(ur, 0);
+        if (ret < 0)
+            return ret;
+    }
+    return size;
+}
+
+/* Write out the partially filled block and wait for all the writes. */
+static int uring_flush(FileContext *c)
+{
+    FileURing *ur = c->ur;
+    URingBlock *b = &ur->blocks[ur->head];
+    int ret;
+
+    if (b->state == URING_BLOCK_IDLE && b->len) {
+        uring_queue(c, ur->head);
+        ur->head = (ur->head + 1) % ur->nb_blocks;
+    }
+    ret = uring_drain(c);
+    return ret < 0 ? ret : ur->error;
+}
+
+static int64_t uring_seek(URLContext *h, int64_t pos, int whence)
+{
+    FileContext *c = h->priv_data;
+    FileURing *ur = c->ur;
+    URingBlock *b = &ur->blocks[ur->head];
+    struct stat st;
+    int ret;
+
+    if (ur->write) {
+        ret = uring_flush(c);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (whence == AVSEEK_SIZE || whence == SEEK_END) {
+        if (fstat(c->fd, &st) < 0)
+            return AVERROR(errno);
+        if (whence == AVSEEK_SIZE)
+            return st.st_size;
+        pos += st.st_size;
+    } else if (whence == SEEK_CUR) {
+        pos += ur->pos;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    /* drop the read-ahead unless the position stays in the current block */
+    if (!ur->write && (b->state == URING_BLOCK_IDLE || pos < b->offset ||
+                       pos >= b->offset + URING_BLOCK_SIZE ||
+                       b->state == URING_BLOCK_DONE && b->len < 0)) {
+        ret = uring_drain(c);
+        if (ret < 0)
+            return ret;
+        for (int i = 0; i < ur->nb_blocks; i++)
+            ur->blocks[i].state = URING_BLOCK_IDLE;
+        ur->head        = 0;
+        ur->next_offset = pos - pos % URING_BLOCK_SIZE;
+    }
+    ur->pos = pos;
+    return pos;
+}
+
+#endif /* HAVE_LINUX_IO_URING_H */
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
+#if HAVE_LINUX_IO_URING_H
+    if (c->ur)
+        return uring_read(h, buf, size);
+#endif
     size = FFMIN(size, c->blocksize);
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
@@ -153,6 +543,10 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
+#if HAVE_LINUX_IO_URING_H
+    if (c->ur)
+        return uring_write(h, buf, size);
+#endif
     size = FFMIN(size, c->blocksize);
     ret = write(c->fd, buf, size);
     return (ret == -1) ? AVERROR(errno) : ret;
@@ -221,8 +615,16 @@ static int fd_dup(URLContext *h, int oldfd)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    int ret = close(c->fd);
-    return (ret == -1) ? AVERROR(errno) : 0;
+    int ret = 0;
+#if HAVE_LINUX_IO_URING_H
+    if (c->ur) {
+        ret = c->ur->write ? uring_flush(c) : uring_drain(c);
+        uring_free(&c->ur);
+    }
+#endif
+    if (close(c->fd) == -1 && ret >= 0)
+        ret = AVERROR(errno);
+    return ret;
 }
 
 /* XXX: use llseek */
@@ -231,6 +633,11 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+#if HAVE_LINUX_IO_URING_H
+    if (c->ur)
+        return uring_seek(h, pos, whence);
+#endif
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
         ret = fstat(c->fd, &st);
@@ -303,13 +710,42 @@ static int file_open(URLContext *h, const char *filename, int flags)
 #ifdef O_BINARY
     access |= O_BINARY;
 #endif
-    fd = avpriv_open(filename, access, 0666);
+    fd = -1;
+#if HAVE_LINUX_IO_URING_H && defined(O_DIRECT)
+    if (c->io_uring && c->direct && access == O_RDONLY) {
+        fd = avpriv_open(filename, access | O_DIRECT, 0666);
+        if (fd == -1)
+            av_log(h, AV_LOG_WARNING, "Cannot open with O_DIRECT: %s\n",
+                   av_err2str(AVERROR(errno)));
+    }
+#endif
+    if (fd == -1)
+        fd = avpriv_open(filename, access, 0666);
     if (fd == -1)
         return AVERROR(errno);
     c->fd = fd;
 
     h->is_streamed = !fstat(fd, &st) && S_ISFIFO(st.st_mode);
 
+#if HAVE_LINUX_IO_URING_H
+    /* read-ahead and write-behind only make sense with regular files */
+    if (c->io_uring && !(flags & AVIO_FLAG_READ && flags & AVIO_FLAG_WRITE) &&
+        !c->follow && S_ISREG(st.st_mode)) {
+        int ret = uring_init(h, !!(flags & AVIO_FLAG_WRITE));
+        if (ret < 0)
+            av_log(h, AV_LOG_WARNING, "Cannot use io_uring: %s\n", av_err2str(ret));
+    }
+#ifdef O_DIRECT
+    /* plain reads have no aligned buffers */
+    if (!c->ur && fcntl(fd, F_GETFL) & O_DIRECT &&
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT) == -1) {
+        int ret = AVERROR(errno);
+        close(fd);
+        return ret;
+    }
+#endif
+#endif
+
     /* Buffer writes more than the default 32k to improve throughput especially
      * with networked file systems */
     if (!h->is_streamed && flags & AVIO_FLAG_WRITE)
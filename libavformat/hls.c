@@ -29,7 +29,6 @@
 
 #include "config_components.h"
 
-#include "libavformat/http.h"
 #include "libavutil/aes.h"
 #include "libavutil/avstring.h"
 #include "libavutil/avassert.h"
@@ -47,6 +46,7 @@
 #include "url.h"
 
 #include "hls_sample_encryption.h"
+#include "segfetch.h"
 
 #define INITIAL_BUFFER_SIZE 32768
 
@@ -173,6 +173,9 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    /* Segments downloaded ahead of the current one, if enabled */
+    SegPrefetch prefetch;
 };
 
 /*
@@ -228,8 +231,12 @@ typedef struct HLSContext {
     int http_multiple;
     int http_seekable;
     int seg_max_retry;
+    int prefetch_segments;
+    int prefetch_size;
     AVIOContext *playlist_pb;
     HLSCryptoContext  crypto_ctx;
+    /* Persistent HTTP connections with no request in flight */
+    SegConnPool conn_pool;
 } HLSContext;
 
 static void free_segment_dynarray(struct segment **segments, int n_segments)
@@ -266,6 +273,7 @@ static void free_playlist_list(HLSContext *c)
     int i;
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
+        ff_seg_prefetch_free(&pls->prefetch);
         free_segment_list(pls);
         free_init_section_list(pls);
         av_freep(&pls->main_streams);
@@ -626,24 +634,6 @@ static int ensure_playlist(HLSContext *c, struct playlist **pls, const char *url
     return 0;
 }
 
-static int open_url_keepalive(AVFormatContext *s, AVIOContext **pb,
-                              const char *url, AVDictionary **options)
-{
-#if !CONFIG_HTTP_PROTOCOL
-    return AVERROR_PROTOCOL_NOT_FOUND;
-#else
-    int ret;
-    URLContext *uc = ffio_geturlcontext(*pb);
-    av_assert0(uc);
-    (*pb)->eof_reached = 0;
-    ret = ff_http_do_new_request2(uc, url, options);
-    if (ret < 0) {
-        ff_format_io_close(s, pb);
-    }
-    return ret;
-#endif
-}
-
 static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
                     AVDictionary **opts, AVDictionary *opts2, int *is_http_out)
 {
@@ -695,8 +685,16 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     av_dict_copy(&tmp, *opts, 0);
     av_dict_copy(&tmp, opts2, 0);
 
+    if (is_http && c->http_persistent && !*pb) {
+        *pb = ff_seg_conn_pool_get(&c->conn_pool, url);
+        if (*pb) {
+            /* do not inherit the byte range of the previous request */
+            av_dict_set(&tmp, "offset", "0", AV_DICT_DONT_OVERWRITE);
+            av_dict_set(&tmp, "end_offset", "0", AV_DICT_DONT_OVERWRITE);
+        }
+    }
     if (is_http && c->http_persistent && *pb) {
-        ret = open_url_keepalive(c->ctx, pb, url, &tmp);
+        ret = ff_seg_keepalive_request(c->ctx, pb, url, &tmp);
         if (ret == AVERROR_EXIT) {
             av_dict_free(&tmp);
             return ret;
@@ -756,7 +754,7 @@ static int parse_playlist(HLSContext *c, const char *url,
 
     if (is_http && !in && c->http_persistent && c->playlist_pb) {
         in = c->playlist_pb;
-        ret = open_url_keepalive(c->ctx, &c->playlist_pb, url, NULL);
+        ret = ff_seg_keepalive_request(c->ctx, &c->playlist_pb, url, NULL);
         if (ret == AVERROR_EXIT) {
             return ret;
         } else if (ret < 0) {
@@ -1072,7 +1070,9 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    ret = ff_seg_prefetch_read(&pls->prefetch, buf, buf_size);
+    if (!ret)
+        ret = pls->input ? avio_read(pls->input, buf, buf_size) : AVERROR_EOF;
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1363,6 +1363,109 @@ cleanup:
     return ret;
 }
 
+static int prefetch_get_segment(void *opaque, int64_t seq_no, SegPrefetchEntry *e)
+{
+    struct playlist *pls = opaque;
+    HLSContext *c = pls->parent->priv_data;
+    struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+
+    /* encrypted segments need the key state of the playlist */
+    if (seg->key_type != KEY_NONE)
+        return 0;
+
+    e->url        = av_strdup(seg->url);
+    e->url_offset = seg->url_offset;
+    e->size       = seg->size;
+    if (!e->url || av_dict_copy(&e->avio_opts, c->avio_opts, 0) < 0)
+        return AVERROR(ENOMEM);
+    return 1;
+}
+
+static int prefetch_open(void *opaque, SegPrefetchEntry *e)
+{
+    struct playlist *pls = opaque;
+    HLSContext *c = pls->parent->priv_data;
+    AVDictionary *opts = NULL;
+    int is_http = 0;
+    int ret;
+
+    if (c->http_persistent)
+        av_dict_set(&opts, "multiple_requests", "1", 0);
+    if (e->size >= 0) {
+        av_dict_set_int(&opts, "offset", e->url_offset, 0);
+        av_dict_set_int(&opts, "end_offset", e->url_offset + e->size, 0);
+    }
+
+    av_log(pls->parent, AV_LOG_VERBOSE, "HLS prefetch for url '%s', offset %"PRId64", playlist %d\n",
+           e->url, e->url_offset, pls->index);
+
+    ret = open_url(pls->parent, &e->input, e->url, &e->avio_opts, opts, &is_http);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    /* see open_input() */
+    if (!is_http && e->url_offset) {
+        int64_t seekret = avio_seek(e->input, e->url_offset, SEEK_SET);
+        if (seekret < 0)
+            return seekret;
+    }
+
+    return 0;
+}
+
+static void prefetch_release(void *opaque, AVIOContext **pb)
+{
+    struct playlist *pls = opaque;
+    HLSContext *c = pls->parent->priv_data;
+
+    if (c->http_persistent)
+        ff_seg_conn_pool_put(pls->parent, &c->conn_pool, pb);
+    else
+        ff_format_io_close(pls->parent, pb);
+}
+
+/* Queue the segments following the current one for download, dropping
+ * the ones that are no longer ahead of it. */
+static void prefetch_schedule(HLSContext *c, struct playlist *pls)
+{
+    SegPrefetch *p = &pls->prefetch;
+
+    if (!p->entries) {
+        int ret;
+
+        p->opaque      = pls;
+        p->get_segment = prefetch_get_segment;
+        p->open        = prefetch_open;
+        p->release     = prefetch_release;
+        p->max_size    = c->prefetch_size;
+        ret = ff_seg_prefetch_init(p, pls->parent, c->prefetch_segments + 1,
+                                   "hls-prefetch");
+        if (ret < 0) {
+            av_log(pls->parent, AV_LOG_WARNING,
+                   "Failed to start prefetching for playlist %d, disabling\n", pls->index);
+            ff_seg_prefetch_free(p);
+            c->prefetch_segments = 0;
+            return;
+        }
+    }
+
+    ff_seg_prefetch_schedule(p, pls->cur_seq_no + 1,
+                             FFMIN(pls->cur_seq_no + c->prefetch_segments,
+                                   pls->start_seq_no + pls->n_segments - 1));
+}
+
+/* Make the prefetched copy of the current segment, if any, the input. */
+static int prefetch_take(struct playlist *pls, struct segment *seg)
+{
+    if (!ff_seg_prefetch_take(&pls->prefetch, pls->cur_seq_no, seg->url,
+                              seg->url_offset, seg->size, &pls->input))
+        return 0;
+
+    pls->cur_seg_offset = 0;
+    return 1;
+}
+
 static int update_init_section(struct playlist *pls, struct segment *seg)
 {
     static const int max_init_section_size = 1024*1024;
@@ -1487,7 +1590,8 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if ((!v->input && !v->prefetch.buf) ||
+        (c->http_persistent && v->input_read_done)) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1558,7 +1662,9 @@ reload:
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (c->prefetch_segments && prefetch_take(v, seg)) {
+            ret = 0;
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
@@ -1585,9 +1691,12 @@ reload:
         }
         segment_retries = 0;
         just_opened = 1;
+
+        if (c->prefetch_segments)
+            prefetch_schedule(c, v);
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && v->input) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1597,7 +1706,7 @@ reload:
     }
 
     seg = next_segment(v);
-    if (c->http_multiple == 1 && !v->input_next_requested &&
+    if (c->http_multiple == 1 && !v->input_next_requested && !c->prefetch_segments &&
         seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
@@ -1636,6 +1745,7 @@ reload:
     } else {
         ff_format_io_close(v->parent, &v->input);
     }
+    ff_seg_prefetch_buf_free(&v->prefetch);
     v->cur_seq_no++;
 
     c->cur_seq_no = v->cur_seq_no;
@@ -1923,6 +2033,7 @@ static int hls_close(AVFormatContext *s)
 
     av_dict_free(&c->avio_opts);
     ff_format_io_close(c->ctx, &c->playlist_pb);
+    ff_seg_conn_pool_uninit(s, &c->conn_pool);
 
     return 0;
 }
@@ -1940,6 +2051,9 @@ static int hls_read_header(AVFormatContext *s)
     c->first_timestamp = AV_NOPTS_VALUE;
     c->cur_timestamp = AV_NOPTS_VALUE;
 
+    if ((ret = ff_seg_conn_pool_init(&c->conn_pool)) < 0)
+        return ret;
+
     if ((ret = ffio_copy_url_options(s->pb, &c->avio_opts)) < 0)
         return ret;
 
@@ -2498,6 +2612,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
         pls->input_next_requested = 0;
+        ff_seg_prefetch_flush(&pls->prefetch);
         av_packet_unref(pls->pkt);
         pb->eof_reached = 0;
         /* Clear any buffered data */
@@ -2590,6 +2705,10 @@ static const AVOption hls_options[] = {
         OFFSET(seg_format_opts), AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, FLAGS},
     {"seg_max_retry", "Maximum number of times to reload a segment on error.",
      OFFSET(seg_max_retry), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
+    {"prefetch_segments", "Number of segments to download ahead of the current one, 0 = disable",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
+    {"prefetch_size", "Maximum number of bytes buffered for each prefetched segment",
+        OFFSET(prefetch_size), AV_OPT_TYPE_INT, {.i64 = 8 * 1024 * 1024}, 4096, INT_MAX, FLAGS},
     {NULL}
 };
 
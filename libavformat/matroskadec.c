@@ -46,6 +46,7 @@
 #include "libavutil/lzo.h"
 #include "libavutil/mastering_display_metadata.h"
 #include "libavutil/mathematics.h"
+#include "libavutil/md5.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
@@ -400,6 +401,7 @@ typedef struct MatroskaDemuxContext {
     char    *title;
     char    *muxingapp;
     EbmlBin  date_utc;
+    EbmlBin  segment_uid;
     EbmlList tracks;
     EbmlList attachments;
     EbmlList chapters;
@@ -439,6 +441,14 @@ typedef struct MatroskaDemuxContext {
 
     /* Bandwidth value for WebM DASH Manifest */
     int bandwidth;
+
+    /* Sidecar file caching the index of files without Cues */
+    char *seek_index;
+    char index_key[2 * 16 + 1]; ///< identifies the input, set once the header was read
+    int64_t index_input_size;
+    int index_loaded;       ///< index entries were read from seek_index
+    int index_complete;     ///< the index covers every cluster of the file
+    int index_scan_broken;  ///< clusters were skipped by seeking
 } MatroskaDemuxContext;
 
 #define CHILD_OF(parent) { .def = { .n = parent } }
@@ -478,7 +488,7 @@ static EbmlSyntax matroska_info[] = {
     { MATROSKA_ID_WRITINGAPP,    EBML_NONE },
     { MATROSKA_ID_MUXINGAPP,     EBML_UTF8, 0, 0, offsetof(MatroskaDemuxContext, muxingapp) },
     { MATROSKA_ID_DATEUTC,       EBML_BIN,  0, 0, offsetof(MatroskaDemuxContext, date_utc) },
-    { MATROSKA_ID_SEGMENTUID,    EBML_NONE },
+    { MATROSKA_ID_SEGMENTUID,    EBML_BIN,  0, 0, offsetof(MatroskaDemuxContext, segment_uid) },
     CHILD_OF(matroska_segment)
 };
 
@@ -2039,6 +2049,184 @@ static void matroska_parse_cues(MatroskaDemuxContext *matroska) {
     matroska_add_index_entries(matroska);
 }
 
+static int matroska_has_cues(const MatroskaDemuxContext *matroska)
+{
+    if (matroska->index.nb_elem)
+        return 1;
+    for (int i = 0; i < matroska->num_level1_elems; i++)
+        if (matroska->level1_elems[i].id == MATROSKA_ID_CUES)
+            return 1;
+    return 0;
+}
+
+#define SEEK_INDEX_MAGIC "ffmkvidx 2"
+#define SEEK_INDEX_TAIL_SIZE (64 * 1024)
+
+static int seek_index_hash_range(AVIOContext *pb, struct AVMD5 *md5,
+                                 int64_t start, int64_t end)
+{
+    uint8_t buf[4096];
+
+    if (avio_seek(pb, start, SEEK_SET) < 0)
+        return AVERROR(EIO);
+    while (start < end) {
+        int ret = avio_read(pb, buf, FFMIN(sizeof(buf), end - start));
+        if (ret <= 0)
+            return ret < 0 ? ret : AVERROR(EIO);
+        av_md5_update(md5, buf, ret);
+        start += ret;
+    }
+    return 0;
+}
+
+/*
+ * Compute the key identifying the input in the seek index file: a hash of
+ * the SegmentUID, of everything in front of the first Cluster and of the
+ * end of the file. The option is only used for files without Cues, so the
+ * end of the file stands in for them.
+ */
+static int matroska_seek_index_key(AVFormatContext *s, int64_t size)
+{
+    MatroskaDemuxContext *matroska = s->priv_data;
+    int64_t data_offset = ffformatcontext(s)->data_offset;
+    int64_t pos = avio_tell(s->pb);
+    struct AVMD5 *md5;
+    uint8_t digest[16];
+    int ret;
+
+    if (data_offset <= 0)
+        return AVERROR(EINVAL);
+    if (!(md5 = av_md5_alloc()))
+        return AVERROR(ENOMEM);
+
+    av_md5_init(md5);
+    av_md5_update(md5, matroska->segment_uid.data, matroska->segment_uid.size);
+    ret = seek_index_hash_range(s->pb, md5, 0, data_offset);
+    if (ret >= 0)
+        ret = seek_index_hash_range(s->pb, md5,
+                                    FFMAX(data_offset, size - SEEK_INDEX_TAIL_SIZE),
+                                    size);
+    av_md5_final(md5, digest);
+    av_free(md5);
+
+    if (avio_seek(s->pb, pos, SEEK_SET) < 0)
+        return AVERROR(EIO);
+    if (ret < 0)
+        return ret;
+
+    ff_data_to_hex(matroska->index_key, digest, sizeof(digest), 1);
+    matroska->index_key[2 * sizeof(digest)] = 0;
+    matroska->index_input_size = size;
+    return 0;
+}
+
+/*
+ * The seek index file is a text file: a magic line, the size and the key of
+ * the indexed file, whether the whole file was scanned, followed by one
+ * "track pos timestamp" line per keyframe.
+ */
+static void matroska_read_seek_index(AVFormatContext *s)
+{
+    MatroskaDemuxContext *matroska = s->priv_data;
+    AVIOContext *pb = NULL;
+    int64_t size, index_size = -1;
+    int complete = 0, nb_entries = 0;
+    char line[256];
+
+    if (!matroska->seek_index || s->flags & AVFMT_FLAG_IGNIDX ||
+        matroska_has_cues(matroska) || !(s->pb->seekable & AVIO_SEEKABLE_NORMAL))
+        return;
+
+    size = avio_size(s->pb);
+    if (size <= 0 || matroska_seek_index_key(s, size) < 0) {
+        av_log(s, AV_LOG_WARNING, "Cannot identify the input, not using seek index %s\n",
+               matroska->seek_index);
+        return;
+    }
+
+    if (s->io_open(s, &pb, matroska->seek_index, AVIO_FLAG_READ, NULL) < 0) {
+        av_log(s, AV_LOG_VERBOSE, "No seek index in %s\n", matroska->seek_index);
+        return;
+    }
+
+    ff_get_chomp_line(pb, line, sizeof(line));
+    if (strcmp(line, SEEK_INDEX_MAGIC))
+        goto invalid;
+    ff_get_chomp_line(pb, line, sizeof(line));
+    if (sscanf(line, "size %"SCNd64, &index_size) != 1 || index_size != size)
+        goto invalid;
+    ff_get_chomp_line(pb, line, sizeof(line));
+    if (!av_strstart(line, "key ", NULL) || strcmp(line + 4, matroska->index_key))
+        goto invalid;
+    ff_get_chomp_line(pb, line, sizeof(line));
+    if (sscanf(line, "complete %d", &complete) != 1)
+        goto invalid;
+
+    while (ff_get_chomp_line(pb, line, sizeof(line))) {
+        MatroskaTrack *track;
+        uint64_t num;
+        int64_t pos, timestamp;
+
+        if (sscanf(line, "%"SCNu64" %"SCNd64" %"SCNd64, &num, &pos, &timestamp) != 3 ||
+            pos < matroska->segment_start || pos >= size)
+            goto invalid;
+        track = matroska_find_track_by_num(matroska, num);
+        if (track && track->stream)
+            av_add_index_entry(track->stream, pos, timestamp, 0, 0, AVINDEX_KEYFRAME);
+        nb_entries++;
+    }
+
+    av_log(s, AV_LOG_VERBOSE, "Loaded %d index entries from %s\n",
+           nb_entries, matroska->seek_index);
+    matroska->index_loaded   = 1;
+    matroska->index_complete = !!complete;
+    ff_format_io_close(s, &pb);
+    return;
+invalid:
+    av_log(s, AV_LOG_WARNING, "Ignoring seek index %s, it does not match the input\n",
+           matroska->seek_index);
+    ff_format_io_close(s, &pb);
+}
+
+static void matroska_write_seek_index(AVFormatContext *s)
+{
+    MatroskaDemuxContext *matroska = s->priv_data;
+    MatroskaTrack *tracks = matroska->tracks.elem;
+    int complete = matroska->done && !matroska->index_scan_broken;
+    int nb_entries = 0;
+    AVIOContext *pb;
+
+    /* the key is only set once the header was read successfully */
+    if (!matroska->index_key[0] ||
+        (matroska->index_loaded && (matroska->index_complete || !complete)))
+        return;
+
+    for (int i = 0; i < matroska->tracks.nb_elem; i++)
+        if (tracks[i].stream)
+            nb_entries += cffstream(tracks[i].stream)->nb_index_entries;
+    if (!nb_entries)
+        return;
+
+    if (s->io_open(s, &pb, matroska->seek_index, AVIO_FLAG_WRITE, NULL) < 0) {
+        av_log(s, AV_LOG_WARNING, "Cannot write seek index %s\n", matroska->seek_index);
+        return;
+    }
+
+    avio_printf(pb, SEEK_INDEX_MAGIC "\nsize %"PRId64"\nkey %s\ncomplete %d\n",
+                matroska->index_input_size, matroska->index_key, complete);
+    for (int i = 0; i < matroska->tracks.nb_elem; i++) {
+        const FFStream *sti;
+
+        if (!tracks[i].stream)
+            continue;
+        sti = cffstream(tracks[i].stream);
+        for (int j = 0; j < sti->nb_index_entries; j++)
+            avio_printf(pb, "%"PRIu64" %"PRId64" %"PRId64"\n", tracks[i].num,
+                        sti->index_entries[j].pos, sti->index_entries[j].timestamp);
+    }
+    ff_format_io_close(s, &pb);
+}
+
 static int matroska_parse_content_encodings(MatroskaTrackEncoding *encodings,
                                             unsigned nb_encodings,
                                             MatroskaTrack *track,
@@ -3440,6 +3628,7 @@ static int matroska_read_header(AVFormatContext *s)
         }
 
     matroska_add_index_entries(matroska);
+    matroska_read_seek_index(s);
 
     matroska_convert_tags(s);
 
@@ -4322,6 +4511,8 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
     FFStream *const sti = ffstream(st);
     int i, index;
 
+    matroska->index_scan_broken = 1;
+
     /* Parse the CUES now since we need the index data to seek. */
     if (matroska->cues_parsing_deferred > 0) {
         matroska->cues_parsing_deferred = 0;
@@ -4332,8 +4523,9 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
         goto err;
     timestamp = FFMAX(timestamp, sti->index_entries[0].timestamp);
 
-    if ((index = av_index_search_timestamp(st, timestamp, flags)) < 0 ||
-         index == sti->nb_index_entries - 1) {
+    /* Without a complete index, read ahead until the next keyframe is known. */
+    if (((index = av_index_search_timestamp(st, timestamp, flags)) < 0 ||
+         index == sti->nb_index_entries - 1) && !matroska->index_complete) {
         matroska_reset_status(matroska, 0, sti->index_entries[sti->nb_index_entries - 1].pos);
         while ((index = av_index_search_timestamp(st, timestamp, flags)) < 0 ||
                index == sti->nb_index_entries - 1) {
@@ -4388,6 +4580,7 @@ static int matroska_read_close(AVFormatContext *s)
     int n;
 
     matroska_clear_queue(matroska);
+    matroska_write_seek_index(s);
 
     for (n = 0; n < matroska->tracks.nb_elem; n++)
         if (tracks[n].type == MATROSKA_TRACK_TYPE_AUDIO)
@@ -4397,6 +4590,8 @@ static int matroska_read_close(AVFormatContext *s)
     return 0;
 }
 
+#define OFFSET(x) offsetof(MatroskaDemuxContext, x)
+
 #if CONFIG_WEBM_DASH_MANIFEST_DEMUXER
 typedef struct {
     int64_t start_time_ns;
@@ -4815,7 +5010,6 @@ static int webm_dash_manifest_read_packet(AVFormatContext *s, AVPacket *pkt)
     return AVERROR_EOF;
 }
 
-#define OFFSET(x) offsetof(MatroskaDemuxContext, x)
 static const AVOption options[] = {
     { "live", "flag indicating that the input is a live file that only has the headers.", OFFSET(is_live), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "bandwidth", "bandwidth of this stream to be specified in the DASH manifest.", OFFSET(bandwidth), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM },
@@ -4841,11 +5035,24 @@ const FFInputFormat ff_webm_dash_manifest_demuxer = {
 };
 #endif
 
+static const AVOption matroska_options[] = {
+    { "seek_index", "file caching the seek index of inputs without Cues", OFFSET(seek_index), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass matroska_class = {
+    .class_name = "matroska,webm demuxer",
+    .item_name  = av_default_item_name,
+    .option     = matroska_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 const FFInputFormat ff_matroska_demuxer = {
     .p.name         = "matroska,webm",
     .p.long_name    = NULL_IF_CONFIG_SMALL("Matroska / WebM"),
     .p.extensions   = "mkv,mk3d,mka,mks,webm",
     .p.mime_type    = "audio/webm,audio/x-matroska,video/webm,video/x-matroska",
+    .p.priv_class   = &matroska_class,
     .priv_data_size = sizeof(MatroskaDemuxContext),
     .flags_internal = FF_INFMT_FLAG_INIT_CLEANUP,
     .read_probe     = matroska_probe,
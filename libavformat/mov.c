@@ -4094,11 +4094,307 @@ static int64_t add_ctts_entry(MOVCtts** ctts_data, unsigned int* ctts_count, uns
     return *ctts_count;
 }
 
+/**
+ * Sample index resolved on demand from the sample tables, used instead of
+ * the AVIndexEntry array when the lazy_index option is set. Only prefix
+ * sums over the run-length coded tables are kept, so that any sample can
+ * be located with a binary search.
+ */
+typedef struct MOVLazyIndex {
+    unsigned int nb_samples;
+    int64_t start_dts;          ///< dts of the first sample
+    int key_off;                ///< 1 if stss/stps sample numbers are 1-based
+    int64_t *stts_dts;          ///< dts of the first sample of each stts entry, relative to start_dts
+    unsigned int *stts_sample;  ///< first sample of each stts entry
+    unsigned int *stsc_sample;  ///< first sample of each stsc entry
+    unsigned int *ctts_sample;  ///< first sample of each ctts entry
+    unsigned int *rap_sample;   ///< first sample of each rap group entry, plus the end
+    int cur_sample;             ///< sample described by entry, -1 if none
+    int64_t cur_chunk;
+    AVIndexEntry entry;
+} MOVLazyIndex;
+
+static void mov_free_lazy_index(MOVLazyIndex **pli)
+{
+    MOVLazyIndex *li = *pli;
+
+    if (!li)
+        return;
+    av_freep(&li->stts_dts);
+    av_freep(&li->stts_sample);
+    av_freep(&li->stsc_sample);
+    av_freep(&li->ctts_sample);
+    av_freep(&li->rap_sample);
+    av_freep(pli);
+}
+
+/* Return the index of the last element of tab which is <= val, or -1. */
+static int lazy_find_last_le(const unsigned int *tab, unsigned int count, uint64_t val)
+{
+    int lo = -1, hi = count;
+
+    while (hi - lo > 1) {
+        int mid = (lo + hi) >> 1;
+        if (tab[mid] <= val)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int64_t mov_lazy_dts(const MOVStreamContext *sc, unsigned int sample)
+{
+    const MOVLazyIndex *li = sc->lazy_index;
+    int i = lazy_find_last_le(li->stts_sample, sc->stts_count, sample);
+
+    return li->start_dts + li->stts_dts[i] +
+           (int64_t)(sample - li->stts_sample[i]) * sc->stts_data[i].duration;
+}
+
+static int mov_lazy_is_keyframe(const AVStream *st, unsigned int sample)
+{
+    const MOVStreamContext *sc = st->priv_data;
+    const MOVLazyIndex *li = sc->lazy_index;
+    uint64_t num = sample + (uint64_t)li->key_off;
+    int i;
+
+    if (sc->keyframe_absent && !sc->stps_count && !li->rap_sample)
+        return st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO || !sample;
+
+    if (!sc->keyframe_absent) {
+        if (!sc->keyframe_count)
+            return 1;
+        i = lazy_find_last_le((const unsigned int *)sc->keyframes, sc->keyframe_count, num);
+        if (i >= 0 && sc->keyframes[i] == num)
+            return 1;
+    }
+    if (sc->stps_count) {
+        i = lazy_find_last_le(sc->stps_data, sc->stps_count, num);
+        if (i >= 0 && sc->stps_data[i] == num)
+            return 1;
+    }
+    if (li->rap_sample && sample < li->rap_sample[sc->rap_group_count]) {
+        i = lazy_find_last_le(li->rap_sample, sc->rap_group_count, sample);
+        if (sc->rap_group[i].index > 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * Find the closest keyframe at or before (backward) or at or after sample.
+ * @return the keyframe, -1 or nb_samples if there is none
+ */
+static int mov_lazy_find_keyframe(const AVStream *st, int sample, int backward)
+{
+    const MOVStreamContext *sc = st->priv_data;
+    const MOVLazyIndex *li = sc->lazy_index;
+
+    if (!sc->keyframe_absent && sc->keyframe_count && !sc->stps_count && !li->rap_sample) {
+        /* only stss, the keyframes can be looked up directly */
+        int64_t num = sample + (int64_t)li->key_off;
+        int i = lazy_find_last_le((const unsigned int *)sc->keyframes, sc->keyframe_count, num);
+
+        if (backward)
+            return i < 0 ? -1 : sc->keyframes[i] - li->key_off;
+        if (i < 0 || sc->keyframes[i] != num)
+            i++;
+        if (i >= sc->keyframe_count || sc->keyframes[i] - li->key_off >= li->nb_samples)
+            return li->nb_samples;
+        return sc->keyframes[i] - li->key_off;
+    }
+
+    while (sample >= 0 && sample < li->nb_samples && !mov_lazy_is_keyframe(st, sample))
+        sample += backward ? -1 : 1;
+    return sample;
+}
+
+/* Same semantics as av_index_search_timestamp(). */
+static int mov_lazy_search_timestamp(const AVStream *st, int64_t wanted_timestamp, int flags)
+{
+    const MOVStreamContext *sc = st->priv_data;
+    const MOVLazyIndex *li = sc->lazy_index;
+    int backward = flags & AVSEEK_FLAG_BACKWARD;
+    int lo = -1, hi = li->nb_samples;
+    int m;
+
+    /* first sample with a dts >= wanted_timestamp for forward searches,
+     * first sample with a dts > wanted_timestamp for backward searches */
+    while (hi - lo > 1) {
+        int mid = (lo + hi) >> 1;
+        int64_t ts = mov_lazy_dts(sc, mid);
+        if (ts > wanted_timestamp || (!backward && ts == wanted_timestamp))
+            hi = mid;
+        else
+            lo = mid;
+    }
+    m = backward ? lo : hi;
+
+    if (!(flags & AVSEEK_FLAG_ANY))
+        m = mov_lazy_find_keyframe(st, m, backward);
+
+    if (m == li->nb_samples)
+        return -1;
+    return m;
+}
+
+static AVIndexEntry *mov_lazy_get_sample(const AVStream *st, int sample)
+{
+    const MOVStreamContext *sc = st->priv_data;
+    MOVLazyIndex *li = sc->lazy_index;
+    AVIndexEntry *e = &li->entry;
+    unsigned int in_chunk;
+    int64_t chunk, pos;
+    int i;
+
+    if (sample == li->cur_sample)
+        return e;
+
+    i = lazy_find_last_le(li->stsc_sample, sc->stsc_count, sample);
+    chunk    = sc->stsc_data[i].first - 1 + (sample - li->stsc_sample[i]) / sc->stsc_data[i].count;
+    in_chunk = (sample - li->stsc_sample[i]) % sc->stsc_data[i].count;
+    if (li->cur_sample >= 0 && sample == li->cur_sample + 1 && chunk == li->cur_chunk) {
+        pos = e->pos + e->size;
+    } else if (sc->stsz_sample_size) {
+        pos = sc->chunk_offsets[chunk] + (int64_t)in_chunk * sc->stsz_sample_size;
+    } else {
+        pos = sc->chunk_offsets[chunk];
+        for (unsigned int j = sample - in_chunk; j < sample; j++)
+            pos += sc->sample_sizes[j];
+    }
+
+    e->pos          = pos;
+    e->timestamp    = mov_lazy_dts(sc, sample);
+    e->size         = sc->stsz_sample_size ? sc->stsz_sample_size : sc->sample_sizes[sample];
+    e->min_distance = 0;
+    e->flags        = mov_lazy_is_keyframe(st, sample) ? AVINDEX_KEYFRAME : 0;
+    li->cur_sample  = sample;
+    li->cur_chunk   = chunk;
+
+    return e;
+}
+
+/* Update the ctts and stsc positions after seeking to sc->current_sample. */
+static void mov_lazy_seek_tables(MOVStreamContext *sc)
+{
+    const MOVLazyIndex *li = sc->lazy_index;
+    unsigned int sample = sc->current_sample;
+    int i;
+
+    if (sc->ctts_data) {
+        i = lazy_find_last_le(li->ctts_sample, sc->ctts_count, sample);
+        if (sample - li->ctts_sample[i] < sc->ctts_data[i].count) {
+            sc->ctts_index  = i;
+            sc->ctts_sample = sample - li->ctts_sample[i];
+        }
+    }
+
+    if (sample < li->nb_samples) {
+        i = lazy_find_last_le(li->stsc_sample, sc->stsc_count, sample);
+        sc->stsc_index  = i;
+        sc->stsc_sample = sample - li->stsc_sample[i];
+    }
+}
+
+/* Accessors for the sample index, whichever form it is stored in. */
+static int mov_nb_samples(const AVStream *st)
+{
+    const MOVStreamContext *sc = st->priv_data;
+
+    return sc->lazy_index ? sc->lazy_index->nb_samples : cffstream(st)->nb_index_entries;
+}
+
+static int64_t mov_sample_dts(const AVStream *st, int sample)
+{
+    const MOVStreamContext *sc = st->priv_data;
+
+    return sc->lazy_index ? mov_lazy_dts(sc, sample) : cffstream(st)->index_entries[sample].timestamp;
+}
+
+static AVIndexEntry *mov_get_sample(const AVStream *st, int sample)
+{
+    const MOVStreamContext *sc = st->priv_data;
+
+    return sc->lazy_index ? mov_lazy_get_sample(st, sample) : &cffstream(st)->index_entries[sample];
+}
+
+static int mov_search_sample(AVStream *st, int64_t timestamp, int flags)
+{
+    const MOVStreamContext *sc = st->priv_data;
+
+    return sc->lazy_index ? mov_lazy_search_timestamp(st, timestamp, flags)
+                          : av_index_search_timestamp(st, timestamp, flags);
+}
+
+/**
+ * Convert a lazy index into regular index entries and a one entry per
+ * sample ctts table, for code which needs to modify the index.
+ */
+static int mov_expand_lazy_index(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    FFStream *const sti = ffstream(st);
+    MOVLazyIndex *li = sc->lazy_index;
+    MOVCtts *ctts_data_old = sc->ctts_data;
+    unsigned int ctts_count_old = sc->ctts_count;
+    unsigned int distance = 0;
+
+    if (!li)
+        return 0;
+
+    sti->index_entries = av_malloc_array(li->nb_samples, sizeof(*sti->index_entries));
+    if (!sti->index_entries)
+        return AVERROR(ENOMEM);
+    sti->index_entries_allocated_size = li->nb_samples * sizeof(*sti->index_entries);
+
+    if (ctts_data_old) {
+        sc->ctts_count = 0;
+        sc->ctts_allocated_size = 0;
+        sc->ctts_data = av_fast_realloc(NULL, &sc->ctts_allocated_size,
+                                        li->nb_samples * sizeof(*sc->ctts_data));
+        if (!sc->ctts_data) {
+            sc->ctts_data = ctts_data_old;
+            sc->ctts_count = ctts_count_old;
+            av_freep(&sti->index_entries);
+            sti->index_entries_allocated_size = 0;
+            return AVERROR(ENOMEM);
+        }
+        memset(sc->ctts_data, 0, sc->ctts_allocated_size);
+        for (unsigned int i = 0; i < ctts_count_old && sc->ctts_count < li->nb_samples; i++)
+            for (unsigned int j = 0; j < ctts_data_old[i].count && sc->ctts_count < li->nb_samples; j++)
+                add_ctts_entry(&sc->ctts_data, &sc->ctts_count,
+                               &sc->ctts_allocated_size, 1,
+                               ctts_data_old[i].duration);
+        av_free(ctts_data_old);
+    }
+
+    for (int i = 0; i < li->nb_samples; i++) {
+        AVIndexEntry *e = &sti->index_entries[i];
+
+        *e = *mov_lazy_get_sample(st, i);
+        if (e->flags & AVINDEX_KEYFRAME)
+            distance = 0;
+        e->min_distance = distance++;
+    }
+    sti->nb_index_entries = li->nb_samples;
+
+    /* the expanded ctts table has one entry per sample */
+    if (sc->ctts_data && sc->current_sample < sc->ctts_count) {
+        sc->ctts_index  = sc->current_sample;
+        sc->ctts_sample = 0;
+    }
+
+    av_log(mov->fc, AV_LOG_DEBUG, "Expanded lazy index of stream %d to %u entries\n",
+           st->index, li->nb_samples);
+    mov_free_lazy_index(&sc->lazy_index);
+    return 0;
+}
+
 #define MAX_REORDER_DELAY 16
 static void mov_estimate_video_delay(MOVContext *c, AVStream* st)
 {
     MOVStreamContext *msc = st->priv_data;
-    FFStream *const sti = ffstream(st);
     int ctts_ind = 0;
     int ctts_sample = 0;
     int64_t pts_buf[MAX_REORDER_DELAY + 1]; // Circular buffer to sort pts.
@@ -4111,14 +4407,14 @@ static void mov_estimate_video_delay(MOVContext *c, AVStream* st)
     if (st->codecpar->video_delay <= 0 && msc->ctts_data &&
         st->codecpar->codec_id == AV_CODEC_ID_H264) {
         st->codecpar->video_delay = 0;
-        for (int ind = 0; ind < sti->nb_index_entries && ctts_ind < msc->ctts_count; ++ind) {
+        for (int ind = 0; ind < mov_nb_samples(st) && ctts_ind < msc->ctts_count; ++ind) {
             // Point j to the last elem of the buffer and insert the current pts there.
             j = buf_start;
             buf_start = (buf_start + 1);
             if (buf_start == MAX_REORDER_DELAY + 1)
                 buf_start = 0;
 
-            pts_buf[j] = sti->index_entries[ind].timestamp + msc->ctts_data[ctts_ind].duration;
+            pts_buf[j] = mov_sample_dts(st, ind) + msc->ctts_data[ctts_ind].duration;
 
             // The timestamps that are already in the sorted buffer, and are greater than the
             // current pts, are exactly the timestamps that need to be buffered to output PTS
@@ -4579,6 +4875,153 @@ static int build_open_gop_key_points(AVStream *st)
     return 0;
 }
 
+/**
+ * Set up a lazy index for st if the sample tables map 1:1 to the samples
+ * returned by the demuxer, i.e. mov_build_index() would not need to drop,
+ * reorder or retime anything.
+ *
+ * @return 1 if the lazy index is used, 0 if a regular index has to be built
+ */
+static int mov_build_lazy_index(MOVContext *mov, AVStream *st, int64_t start_dts)
+{
+    MOVStreamContext *sc = st->priv_data;
+    FFStream *const sti = ffstream(st);
+    MOVLazyIndex *li;
+    uint64_t stream_size = 0;
+    int64_t edit_duration = 0, total = 0;
+    unsigned int i;
+
+    if (!mov->lazy_index || sti->nb_index_entries || sc->iamf ||
+        (st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO &&
+         st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) ||
+        (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+         sc->stts_count == 1 && sc->stts_data[0].duration == 1) ||
+        !sc->sample_count || sc->sample_count > INT_MAX || !sc->chunk_count ||
+        !sc->stts_count || !sc->stsc_count || sc->stsc_data[0].first != 1 ||
+        (sc->stsz_sample_size && sc->stsz_sample_size != sc->sample_size) ||
+        (!sc->stsz_sample_size && !sc->sample_sizes))
+        return 0;
+
+    /* Edit lists are only handled when they leave the index untouched. */
+    if (sc->elst_count && !mov->ignore_editlist && mov->advanced_editlist) {
+        if (sc->elst_count != 1 || sc->elst_data[0].time || sc->ctts_data ||
+            sc->dts_shift || mov->time_scale <= 0)
+            return 0;
+        edit_duration = av_rescale(sc->elst_data[0].duration, sc->time_scale, mov->time_scale);
+    }
+
+    for (i = 0; i < sc->stsc_count; i++) {
+        if (!sc->stsc_data[i].count || sc->stsc_data[i].first > sc->chunk_count ||
+            (sc->pseudo_stream_id != -1 && sc->stsc_data[i].id - 1 != sc->pseudo_stream_id))
+            return 0;
+        total += mov_get_stsc_samples(sc, i);
+    }
+    if (total != sc->sample_count)
+        return 0;
+    for (i = 0; i + 1 < sc->stts_count; i++)
+        if (!sc->stts_data[i].count)
+            return 0;
+    for (i = 0; i < sc->ctts_count; i++)
+        if (!sc->ctts_data[i].count)
+            return 0;
+    for (i = 0; i < sc->rap_group_count; i++)
+        if (!sc->rap_group[i].count)
+            return 0;
+    for (i = 0; i < sc->keyframe_count; i++)
+        if (sc->keyframes[i] < 0 || (i && sc->keyframes[i] <= sc->keyframes[i - 1]))
+            return 0;
+    for (i = 1; i < sc->stps_count; i++)
+        if (sc->stps_data[i] <= sc->stps_data[i - 1])
+            return 0;
+    for (i = 0; i < sc->sample_count; i++) {
+        unsigned int sample_size = sc->stsz_sample_size ? sc->stsz_sample_size : sc->sample_sizes[i];
+        if (sample_size > 0x3FFFFFFF)
+            return 0;
+        stream_size += sample_size;
+    }
+
+    li = av_mallocz(sizeof(*li));
+    if (!li)
+        return 0;
+    sc->lazy_index = li;
+    li->nb_samples  = sc->sample_count;
+    li->start_dts   = start_dts;
+    li->cur_sample  = -1;
+    li->key_off     = (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0);
+    li->stts_dts    = av_malloc_array(sc->stts_count, sizeof(*li->stts_dts));
+    li->stts_sample = av_malloc_array(sc->stts_count, sizeof(*li->stts_sample));
+    li->stsc_sample = av_malloc_array(sc->stsc_count, sizeof(*li->stsc_sample));
+    if (!li->stts_dts || !li->stts_sample || !li->stsc_sample)
+        goto fail;
+    if (sc->ctts_count && !(li->ctts_sample = av_malloc_array(sc->ctts_count, sizeof(*li->ctts_sample))))
+        goto fail;
+    if (sc->rap_group_count && sc->rap_group &&
+        !(li->rap_sample = av_malloc_array(sc->rap_group_count + 1, sizeof(*li->rap_sample))))
+        goto fail;
+
+    /* the stss/stps walk in mov_build_index() never matches entries below key_off */
+    if ((sc->keyframe_count && sc->keyframes[0] < li->key_off) ||
+        (sc->stps_count && sc->stps_data[0] < li->key_off))
+        goto fail;
+
+    li->stts_dts[0] = li->stts_sample[0] = 0;
+    for (i = 1; i < sc->stts_count; i++) {
+        if (li->stts_sample[i - 1] + (uint64_t)sc->stts_data[i - 1].count > sc->sample_count)
+            break;
+        li->stts_sample[i] = li->stts_sample[i - 1] + sc->stts_data[i - 1].count;
+        li->stts_dts[i]    = li->stts_dts[i - 1] + sc->stts_data[i - 1].count * (int64_t)sc->stts_data[i - 1].duration;
+    }
+    if (i < sc->stts_count)
+        goto fail;
+
+    li->stsc_sample[0] = 0;
+    for (i = 1; i < sc->stsc_count; i++)
+        li->stsc_sample[i] = li->stsc_sample[i - 1] + mov_get_stsc_samples(sc, i - 1);
+
+    for (i = 0, total = 0; i < sc->ctts_count; i++) {
+        li->ctts_sample[i] = FFMIN(total, UINT_MAX);
+        total += sc->ctts_data[i].count;
+    }
+
+    if (li->rap_sample) {
+        for (i = 0, total = 0; i < sc->rap_group_count; i++) {
+            li->rap_sample[i] = FFMIN(total, UINT_MAX);
+            total += sc->rap_group[i].count;
+        }
+        li->rap_sample[i] = FFMIN(total, UINT_MAX);
+    }
+
+    if (edit_duration) {
+        /* replicate what mov_fix_index() does for a single edit covering all samples */
+        if (mov_lazy_dts(sc, li->nb_samples) > edit_duration ||
+            mov_lazy_dts(sc, li->nb_samples - 1) >= edit_duration ||
+            start_dts)
+            goto fail;
+        sc->min_corrected_pts = 0;
+        st->start_time = 0;
+        st->duration = FFMIN(st->duration, edit_duration);
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+            sti->skip_samples = 0;
+        sc->start_pad = sti->skip_samples;
+    } else if (sc->elst_count && !mov->ignore_editlist && mov->advanced_editlist) {
+        goto fail;
+    }
+
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+        for (i = 0; i < FFMIN(li->nb_samples, 99); i++)
+            ff_rfps_add_frame(mov->fc, st, mov_lazy_dts(sc, i));
+
+    if (st->duration > 0)
+        st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
+
+    av_log(mov->fc, AV_LOG_DEBUG, "Using lazy index for stream %d with %u samples\n",
+           st->index, li->nb_samples);
+    return 1;
+fail:
+    mov_free_lazy_index(&sc->lazy_index);
+    return 0;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -4646,9 +5089,12 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             sc->start_pad = start_time;
     }
 
-    /* only use old uncompressed audio chunk demuxing when stts specifies it */
-    if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
-          sc->stts_count == 1 && sc->stts_data[0].duration == 1)) {
+    /* use the lazy index when possible, otherwise
+     * only use old uncompressed audio chunk demuxing when stts specifies it */
+    if (mov_build_lazy_index(mov, st, current_dts - sc->dts_shift)) {
+        /* samples are resolved from the sample tables when needed */
+    } else if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+                 sc->stts_count == 1 && sc->stts_data[0].duration == 1)) {
         unsigned int current_sample = 0;
         unsigned int stts_sample = 0;
         unsigned int sample_size;
@@ -4897,8 +5343,8 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     }
 
     // Update start time of the stream.
-    if (st->start_time == AV_NOPTS_VALUE && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && sti->nb_index_entries > 0) {
-        st->start_time = sti->index_entries[0].timestamp + sc->dts_shift;
+    if (st->start_time == AV_NOPTS_VALUE && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && mov_nb_samples(st) > 0) {
+        st->start_time = mov_sample_dts(st, 0) + sc->dts_shift;
         if (sc->ctts_data) {
             st->start_time += sc->ctts_data[0].duration;
         }
@@ -5209,14 +5655,16 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         && sc->time_scale == st->codecpar->sample_rate) {
             ffstream(st)->need_parsing = AVSTREAM_PARSE_FULL;
     }
-    /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
+    /* Do not need those anymore, unless the lazy index resolves samples from them. */
+    if (!sc->lazy_index) {
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
+        av_freep(&sc->stps_data);
+        av_freep(&sc->rap_group);
+    }
     av_freep(&sc->elst_data);
-    av_freep(&sc->rap_group);
     av_freep(&sc->sync_group);
     av_freep(&sc->sgpd_sync);
 
@@ -5693,7 +6141,7 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     unsigned entries, first_sample_flags = frag->flags;
     int flags, distance, i;
     int64_t prev_dts = AV_NOPTS_VALUE;
-    int next_frag_index = -1, index_entry_pos;
+    int next_frag_index = -1, index_entry_pos, ret;
     size_t requested_size;
     size_t old_ctts_allocated_size;
     AVIndexEntry *new_entries;
@@ -5720,6 +6168,10 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
 
+    // Fragment samples are inserted into the regular index.
+    if ((ret = mov_expand_lazy_index(c, st)) < 0)
+        return ret;
+
     // Find the next frag_index index that has a valid index_entry for
     // the current track_id.
     //
@@ -9511,6 +9963,9 @@ static void mov_read_chapters(AVFormatContext *s)
         sc = st->priv_data;
         cur_pos = avio_tell(sc->pb);
 
+        if (mov_expand_lazy_index(mov, st) < 0)
+            goto finish;
+
         if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
             st->disposition |= AV_DISPOSITION_ATTACHED_PIC | AV_DISPOSITION_TIMED_THUMBNAILS;
             if (!st->attached_pic.data && sti->nb_index_entries) {
@@ -9718,6 +10173,7 @@ static void mov_free_stream_context(AVFormatContext *s, AVStream *st)
     av_freep(&sc->open_key_samples);
     av_freep(&sc->display_matrix);
     av_freep(&sc->index_ranges);
+    mov_free_lazy_index(&sc->lazy_index);
 
     if (sc->extradata)
         for (int i = 0; i < sc->stsd_count; i++)
@@ -10577,10 +11033,9 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     int no_interleave = !mov->interleaved_read || !(s->pb->seekable & AVIO_SEEKABLE_NORMAL);
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
-        FFStream *const avsti = ffstream(avst);
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avsti->nb_index_entries) {
-            AVIndexEntry *current_sample = &avsti->index_entries[msc->current_sample];
+        if (msc->pb && msc->current_sample < mov_nb_samples(avst)) {
+            AVIndexEntry *current_sample = mov_get_sample(avst, msc->current_sample);
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             uint64_t dtsdiff = best_dts > dts ? best_dts - (uint64_t)dts : ((uint64_t)dts - best_dts);
             av_log(s, AV_LOG_TRACE, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
@@ -10706,8 +11161,8 @@ static int mov_finalize_packet(AVFormatContext *s, AVStream *st, AVIndexEntry *s
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < ffstream(st)->nb_index_entries) ?
-            ffstream(st)->index_entries[sc->current_sample].timestamp : st->duration;
+        int64_t next_dts = (sc->current_sample < mov_nb_samples(st)) ?
+            mov_sample_dts(st, sc->current_sample) : st->duration;
 
         if (next_dts >= pkt->dts)
             pkt->duration = next_dts - pkt->dts;
@@ -10910,7 +11365,6 @@ static int is_open_key_sample(const MOVStreamContext *sc, int sample)
 static int can_seek_to_key_sample(AVStream *st, int sample, int64_t requested_pts)
 {
     MOVStreamContext *sc = st->priv_data;
-    FFStream *const sti = ffstream(st);
     int64_t key_sample_dts, key_sample_pts;
 
     if (st->codecpar->codec_id != AV_CODEC_ID_HEVC)
@@ -10919,7 +11373,7 @@ static int can_seek_to_key_sample(AVStream *st, int sample, int64_t requested_pt
     if (sample >= sc->sample_offsets_count)
         return 1;
 
-    key_sample_dts = sti->index_entries[sample].timestamp;
+    key_sample_dts = mov_sample_dts(st, sample);
     key_sample_pts = key_sample_dts + sc->sample_offsets[sample] + sc->dts_shift;
 
     /*
@@ -10936,7 +11390,6 @@ static int can_seek_to_key_sample(AVStream *st, int sample, int64_t requested_pt
 static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp, int flags)
 {
     MOVStreamContext *sc = st->priv_data;
-    FFStream *const sti = ffstream(st);
     int sample, time_sample, ret, next_ts, requested_sample;
     unsigned int i;
 
@@ -10949,9 +11402,9 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
         return ret;
 
     for (;;) {
-        sample = av_index_search_timestamp(st, timestamp, flags);
+        sample = mov_search_sample(st, timestamp, flags);
         av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
-        if (sample < 0 && sti->nb_index_entries && timestamp < sti->index_entries[0].timestamp)
+        if (sample < 0 && mov_nb_samples(st) && timestamp < mov_sample_dts(st, 0))
             sample = 0;
         if (sample < 0) /* not sure what to do */
             return AVERROR_INVALIDDATA;
@@ -10960,7 +11413,7 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
             break;
 
         next_ts = timestamp - FFMAX(sc->min_sample_duration, 1);
-        requested_sample = av_index_search_timestamp(st, next_ts, flags);
+        requested_sample = mov_search_sample(st, next_ts, flags);
 
         // If we've reached a different sample trying to find a good pts to
         // seek to, give up searching because we'll end up seeking back to
@@ -10974,7 +11427,9 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     mov_current_sample_set(sc, sample);
     av_log(s, AV_LOG_TRACE, "stream %d, found sample %d\n", st->index, sc->current_sample);
     /* adjust ctts index */
-    if (sc->ctts_data) {
+    if (sc->lazy_index) {
+        mov_lazy_seek_tables(sc);
+    } else if (sc->ctts_data) {
         time_sample = 0;
         for (i = 0; i < sc->ctts_count; i++) {
             int next = time_sample + sc->ctts_data[i].count;
@@ -10988,7 +11443,7 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     }
 
     /* adjust stsd index */
-    if (sc->chunk_count) {
+    if (sc->chunk_count && !sc->lazy_index) {
         time_sample = 0;
         for (i = 0; i < sc->stsc_count; i++) {
             int64_t next = time_sample + mov_get_stsc_samples(sc, i);
@@ -11008,9 +11463,8 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
 static int64_t mov_get_skip_samples(AVStream *st, int sample)
 {
     MOVStreamContext *sc = st->priv_data;
-    FFStream *const sti = ffstream(st);
-    int64_t first_ts = sti->index_entries[0].timestamp;
-    int64_t ts = sti->index_entries[sample].timestamp;
+    int64_t first_ts = mov_sample_dts(st, 0);
+    int64_t ts = mov_sample_dts(st, sample);
     int64_t off;
 
     if (st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
@@ -11026,7 +11480,6 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 {
     MOVContext *mc = s->priv_data;
     AVStream *st;
-    FFStream *sti;
     int sample;
     int i;
 
@@ -11034,15 +11487,14 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
         return AVERROR_INVALIDDATA;
 
     st = s->streams[stream_index];
-    sti = ffstream(st);
     sample = mov_seek_stream(s, st, sample_time, flags);
     if (sample < 0)
         return sample;
 
     if (mc->seek_individually) {
         /* adjust seek timestamp to found sample timestamp */
-        int64_t seek_timestamp = sti->index_entries[sample].timestamp;
-        sti->skip_samples = mov_get_skip_samples(st, sample);
+        int64_t seek_timestamp = mov_sample_dts(st, sample);
+        ffstream(st)->skip_samples = mov_get_skip_samples(st, sample);
 
         for (i = 0; i < s->nb_streams; i++) {
             AVStream *const st  = s->streams[i];
@@ -11129,6 +11581,8 @@ static const AVOption mov_options[] = {
         {.i64 = 0}, 0, 1, FLAGS },
     { "max_stts_delta", "treat offsets above this value as invalid", OFFSET(max_stts_delta), AV_OPT_TYPE_INT, {.i64 = UINT_MAX-48000*10 }, 0, UINT_MAX, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "interleaved_read", "Interleave packets from multiple tracks at demuxer level", OFFSET(interleaved_read), AV_OPT_TYPE_BOOL, {.i64 = 1 }, 0, 1, .flags = AV_OPT_FLAG_DECODING_PARAM },
+    { "lazy_index", "Resolve samples from the sample tables on demand instead of building a full index",
+        OFFSET(lazy_index), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
 
     { NULL },
 };
@@ -7656,7 +7656,7 @@ static int mov_init(AVFormatContext *s)
         mov->flags &= ~FF_MOV_FLAG_SKIP_SIDX;
     }
 
-    if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+    if (mov->flags & FF_MOV_FLAG_FASTSTART && !mov->reserved_moov_size) {
         mov->reserved_moov_size = -1;
     }
 
@@ -8170,7 +8170,7 @@ static int mov_write_header(AVFormatContext *s)
             mov->mdat_pos = avio_tell(pb);
         }
     } else if (mov->mode != MODE_AVIF) {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->reserved_moov_size < 0)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -8319,6 +8319,48 @@ static int shift_data(AVFormatContext *s)
     return ff_format_shift_data(s, mov->reserved_header_pos, moov_size);
 }
 
+/*
+ * Grow the space reserved with moov_size so that the moov atom fits, by
+ * shifting the data behind it. ff_format_shift_data() moves the data in
+ * chunks of the shift size, so the shift is rounded up to at least 64 KiB
+ * and the moov size, and the unused space is left to a free atom.
+ * The output must be positioned at the end of the written data.
+ */
+static int grow_reserved_moov(AVFormatContext *s)
+{
+    int i, moov_size, moov_size2, shift, free_size;
+    MOVMuxContext *mov = s->priv_data;
+
+    moov_size = get_moov_size(s);
+    if (moov_size < 0)
+        return moov_size;
+    if (moov_size == mov->reserved_moov_size || moov_size + 8 <= mov->reserved_moov_size)
+        return 0;
+
+    /* always leave room for the header of a free atom */
+    shift = moov_size - mov->reserved_moov_size + 8;
+    shift = FFMAX3(shift, 1 << 16, moov_size);
+    for (i = 0; i < mov->nb_tracks; i++)
+        mov->tracks[i].data_offset += shift;
+
+    moov_size2 = get_moov_size(s);
+    if (moov_size2 < 0)
+        return moov_size2;
+
+    /* switching from stco to co64 grows the moov atom again */
+    free_size = mov->reserved_moov_size + shift - moov_size2;
+    if (free_size < 8 && free_size != 0) {
+        for (i = 0; i < mov->nb_tracks; i++)
+            mov->tracks[i].data_offset += 8 - free_size;
+        shift += 8 - free_size;
+    }
+
+    av_log(s, AV_LOG_INFO, "Reserved moov space is too small, "
+           "shifting the data after it by %d bytes\n", shift);
+    mov->reserved_moov_size += shift;
+    return ff_format_shift_data(s, mov->reserved_header_pos + mov->reserved_moov_size - shift, shift);
+}
+
 static int mov_write_trailer(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -8409,9 +8451,16 @@ static int mov_write_trailer(AVFormatContext *s)
             ffio_wfourcc(pb, "mdat");
             avio_wb64(pb, mov->mdat_size + 16);
         }
+        if (mov->reserved_moov_size > 0 && mov->flags & FF_MOV_FLAG_FASTSTART) {
+            avio_seek(pb, moov_pos, SEEK_SET);
+            if ((res = grow_reserved_moov(s)) < 0)
+                return res;
+            moov_pos = avio_tell(pb);
+        }
+
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->reserved_moov_size < 0) {
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
             res = shift_data(s);
             if (res < 0)
@@ -8424,13 +8473,15 @@ static int mov_write_trailer(AVFormatContext *s)
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
                 return res;
             size = mov->reserved_moov_size - (avio_tell(pb) - mov->reserved_header_pos);
-            if (size < 8){
+            if (size < 8 && size != 0) {
                 av_log(s, AV_LOG_ERROR, "reserved_moov_size is too small, needed %"PRId64" additional\n", 8-size);
                 return AVERROR(EINVAL);
             }
-            avio_wb32(pb, size);
-            ffio_wfourcc(pb, "free");
-            ffio_fill(pb, 0, size - 8);
+            if (size) {
+                avio_wb32(pb, size);
+                ffio_wfourcc(pb, "free");
+                ffio_fill(pb, 0, size - 8);
+            }
             avio_seek(pb, moov_pos, SEEK_SET);
         } else {
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
@@ -19,8 +19,11 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
 #include "config_components.h"
 
+#include <stdatomic.h>
+
 #include "libavutil/buffer.h"
 #include "libavutil/crc.h"
 #include "libavutil/internal.h"
@@ -31,6 +34,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/avassert.h"
 #include "libavutil/dovi_meta.h"
+#include "libavutil/thread.h"
 #include "libavcodec/bytestream.h"
 #include "libavcodec/defs.h"
 #include "libavcodec/get_bits.h"
@@ -164,6 +168,7 @@ struct MpegTSContext {
     int resync_size;
     int merge_pmt_versions;
     int max_packet_size;
+    int read_ahead;
 
     int id;
 
@@ -181,6 +186,9 @@ struct MpegTSContext {
 
     AVStream *epg_stream;
     AVBufferPool* pools[32];
+
+    /** packets read ahead by the reader thread, if enabled */
+    struct MpegTSReadAhead *ra;
 };
 
 #define MPEGTS_OPTIONS \
@@ -210,6 +218,8 @@ static const AVOption options[] = {
      {.i64 = 0}, 0, 1, 0 },
     {"max_packet_size", "maximum size of emitted packet", offsetof(MpegTSContext, max_packet_size), AV_OPT_TYPE_INT,
      {.i64 = 204800}, 1, INT_MAX/2, AV_OPT_FLAG_DECODING_PARAM },
+    {"read_ahead", "number of TS packets to read ahead in an input thread", offsetof(MpegTSContext, read_ahead), AV_OPT_TYPE_INT,
+     {.i64 = 0}, 0, 1 << 20, AV_OPT_FLAG_DECODING_PARAM },
     { NULL },
 };
 
@@ -2901,7 +2911,8 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet, int64_t pos)
     return 0;
 }
 
-static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *current_packet)
+static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *current_packet,
+                         int *raw_packet_size)
 {
     MpegTSContext *ts = s->priv_data;
     AVIOContext *pb = s->pb;
@@ -2929,9 +2940,9 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
             if (ret < 0)
                 return ret;
             new_packet_size = get_packet_size(s);
-            if (new_packet_size > 0 && new_packet_size != ts->raw_packet_size) {
+            if (new_packet_size > 0 && new_packet_size != *raw_packet_size) {
                 av_log(ts->stream, AV_LOG_WARNING, "changing packet size to %d\n", new_packet_size);
-                ts->raw_packet_size = new_packet_size;
+                *raw_packet_size = new_packet_size;
             }
             avio_seek(pb, pos, SEEK_SET);
             return 0;
@@ -2944,7 +2955,7 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
 }
 
 /* return AVERROR_something if error or EOF. Return 0 if OK. */
-static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size,
+static int read_packet(AVFormatContext *s, uint8_t *buf, int *raw_packet_size,
                        const uint8_t **data)
 {
     AVIOContext *pb = s->pb;
@@ -2958,7 +2969,7 @@ static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size,
         if ((*data)[0] != 0x47) {
             /* find a new packet start */
 
-            if (mpegts_resync(s, raw_packet_size, *data) < 0)
+            if (mpegts_resync(s, *raw_packet_size, *data, raw_packet_size) < 0)
                 return AVERROR(EAGAIN);
             else
                 continue;
@@ -2977,6 +2988,248 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+#define READ_AHEAD_BLOCK_PACKETS 64
+
+typedef struct MpegTSReadAheadBlock {
+    uint8_t data[READ_AHEAD_BLOCK_PACKETS][TS_PACKET_SIZE];
+    /** position right after each 188 byte packet, as avio_tell() */
+    int64_t pos[READ_AHEAD_BLOCK_PACKETS];
+    int raw_packet_size[READ_AHEAD_BLOCK_PACKETS];
+    int nb_packets;
+    /** error returned by read_packet() after the last packet, or 0 */
+    int ret;
+} MpegTSReadAheadBlock;
+
+/*
+ * The reader thread owns the AVIOContext while the demuxer is inside
+ * handle_packets(): it reads, resyncs and strips FEC/DVHS bytes, and
+ * hands over the TS packets in blocks. It is paused before returning to
+ * the caller, so that seeking and mpegts_get_pcr() can use the
+ * AVIOContext as usual. The packets read ahead are dropped by
+ * mpegts_read_seek(), and by handle_packets() when the caller
+ * repositioned the AVIOContext itself.
+ */
+typedef struct MpegTSReadAhead {
+    MpegTSReadAheadBlock *blocks;
+    int nb_blocks;
+    int head;       ///< block being consumed
+    int nb_filled;  ///< number of blocks handed over, starting from head
+    int cur;        ///< next packet in the head block
+    int error;      ///< a block ending with an error was handed over
+    int idle;       ///< the reader thread is not using the AVIOContext
+    int abort;
+    atomic_int reading;
+    /** packet size as seen by the reader thread */
+    int raw_packet_size;
+    AVMutex lock;
+    AVCond cond;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+} MpegTSReadAhead;
+
+#if HAVE_THREADS
+static void *read_ahead_thread(void *arg)
+{
+    MpegTSContext *ts   = arg;
+    MpegTSReadAhead *ra = ts->ra;
+    AVFormatContext *s  = ts->stream;
+
+    ff_mutex_lock(&ra->lock);
+    for (;;) {
+        MpegTSReadAheadBlock *blk;
+        int ret = 0;
+
+        while (!ra->abort && (!atomic_load(&ra->reading) || ra->error ||
+                              ra->nb_filled == ra->nb_blocks)) {
+            ra->idle = 1;
+            ff_cond_broadcast(&ra->cond);
+            ff_cond_wait(&ra->cond, &ra->lock);
+        }
+        if (ra->abort)
+            break;
+        ra->idle = 0;
+        blk = &ra->blocks[(ra->head + ra->nb_filled) % ra->nb_blocks];
+        ff_mutex_unlock(&ra->lock);
+
+        blk->nb_packets = 0;
+        while (blk->nb_packets < READ_AHEAD_BLOCK_PACKETS &&
+               atomic_load(&ra->reading)) {
+            int n = blk->nb_packets;
+            const uint8_t *data;
+
+            ret = read_packet(s, blk->data[n], &ra->raw_packet_size, &data);
+            if (ret != 0)
+                break;
+            if (data != blk->data[n])
+                memcpy(blk->data[n], data, TS_PACKET_SIZE);
+            blk->pos[n]             = avio_tell(s->pb);
+            blk->raw_packet_size[n] = ra->raw_packet_size;
+            finished_reading_packet(s, ra->raw_packet_size);
+            blk->nb_packets++;
+        }
+        blk->ret = ret;
+
+        ff_mutex_lock(&ra->lock);
+        if (blk->nb_packets || ret) {
+            ra->nb_filled++;
+            ra->error = ret != 0;
+            ff_cond_broadcast(&ra->cond);
+        }
+    }
+    ra->idle = 1;
+    ff_cond_broadcast(&ra->cond);
+    ff_mutex_unlock(&ra->lock);
+    return NULL;
+}
+
+static void read_ahead_free(MpegTSContext *ts)
+{
+    MpegTSReadAhead *ra = ts->ra;
+
+    if (!ra)
+        return;
+
+    ff_mutex_lock(&ra->lock);
+    ra->abort = 1;
+    ff_cond_broadcast(&ra->cond);
+    ff_mutex_unlock(&ra->lock);
+    pthread_join(ra->thread, NULL);
+
+    ff_cond_destroy(&ra->cond);
+    ff_mutex_destroy(&ra->lock);
+    av_freep(&ra->blocks);
+    av_freep(&ts->ra);
+}
+
+static int read_ahead_init(MpegTSContext *ts)
+{
+    MpegTSReadAhead *ra;
+    int ret;
+
+    ra = ts->ra = av_mallocz(sizeof(*ra));
+    if (!ra)
+        return AVERROR(ENOMEM);
+
+    ra->nb_blocks = FFMAX(2, (ts->read_ahead + READ_AHEAD_BLOCK_PACKETS - 1) /
+                             READ_AHEAD_BLOCK_PACKETS);
+    ra->blocks = av_malloc_array(ra->nb_blocks, sizeof(*ra->blocks));
+    if (!ra->blocks) {
+        av_freep(&ts->ra);
+        return AVERROR(ENOMEM);
+    }
+    ra->idle            = 1;
+    ra->raw_packet_size = ts->raw_packet_size;
+    atomic_init(&ra->reading, 0);
+
+    if ((ret = ff_mutex_init(&ra->lock, NULL))) {
+        av_freep(&ra->blocks);
+        av_freep(&ts->ra);
+        return AVERROR(ret);
+    }
+    if ((ret = ff_cond_init(&ra->cond, NULL))) {
+        ff_mutex_destroy(&ra->lock);
+        av_freep(&ra->blocks);
+        av_freep(&ts->ra);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_create(&ra->thread, NULL, read_ahead_thread, ts))) {
+        ff_cond_destroy(&ra->cond);
+        ff_mutex_destroy(&ra->lock);
+        av_freep(&ra->blocks);
+        av_freep(&ts->ra);
+        return AVERROR(ret);
+    }
+    return 0;
+}
+
+/* Let the reader thread run, or wait until it stopped using the AVIOContext. */
+static void read_ahead_set_reading(MpegTSReadAhead *ra, int reading)
+{
+    ff_mutex_lock(&ra->lock);
+    atomic_store(&ra->reading, reading);
+    ff_cond_broadcast(&ra->cond);
+    while (!reading && !ra->idle)
+        ff_cond_wait(&ra->cond, &ra->lock);
+    ff_mutex_unlock(&ra->lock);
+}
+
+/* Must only be called while the reader thread is paused. */
+static void read_ahead_flush(MpegTSContext *ts)
+{
+    MpegTSReadAhead *ra = ts->ra;
+
+    ff_mutex_lock(&ra->lock);
+    ra->head = ra->nb_filled = ra->cur = 0;
+    ra->error = 0;
+    ra->raw_packet_size = ts->raw_packet_size;
+    ff_mutex_unlock(&ra->lock);
+}
+
+static int read_ahead_packet(MpegTSContext *ts, const uint8_t **data, int64_t *pos)
+{
+    MpegTSReadAhead *ra = ts->ra;
+    MpegTSReadAheadBlock *blk;
+
+    ff_mutex_lock(&ra->lock);
+    for (;;) {
+        int ret;
+
+        while (!ra->nb_filled)
+            ff_cond_wait(&ra->cond, &ra->lock);
+        blk = &ra->blocks[ra->head];
+        if (ra->cur < blk->nb_packets)
+            break;
+
+        ret = blk->ret;
+        ra->head = (ra->head + 1) % ra->nb_blocks;
+        ra->nb_filled--;
+        ra->cur = 0;
+        if (ret)
+            ra->error = 0;
+        ff_cond_broadcast(&ra->cond);
+        if (ret) {
+            ff_mutex_unlock(&ra->lock);
+            return ret;
+        }
+    }
+    ff_mutex_unlock(&ra->lock);
+
+    *data = blk->data[ra->cur];
+    *pos  = blk->pos[ra->cur];
+    ts->raw_packet_size = blk->raw_packet_size[ra->cur];
+    ra->cur++;
+    return 0;
+}
+#else
+static void read_ahead_free(MpegTSContext *ts)
+{
+}
+#endif
+
+/* Drop the packets read ahead and the partial PES packets and sections. */
+static void mpegts_flush(MpegTSContext *ts)
+{
+#if HAVE_THREADS
+    if (ts->ra)
+        read_ahead_flush(ts);
+#endif
+    for (int i = 0; i < NB_PID_MAX; i++) {
+        if (ts->pids[i]) {
+            if (ts->pids[i]->type == MPEGTS_PES) {
+                PESContext *pes = ts->pids[i]->u.pes_filter.opaque;
+                av_buffer_unref(&pes->buffer);
+                pes->data_index = 0;
+                pes->state = MPEGTS_SKIP; /* skip until pes header */
+            } else if (ts->pids[i]->type == MPEGTS_SECTION) {
+                ts->pids[i]->u.section_filter.last_ver = -1;
+            }
+            ts->pids[i]->last_cc = -1;
+            ts->pids[i]->last_pcr = -1;
+        }
+    }
+}
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
@@ -2984,30 +3237,33 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
     const uint8_t *data;
     int64_t packet_num;
     int ret = 0;
+#if HAVE_THREADS
+    MpegTSReadAhead *ra;
+#endif
+
+#if HAVE_THREADS
+    if (ts->read_ahead && !nb_packets && !ts->ra) {
+        ret = read_ahead_init(ts);
+        if (ret < 0)
+            return ret;
+    }
+#endif
 
-    if (avio_tell(s->pb) != ts->last_pos) {
-        int i;
+    /* the caller may also have repositioned the AVIOContext directly */
+    if (s->io_repositioned || avio_tell(s->pb) != ts->last_pos) {
         av_log(ts->stream, AV_LOG_TRACE, "Skipping after seek\n");
-        /* seek detected, flush pes buffer */
-        for (i = 0; i < NB_PID_MAX; i++) {
-            if (ts->pids[i]) {
-                if (ts->pids[i]->type == MPEGTS_PES) {
-                    PESContext *pes = ts->pids[i]->u.pes_filter.opaque;
-                    av_buffer_unref(&pes->buffer);
-                    pes->data_index = 0;
-                    pes->state = MPEGTS_SKIP; /* skip until pes header */
-                } else if (ts->pids[i]->type == MPEGTS_SECTION) {
-                    ts->pids[i]->u.section_filter.last_ver = -1;
-                }
-                ts->pids[i]->last_cc = -1;
-                ts->pids[i]->last_pcr = -1;
-            }
-        }
+        s->io_repositioned = 0;
+        mpegts_flush(ts);
     }
 
     ts->stop_parse = 0;
     packet_num = 0;
     memset(packet + TS_PACKET_SIZE, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+#if HAVE_THREADS
+    ra = nb_packets ? NULL : ts->ra;
+    if (ra)
+        read_ahead_set_reading(ra, 1);
+#endif
     for (;;) {
         packet_num++;
         if (nb_packets != 0 && packet_num >= nb_packets ||
@@ -3018,7 +3274,19 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
-        ret = read_packet(s, packet, ts->raw_packet_size, &data);
+#if HAVE_THREADS
+        if (ra) {
+            int64_t pos;
+            ret = read_ahead_packet(ts, &data, &pos);
+            if (ret != 0)
+                break;
+            ret = handle_packet(ts, data, pos);
+            if (ret != 0)
+                break;
+            continue;
+        }
+#endif
+        ret = read_packet(s, packet, &ts->raw_packet_size, &data);
         if (ret != 0)
             break;
         ret = handle_packet(ts, data, avio_tell(s->pb));
@@ -3026,6 +3294,10 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ret != 0)
             break;
     }
+#if HAVE_THREADS
+    if (ra)
+        read_ahead_set_reading(ra, 0);
+#endif
     ts->last_pos = avio_tell(s->pb);
     return ret;
 }
@@ -3166,7 +3438,7 @@ static int mpegts_read_header(AVFormatContext *s)
         nb_pcrs    = 0;
         nb_packets = 0;
         for (;;) {
-            ret = read_packet(s, packet, ts->raw_packet_size, &data);
+            ret = read_packet(s, packet, &ts->raw_packet_size, &data);
             if (ret < 0)
                 return ret;
             pid = AV_RB16(data + 1) & 0x1fff;
@@ -3220,7 +3492,7 @@ static int mpegts_raw_read_packet(AVFormatContext *s, AVPacket *pkt)
 
     if ((ret = av_new_packet(pkt, TS_PACKET_SIZE)) < 0)
         return ret;
-    ret = read_packet(s, pkt->data, ts->raw_packet_size, &data);
+    ret = read_packet(s, pkt->data, &ts->raw_packet_size, &data);
     pkt->pos = avio_tell(s->pb);
     if (ret < 0) {
         return ret;
@@ -3303,6 +3575,7 @@ static void mpegts_free(MpegTSContext *ts)
 static int mpegts_read_close(AVFormatContext *s)
 {
     MpegTSContext *ts = s->priv_data;
+    read_ahead_free(ts);
     mpegts_free(ts);
     return 0;
 }
@@ -3325,7 +3598,7 @@ static av_unused int64_t mpegts_get_pcr(AVFormatContext *s, int stream_index,
         if (avio_read(s->pb, buf, TS_PACKET_SIZE) != TS_PACKET_SIZE)
             return AV_NOPTS_VALUE;
         if (buf[0] != 0x47) {
-            if (mpegts_resync(s, TS_PACKET_SIZE, buf) < 0)
+            if (mpegts_resync(s, TS_PACKET_SIZE, buf, &ts->raw_packet_size) < 0)
                 return AV_NOPTS_VALUE;
             pos = avio_tell(s->pb);
             continue;
@@ -3379,6 +3652,21 @@ static int64_t mpegts_get_dts(AVFormatContext *s, int stream_index,
     return AV_NOPTS_VALUE;
 }
 
+static int mpegts_read_seek(AVFormatContext *s, int stream_index,
+                            int64_t timestamp, int flags)
+{
+    MpegTSContext *ts = s->priv_data;
+    int ret;
+
+    /* mpegts_get_dts() demuxes while searching, so flush both before and
+     * after the search */
+    mpegts_flush(ts);
+    ret = ff_seek_frame_binary(s, stream_index, timestamp, flags);
+    mpegts_flush(ts);
+    ts->last_pos = avio_tell(s->pb);
+    return ret;
+}
+
 /**************************************************************/
 /* parsing functions - called from other demuxers such as RTP */
 
@@ -3445,6 +3733,7 @@ const FFInputFormat ff_mpegts_demuxer = {
     .read_header    = mpegts_read_header,
     .read_packet    = mpegts_read_packet,
     .read_close     = mpegts_read_close,
+    .read_seek      = mpegts_read_seek,
     .read_timestamp = mpegts_get_dts,
     .flags_internal  = FF_INFMT_FLAG_PREFER_CODEC_FRAMERATE,
 };
@@ -96,6 +96,10 @@ typedef struct MpegTSWrite {
     int mux_rate; ///< set to 1 when VBR
     int pes_payload_size;
     int64_t total_size;
+    /* with CBR, (total_size + 11) * 8 * PCR_TIME_BASE + mux_rate / 2
+     * == pcr_base * mux_rate + pcr_rem, updated for each TS packet */
+    int64_t pcr_base;
+    int64_t pcr_rem;
 
     int transport_stream_id;
     int original_network_id;
@@ -131,6 +135,13 @@ typedef struct MpegTSWrite {
     uint8_t provider_name[256];
 
     int omit_video_pes_length;
+
+    /* TS packets assembled before being written, if batch_packets is set */
+    int batch_packets;
+    uint8_t *batch_buf;
+    int batch_len;
+    int batch_chunk;    ///< size of the writes, multiple of the raw packet size
+    int batch_size;     ///< multiple of batch_chunk
 } MpegTSWrite;
 
 /* a PES packet header is generated every DEFAULT_PES_HEADER_FREQ packets */
@@ -962,22 +973,87 @@ invalid:
 
 static int64_t get_pcr(const MpegTSWrite *ts)
 {
+    if (ts->mux_rate > 1)
+        return ts->pcr_base + ts->first_pcr;
     return av_rescale(ts->total_size + 11, 8 * PCR_TIME_BASE, ts->mux_rate) +
            ts->first_pcr;
 }
 
+/**
+ * Write the assembled TS packets in chunks of batch_chunk bytes, each one
+ * flushed on its own for packetized outputs. The remainder is kept unless
+ * all is set.
+ */
+static void write_batch(AVFormatContext *s, int all)
+{
+    MpegTSWrite *ts = s->priv_data;
+    int pos = 0;
+
+    if (!ts->batch_buf)
+        return;
+
+    while (ts->batch_len - pos >= ts->batch_chunk) {
+        avio_write(s->pb, ts->batch_buf + pos, ts->batch_chunk);
+        if (s->pb->max_packet_size)
+            avio_flush(s->pb);
+        pos += ts->batch_chunk;
+    }
+    if (all && pos < ts->batch_len) {
+        avio_write(s->pb, ts->batch_buf + pos, ts->batch_len - pos);
+        pos = ts->batch_len;
+    }
+    if (pos) {
+        memmove(ts->batch_buf, ts->batch_buf + pos, ts->batch_len - pos);
+        ts->batch_len -= pos;
+    }
+}
+
+/**
+ * Return where the next TS packet should be built: in the batch buffer if
+ * enabled, tmp otherwise.
+ */
+static uint8_t *get_packet_buf(AVFormatContext *s, uint8_t *tmp)
+{
+    MpegTSWrite *ts = s->priv_data;
+    int raw_packet_size = TS_PACKET_SIZE + (ts->m2ts_mode ? 4 : 0);
+
+    if (!ts->batch_buf)
+        return tmp;
+    if (ts->batch_len + raw_packet_size > ts->batch_size)
+        write_batch(s, 0);
+    return ts->batch_buf + ts->batch_len + (ts->m2ts_mode ? 4 : 0);
+}
+
 static void write_packet(AVFormatContext *s, const uint8_t *packet)
 {
     MpegTSWrite *ts = s->priv_data;
-    if (ts->m2ts_mode) {
-        int64_t pcr = get_pcr(s->priv_data);
-        uint32_t tp_extra_header = pcr % 0x3fffffff;
-        tp_extra_header = AV_RB32(&tp_extra_header);
-        avio_write(s->pb, (unsigned char *) &tp_extra_header,
-                   sizeof(tp_extra_header));
+    if (ts->batch_buf) {
+        uint8_t *dst = get_packet_buf(s, NULL);
+        if (ts->m2ts_mode)
+            AV_WB32(dst - 4, get_pcr(ts) % 0x3fffffff);
+        if (packet != dst)
+            memcpy(dst, packet, TS_PACKET_SIZE);
+        ts->batch_len += TS_PACKET_SIZE + (ts->m2ts_mode ? 4 : 0);
+    } else {
+        if (ts->m2ts_mode) {
+            int64_t pcr = get_pcr(s->priv_data);
+            uint32_t tp_extra_header = pcr % 0x3fffffff;
+            tp_extra_header = AV_RB32(&tp_extra_header);
+            avio_write(s->pb, (unsigned char *) &tp_extra_header,
+                       sizeof(tp_extra_header));
+        }
+        avio_write(s->pb, packet, TS_PACKET_SIZE);
     }
-    avio_write(s->pb, packet, TS_PACKET_SIZE);
     ts->total_size += TS_PACKET_SIZE;
+    if (ts->mux_rate > 1) {
+        const int64_t step = TS_PACKET_SIZE * 8LL * PCR_TIME_BASE;
+        ts->pcr_base += step / ts->mux_rate;
+        ts->pcr_rem  += step % ts->mux_rate;
+        if (ts->pcr_rem >= ts->mux_rate) {
+            ts->pcr_base++;
+            ts->pcr_rem -= ts->mux_rate;
+        }
+    }
 }
 
 static void section_write_packet(MpegTSSection *s, const uint8_t *packet)
@@ -1273,6 +1349,30 @@ static int mpegts_init(AVFormatContext *s)
     if (ts->copyts < 1)
         ts->first_pcr = av_rescale(s->max_delay, PCR_TIME_BASE, AV_TIME_BASE);
 
+    if (ts->mux_rate > 1) {
+        int64_t num = 11 * 8LL * PCR_TIME_BASE + ts->mux_rate / 2;
+        ts->pcr_base = num / ts->mux_rate;
+        ts->pcr_rem  = num % ts->mux_rate;
+    }
+
+    if (ts->batch_packets) {
+        int raw_packet_size = TS_PACKET_SIZE + (ts->m2ts_mode ? 4 : 0);
+
+        /* packetized outputs get whole TS packets in each write,
+         * e.g. 7 of them for the default UDP payload size */
+        ts->batch_size  = ts->batch_packets * raw_packet_size;
+        ts->batch_chunk = ts->batch_size;
+        if (s->pb && s->pb->max_packet_size) {
+            ts->batch_chunk = FFMAX(s->pb->max_packet_size / raw_packet_size, 1) *
+                              raw_packet_size;
+            ts->batch_size  = FFMAX(ts->batch_size / ts->batch_chunk, 1) *
+                              ts->batch_chunk;
+        }
+        ts->batch_buf = av_malloc(ts->batch_size);
+        if (!ts->batch_buf)
+            return AVERROR(ENOMEM);
+    }
+
     select_pcr_streams(s);
 
     ts->last_pat_ts = AV_NOPTS_VALUE;
@@ -1357,7 +1457,8 @@ static int write_pcr_bits(uint8_t *buf, int64_t pcr)
 static void mpegts_insert_null_packet(AVFormatContext *s)
 {
     uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t tmp[TS_PACKET_SIZE];
+    uint8_t *buf = get_packet_buf(s, tmp);
 
     q    = buf;
     *q++ = 0x47;
@@ -1374,7 +1475,8 @@ static void mpegts_insert_pcr_only(AVFormatContext *s, AVStream *st)
     MpegTSWrite *ts = s->priv_data;
     MpegTSWriteStream *ts_st = st->priv_data;
     uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t tmp[TS_PACKET_SIZE];
+    uint8_t *buf = get_packet_buf(s, tmp);
 
     q    = buf;
     *q++ = 0x47;
@@ -1485,7 +1587,8 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
 {
     MpegTSWriteStream *ts_st = st->priv_data;
     MpegTSWrite *ts = s->priv_data;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t tmp[TS_PACKET_SIZE];
+    uint8_t *buf = tmp;
     uint8_t *q;
     int val, is_start, len, header_len, write_pcr, flags;
     int afc_len, stuffing_len;
@@ -1565,6 +1668,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
         }
 
         /* prepare packet header */
+        buf  = get_packet_buf(s, tmp);
         q    = buf;
         *q++ = 0x47;
         val  = ts_st->pid >> 8;
@@ -2249,21 +2353,30 @@ static void mpegts_write_flush(AVFormatContext *s)
         }
     }
 
+    write_batch(s, 1);
     if (ts->m2ts_mode) {
         int packets = (avio_tell(s->pb) / (TS_PACKET_SIZE + 4)) % 32;
         while (packets++ < 32)
             mpegts_insert_null_packet(s);
+        write_batch(s, 1);
     }
 }
 
 static int mpegts_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
+    int ret;
+
     if (!pkt) {
         mpegts_write_flush(s);
         return 1;
-    } else {
-        return mpegts_write_packet_internal(s, pkt);
     }
+
+    ret = mpegts_write_packet_internal(s, pkt);
+    /* packetized outputs keep the last partial chunk for the next packet,
+     * unless it is to be flushed right away */
+    write_batch(s, !s->pb->max_packet_size || s->flush_packets == 1 ||
+                   s->flags & AVFMT_FLAG_FLUSH_PACKETS);
+    return ret;
 }
 
 static int mpegts_write_end(AVFormatContext *s)
@@ -2298,6 +2411,7 @@ static void mpegts_deinit(AVFormatContext *s)
         av_freep(&service);
     }
     av_freep(&ts->services);
+    av_freep(&ts->batch_buf);
 }
 
 static int mpegts_check_bitstream(AVFormatContext *s, AVStream *st,
@@ -2388,6 +2502,8 @@ static const AVOption options[] = {
       OFFSET(sdt_period_us), AV_OPT_TYPE_DURATION, { .i64 = SDT_RETRANS_TIME * 1000LL }, 0, INT64_MAX, ENC },
     { "nit_period", "NIT retransmission time limit in seconds",
       OFFSET(nit_period_us), AV_OPT_TYPE_DURATION, { .i64 = NIT_RETRANS_TIME * 1000LL }, 0, INT64_MAX, ENC },
+    { "batch_packets", "Number of TS packets assembled before writing them",
+      OFFSET(batch_packets), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 65536, ENC },
     { NULL },
 };
 
@@ -24,12 +24,15 @@
  * RTP protocol
  */
 
+#define _GNU_SOURCE     /* Needed for recvmmsg() */
+
 #include "libavutil/mem.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/avstring.h"
 #include "libavutil/opt.h"
 #include "avformat.h"
 #include "rtp.h"
+#include "rtpdec.h"
 #include "rtpproto.h"
 #include "url.h"
 #include "ip.h"
@@ -61,6 +64,16 @@ typedef struct RTPContext {
     char *fec_options_str;
     int64_t rw_timeout;
     char *localaddr;
+
+    /* RTP datagrams received together by recvmmsg(), returned one by one */
+    int msg_batch;
+#if HAVE_RECVMMSG
+    uint8_t *msg_buf;
+    struct mmsghdr *msgs;
+    struct iovec *msg_iov;
+    struct sockaddr_storage *msg_addr;
+    int nb_msgs, cur_msg;
+#endif
 } RTPContext;
 
 #define OFFSET(x) offsetof(RTPContext, x)
@@ -81,6 +94,7 @@ static const AVOption options[] = {
     { "block",              "Block list",                                                       OFFSET(block),           AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "fec",                "FEC",                                                              OFFSET(fec_options_str), AV_OPT_TYPE_STRING, { .str = NULL },               .flags = E },
     { "localaddr",          "Local address",                                                    OFFSET(localaddr),       AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "msg_batch",          "Maximum number of RTP datagrams per recvmmsg() call",              OFFSET(msg_batch),       AV_OPT_TYPE_INT,    { .i64 = 16 },     1, 1024,    .flags = D },
     { NULL }
 };
 
@@ -388,6 +402,81 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     return AVERROR(EIO);
 }
 
+#if HAVE_RECVMMSG
+static void rtp_free_msgs(RTPContext *s)
+{
+    av_freep(&s->msg_buf);
+    av_freep(&s->msgs);
+    av_freep(&s->msg_iov);
+    av_freep(&s->msg_addr);
+    s->nb_msgs = s->cur_msg = 0;
+}
+
+static int rtp_alloc_msgs(URLContext *h)
+{
+    RTPContext *s = h->priv_data;
+
+    s->msg_buf  = av_malloc_array(s->msg_batch, RTP_MAX_PACKET_LENGTH);
+    s->msgs     = av_calloc(s->msg_batch, sizeof(*s->msgs));
+    s->msg_iov  = av_calloc(s->msg_batch, sizeof(*s->msg_iov));
+    s->msg_addr = av_calloc(s->msg_batch, sizeof(*s->msg_addr));
+    if (!s->msg_buf || !s->msgs || !s->msg_iov || !s->msg_addr) {
+        rtp_free_msgs(s);
+        return AVERROR(ENOMEM);
+    }
+    for (int i = 0; i < s->msg_batch; i++) {
+        s->msg_iov[i].iov_base = s->msg_buf + (size_t)i * RTP_MAX_PACKET_LENGTH;
+        s->msg_iov[i].iov_len  = RTP_MAX_PACKET_LENGTH;
+        s->msgs[i].msg_hdr.msg_iov    = &s->msg_iov[i];
+        s->msgs[i].msg_hdr.msg_iovlen = 1;
+        s->msgs[i].msg_hdr.msg_name   = &s->msg_addr[i];
+    }
+    return 0;
+}
+
+/**
+ * Return the next datagram received by the last recvmmsg() call,
+ * or AVERROR(EAGAIN) if there is none left.
+ */
+static int rtp_read_msg(URLContext *h, uint8_t *buf, int size)
+{
+    RTPContext *s = h->priv_data;
+
+    while (s->cur_msg < s->nb_msgs) {
+        struct mmsghdr *msg = &s->msgs[s->cur_msg++];
+        int len = FFMIN(msg->msg_len, size);
+
+        if (ff_ip_check_source_lists(msg->msg_hdr.msg_name, &s->filters))
+            continue;
+        if (msg->msg_hdr.msg_flags & MSG_TRUNC || msg->msg_len > size)
+            av_log(h, AV_LOG_WARNING, "RTP packet truncated to %d bytes\n", len);
+        memcpy(buf, msg->msg_hdr.msg_iov->iov_base, len);
+        memcpy(&s->last_rtp_source, msg->msg_hdr.msg_name, msg->msg_hdr.msg_namelen);
+        s->last_rtp_source_len = msg->msg_hdr.msg_namelen;
+        return len;
+    }
+    return AVERROR(EAGAIN);
+}
+
+/* Receive up to msg_batch RTP datagrams without blocking. */
+static int rtp_recv_msgs(URLContext *h)
+{
+    RTPContext *s = h->priv_data;
+    int ret;
+
+    if (!s->msgs && (ret = rtp_alloc_msgs(h)) < 0)
+        return ret;
+    for (int i = 0; i < s->msg_batch; i++)
+        s->msgs[i].msg_hdr.msg_namelen = sizeof(s->msg_addr[i]);
+    ret = recvmmsg(s->rtp_fd, s->msgs, s->msg_batch, MSG_DONTWAIT, NULL);
+    if (ret < 0)
+        return ff_neterrno();
+    s->nb_msgs = ret;
+    s->cur_msg = 0;
+    return ret;
+}
+#endif
+
 static int rtp_read(URLContext *h, uint8_t *buf, int size)
 {
     RTPContext *s = h->priv_data;
@@ -399,6 +488,10 @@ static int rtp_read(URLContext *h, uint8_t *buf, int size)
     int runs = h->rw_timeout / 1000 / POLLING_TIME;
 
     for(;;) {
+#if HAVE_RECVMMSG
+        if ((len = rtp_read_msg(h, buf, size)) >= 0)
+            return len;
+#endif
         if (ff_check_interrupt(&h->interrupt_callback))
             return AVERROR_EXIT;
         n = poll(p, 2, poll_delay);
@@ -407,6 +500,18 @@ static int rtp_read(URLContext *h, uint8_t *buf, int size)
             for (i = 1; i >= 0; i--) {
                 if (!(p[i].revents & POLLIN))
                     continue;
+#if HAVE_RECVMMSG
+                if (i == 0 && s->msg_batch > 1) {
+                    len = rtp_recv_msgs(h);
+                    if (len == AVERROR(EAGAIN) || len == AVERROR(EINTR))
+                        continue;
+                    if (len < 0)
+                        return len == AVERROR(ENOMEM) ? len : AVERROR(EIO);
+                    if ((len = rtp_read_msg(h, buf, size)) >= 0)
+                        return len;
+                    continue;
+                }
+#endif
                 *addr_lens[i] = sizeof(*addrs[i]);
                 len = recvfrom(p[i].fd, buf, size, 0,
                                 (struct sockaddr *)addrs[i], addr_lens[i]);
@@ -523,6 +628,9 @@ static int rtp_close(URLContext *h)
     RTPContext *s = h->priv_data;
 
     ff_ip_reset_filters(&s->filters);
+#if HAVE_RECVMMSG
+    rtp_free_msgs(s);
+#endif
 
     ffurl_closep(&s->rtp_hd);
     ffurl_closep(&s->rtcp_hd);
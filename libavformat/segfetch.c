@@ -0,0 +1,453 @@
+/*
+ * Segment fetching shared by the HLS and DASH demuxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "config_components.h"
+
+#include <string.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/error.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "avio_internal.h"
+#include "http.h"
+#include "internal.h"
+#include "segfetch.h"
+#include "url.h"
+
+int ff_seg_keepalive_request(AVFormatContext *s, AVIOContext **pb,
+                             const char *url, AVDictionary **options)
+{
+#if !CONFIG_HTTP_PROTOCOL
+    return AVERROR_PROTOCOL_NOT_FOUND;
+#else
+    int ret;
+    URLContext *uc = ffio_geturlcontext(*pb);
+    av_assert0(uc);
+    (*pb)->eof_reached = 0;
+    ret = ff_http_do_new_request2(uc, url, options);
+    if (ret < 0) {
+        ff_format_io_close(s, pb);
+    }
+    return ret;
+#endif
+}
+
+int ff_seg_conn_pool_init(SegConnPool *pool)
+{
+    int ret = ff_mutex_init(&pool->lock, NULL);
+    if (ret)
+        return AVERROR(ret);
+    pool->lock_init = 1;
+    return 0;
+}
+
+void ff_seg_conn_pool_uninit(AVFormatContext *s, SegConnPool *pool)
+{
+    for (int i = 0; i < pool->nb_conns; i++) {
+        ff_format_io_close(s, &pool->conns[i].pb);
+        av_freep(&pool->conns[i].location);
+    }
+    pool->nb_conns = 0;
+    if (pool->lock_init)
+        ff_mutex_destroy(&pool->lock);
+    pool->lock_init = 0;
+}
+
+static int same_server(const char *url1, const char *url2)
+{
+    char proto1[10], proto2[10], host1[1024], host2[1024];
+    int port1, port2;
+
+    av_url_split(proto1, sizeof(proto1), NULL, 0, host1, sizeof(host1),
+                 &port1, NULL, 0, url1);
+    av_url_split(proto2, sizeof(proto2), NULL, 0, host2, sizeof(host2),
+                 &port2, NULL, 0, url2);
+    return port1 == port2 && !strcmp(proto1, proto2) && !strcmp(host1, host2);
+}
+
+AVIOContext *ff_seg_conn_pool_get(SegConnPool *pool, const char *url)
+{
+    AVIOContext *pb = NULL;
+
+    ff_mutex_lock(&pool->lock);
+    for (int i = pool->nb_conns - 1; i >= 0; i--) {
+        if (!same_server(pool->conns[i].location, url))
+            continue;
+        pb = pool->conns[i].pb;
+        av_free(pool->conns[i].location);
+        memmove(&pool->conns[i], &pool->conns[i + 1],
+                (pool->nb_conns - i - 1) * sizeof(*pool->conns));
+        pool->nb_conns--;
+        break;
+    }
+    ff_mutex_unlock(&pool->lock);
+
+    return pb;
+}
+
+void ff_seg_conn_pool_put(AVFormatContext *s, SegConnPool *pool, AVIOContext **pb)
+{
+    URLContext *uc;
+    char *location = NULL;
+
+    if (!*pb)
+        return;
+
+    uc = ffio_geturlcontext(*pb);
+    if (!uc || !uc->prot ||
+        (strcmp(uc->prot->name, "http") && strcmp(uc->prot->name, "https")) ||
+        av_opt_get(*pb, "location", AV_OPT_SEARCH_CHILDREN, (uint8_t**)&location) < 0 ||
+        !location) {
+        ff_format_io_close(s, pb);
+        return;
+    }
+
+    ff_mutex_lock(&pool->lock);
+    if (pool->nb_conns == SEG_MAX_IDLE_CONNECTIONS) {
+        ff_format_io_close(s, &pool->conns[0].pb);
+        av_free(pool->conns[0].location);
+        memmove(&pool->conns[0], &pool->conns[1],
+                (SEG_MAX_IDLE_CONNECTIONS - 1) * sizeof(*pool->conns));
+        pool->nb_conns--;
+    }
+    pool->conns[pool->nb_conns].pb       = *pb;
+    pool->conns[pool->nb_conns].location = location;
+    pool->nb_conns++;
+    ff_mutex_unlock(&pool->lock);
+    *pb = NULL;
+}
+
+static void entry_reset(SegPrefetch *p, SegPrefetchEntry *e)
+{
+    ff_format_io_close(p->s, &e->input);
+    av_freep(&e->url);
+    av_freep(&e->buf);
+    av_dict_free(&e->avio_opts);
+    if (p->budget_used)
+        atomic_fetch_sub(p->budget_used, e->buf_size);
+    e->buf_size = e->len = 0;
+    e->ret   = 0;
+    e->state = SEG_PREFETCH_EMPTY;
+    atomic_store(&e->cancel, 0);
+}
+
+void ff_seg_prefetch_buf_free(SegPrefetch *p)
+{
+    if (!p->buf)
+        return;
+
+    av_freep(&p->buf);
+    if (p->budget_used)
+        atomic_fetch_sub(p->budget_used, p->buf_size);
+    p->buf_size = p->len = p->pos = 0;
+}
+
+int ff_seg_prefetch_read(SegPrefetch *p, uint8_t *buf, int buf_size)
+{
+    int size = FFMIN(buf_size, p->len - p->pos);
+
+    if (size <= 0)
+        return 0;
+    memcpy(buf, p->buf + p->pos, size);
+    p->pos += size;
+    return size;
+}
+
+void ff_seg_prefetch_flush(SegPrefetch *p)
+{
+    if (p->entries) {
+        ff_mutex_lock(&p->lock);
+        for (int i = 0; i < p->nb_entries; i++) {
+            SegPrefetchEntry *e = &p->entries[i];
+            if (e->state == SEG_PREFETCH_RUNNING)
+                atomic_store(&e->cancel, 1);
+            else if (e->state != SEG_PREFETCH_EMPTY)
+                entry_reset(p, e);
+        }
+        ff_mutex_unlock(&p->lock);
+    }
+    ff_seg_prefetch_buf_free(p);
+}
+
+void ff_seg_prefetch_free(SegPrefetch *p)
+{
+    ff_seg_prefetch_buf_free(p);
+    if (!p->entries)
+        return;
+
+#if HAVE_THREADS
+    if (p->thread_started) {
+        ff_mutex_lock(&p->lock);
+        atomic_store(&p->abort, 1);
+        ff_cond_broadcast(&p->cond);
+        ff_mutex_unlock(&p->lock);
+        pthread_join(p->thread, NULL);
+        p->thread_started = 0;
+    }
+#endif
+
+    for (int i = 0; i < p->nb_entries; i++)
+        entry_reset(p, &p->entries[i]);
+    av_freep(&p->entries);
+    p->nb_entries = 0;
+    ff_cond_destroy(&p->cond);
+    ff_mutex_destroy(&p->lock);
+}
+
+#if HAVE_THREADS
+/* Reserve grow bytes for e, from the budget shared by all queues if any. */
+static int entry_grow(SegPrefetch *p, SegPrefetchEntry *e, int grow)
+{
+    uint8_t *tmp;
+
+    if (p->budget_used &&
+        (int64_t)atomic_fetch_add(p->budget_used, grow) + grow > p->max_size) {
+        atomic_fetch_sub(p->budget_used, grow);
+        return 0;
+    }
+    tmp = av_realloc(e->buf, e->buf_size + grow);
+    if (!tmp) {
+        if (p->budget_used)
+            atomic_fetch_sub(p->budget_used, grow);
+        return AVERROR(ENOMEM);
+    }
+    e->buf       = tmp;
+    e->buf_size += grow;
+    return grow;
+}
+
+static int download(SegPrefetch *p, SegPrefetchEntry *e)
+{
+    static const int chunk_size = 64 * 1024;
+    int64_t max_size = p->max_size;
+    int eof = 0;
+    int ret;
+
+    if (e->size >= 0)
+        max_size = FFMIN(max_size, e->size);
+
+    ret = p->open(p->opaque, e);
+    if (ret < 0)
+        return ret;
+
+    while (e->len < max_size) {
+        if (atomic_load(&e->cancel) || atomic_load(&p->abort) ||
+            ff_check_interrupt(&p->s->interrupt_callback))
+            return AVERROR_EXIT;
+
+        if (e->buf_size - e->len < chunk_size && e->buf_size < max_size) {
+            ret = entry_grow(p, e, FFMIN(4 * chunk_size, max_size - e->buf_size));
+            if (ret < 0)
+                return ret;
+            if (!ret && e->len == e->buf_size)
+                break;
+        }
+
+        ret = avio_read(e->input, e->buf + e->len,
+                        FFMIN(chunk_size, e->buf_size - e->len));
+        if (ret == AVERROR_EOF || !ret) {
+            eof = 1;
+            break;
+        }
+        if (ret < 0)
+            return ret;
+        e->len += ret;
+    }
+
+    /* keep the connection open only if there is more to read */
+    if (eof || e->len == e->size)
+        p->release(p->opaque, &e->input);
+
+    return 0;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    SegPrefetch *p = arg;
+
+    ff_thread_setname(p->thread_name);
+
+    ff_mutex_lock(&p->lock);
+    while (!atomic_load(&p->abort)) {
+        SegPrefetchEntry *e = NULL;
+        int ret;
+
+        /* download in playlist order */
+        for (int i = 0; i < p->nb_entries; i++) {
+            SegPrefetchEntry *cand = &p->entries[i];
+            if (cand->state == SEG_PREFETCH_QUEUED && (!e || cand->seq_no < e->seq_no))
+                e = cand;
+        }
+        if (!e) {
+            ff_cond_wait(&p->cond, &p->lock);
+            continue;
+        }
+
+        e->state = SEG_PREFETCH_RUNNING;
+        ff_mutex_unlock(&p->lock);
+
+        ret = download(p, e);
+
+        ff_mutex_lock(&p->lock);
+        e->ret   = ret;
+        e->state = SEG_PREFETCH_DONE;
+        if (atomic_load(&e->cancel))
+            entry_reset(p, e);
+        ff_cond_broadcast(&p->cond);
+    }
+    ff_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+int ff_seg_prefetch_init(SegPrefetch *p, AVFormatContext *s, int nb_entries,
+                         const char *thread_name)
+{
+    int ret;
+
+    p->s           = s;
+    p->thread_name = thread_name;
+    p->entries = av_calloc(nb_entries, sizeof(*p->entries));
+    if (!p->entries)
+        return AVERROR(ENOMEM);
+    p->nb_entries = nb_entries;
+
+    if ((ret = ff_mutex_init(&p->lock, NULL))) {
+        av_freep(&p->entries);
+        return AVERROR(ret);
+    }
+    if ((ret = ff_cond_init(&p->cond, NULL))) {
+        ff_mutex_destroy(&p->lock);
+        av_freep(&p->entries);
+        return AVERROR(ret);
+    }
+
+    ret = pthread_create(&p->thread, NULL, prefetch_thread, p);
+    if (ret)
+        return AVERROR(ret);
+    p->thread_started = 1;
+
+    return 0;
+}
+#else
+int ff_seg_prefetch_init(SegPrefetch *p, AVFormatContext *s, int nb_entries,
+                         const char *thread_name)
+{
+    return AVERROR(ENOSYS);
+}
+#endif
+
+void ff_seg_prefetch_schedule(SegPrefetch *p, int64_t first, int64_t last)
+{
+    if (!p->entries)
+        return;
+
+    ff_mutex_lock(&p->lock);
+    for (int i = 0; i < p->nb_entries; i++) {
+        SegPrefetchEntry *e = &p->entries[i];
+        if (e->state == SEG_PREFETCH_EMPTY || atomic_load(&e->cancel) ||
+            (e->seq_no >= first && e->seq_no <= last))
+            continue;
+        if (e->state == SEG_PREFETCH_RUNNING)
+            atomic_store(&e->cancel, 1);
+        else
+            entry_reset(p, e);
+    }
+
+    for (int64_t seq_no = first; seq_no <= last; seq_no++) {
+        SegPrefetchEntry *e = NULL;
+        int queued = 0, ret;
+
+        for (int i = 0; i < p->nb_entries; i++) {
+            SegPrefetchEntry *cand = &p->entries[i];
+            if (cand->state == SEG_PREFETCH_EMPTY)
+                e = e ? e : cand;
+            else if (cand->seq_no == seq_no && !atomic_load(&cand->cancel))
+                queued = 1;
+        }
+        if (queued)
+            continue;
+        if (!e)
+            break;
+
+        ret = p->get_segment(p->opaque, seq_no, e);
+        if (ret <= 0) {
+            entry_reset(p, e);
+            if (ret < 0)
+                break;
+            continue;
+        }
+        e->seq_no = seq_no;
+        e->state  = SEG_PREFETCH_QUEUED;
+    }
+    ff_cond_broadcast(&p->cond);
+    ff_mutex_unlock(&p->lock);
+}
+
+int ff_seg_prefetch_take(SegPrefetch *p, int64_t seq_no, const char *url,
+                         int64_t url_offset, int64_t size, AVIOContext **input)
+{
+    SegPrefetchEntry *e = NULL;
+    int taken = 0;
+
+    if (!p->entries)
+        return 0;
+
+    ff_mutex_lock(&p->lock);
+    for (int i = 0; i < p->nb_entries; i++) {
+        SegPrefetchEntry *cand = &p->entries[i];
+        if (cand->state != SEG_PREFETCH_EMPTY && !atomic_load(&cand->cancel) &&
+            cand->seq_no == seq_no) {
+            e = cand;
+            break;
+        }
+    }
+    if (!e) {
+        ff_mutex_unlock(&p->lock);
+        return 0;
+    }
+
+    while (e->state != SEG_PREFETCH_DONE)
+        ff_cond_wait(&p->cond, &p->lock);
+
+    /* the playlist may have been updated since the segment was queued */
+    if (e->ret >= 0 && !strcmp(e->url, url) &&
+        e->url_offset == url_offset && e->size == size) {
+        if (*input)
+            p->release(p->opaque, input);
+        *input   = e->input;
+        e->input = NULL;
+
+        ff_seg_prefetch_buf_free(p);
+        p->buf      = e->buf;
+        p->buf_size = e->buf_size;
+        p->len      = e->len;
+        e->buf      = NULL;
+        e->buf_size = 0;
+        taken = 1;
+    }
+    entry_reset(p, e);
+    ff_mutex_unlock(&p->lock);
+
+    return taken;
+}
@@ -0,0 +1,199 @@
+/*
+ * Segment fetching shared by the HLS and DASH demuxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_SEGFETCH_H
+#define AVFORMAT_SEGFETCH_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "libavutil/thread.h"
+#include "avformat.h"
+#include "avio.h"
+
+/**
+ * Issue a new request for url on the persistent HTTP connection *pb.
+ * On failure, *pb is closed.
+ */
+int ff_seg_keepalive_request(AVFormatContext *s, AVIOContext **pb,
+                             const char *url, AVDictionary **options);
+
+#define SEG_MAX_IDLE_CONNECTIONS 8
+
+typedef struct SegIdleConnection {
+    AVIOContext *pb;
+    char *location;
+} SegIdleConnection;
+
+/**
+ * Persistent HTTP connections with no request in flight, kept for the next
+ * request to the same server. Safe to use from several threads.
+ */
+typedef struct SegConnPool {
+    AVMutex lock;
+    int lock_init;
+    SegIdleConnection conns[SEG_MAX_IDLE_CONNECTIONS];
+    int nb_conns;
+} SegConnPool;
+
+int ff_seg_conn_pool_init(SegConnPool *pool);
+
+/**
+ * Close all the connections of the pool.
+ */
+void ff_seg_conn_pool_uninit(AVFormatContext *s, SegConnPool *pool);
+
+/**
+ * Take an idle connection to the server of url, if any.
+ * The next request must be issued with ff_seg_keepalive_request().
+ */
+AVIOContext *ff_seg_conn_pool_get(SegConnPool *pool, const char *url);
+
+/**
+ * Keep the connection *pb in the pool if it is a persistent HTTP connection,
+ * close it otherwise. Its response must have been read completely.
+ * The oldest connection is closed if the pool is full.
+ */
+void ff_seg_conn_pool_put(AVFormatContext *s, SegConnPool *pool, AVIOContext **pb);
+
+enum SegPrefetchState {
+    SEG_PREFETCH_EMPTY,
+    SEG_PREFETCH_QUEUED,
+    SEG_PREFETCH_RUNNING,
+    SEG_PREFETCH_DONE,
+};
+
+/**
+ * A segment downloaded ahead of time by the prefetch thread.
+ * At most max_size bytes of it are buffered; if the segment is larger, the
+ * connection is kept open and the rest is read from it once the segment
+ * becomes current.
+ */
+typedef struct SegPrefetchEntry {
+    enum SegPrefetchState state;
+    atomic_int cancel;
+    int64_t seq_no;
+
+    /* filled by the get_segment() callback */
+    char *url;
+    int64_t url_offset;
+    int64_t size;               ///< -1 if the segment is the whole resource
+    AVDictionary *avio_opts;
+
+    AVIOContext *input;
+    uint8_t *buf;
+    int buf_size;
+    int len;
+    int ret;
+} SegPrefetchEntry;
+
+typedef struct SegPrefetch {
+    AVFormatContext *s;
+    void *opaque;
+
+    /**
+     * Fill url, url_offset, size and avio_opts of e for segment seq_no.
+     * Called with the queue locked.
+     * @return 1 if e was filled, 0 to skip the segment, <0 to stop queueing
+     */
+    int (*get_segment)(void *opaque, int64_t seq_no, SegPrefetchEntry *e);
+    /**
+     * Open e->input, positioned at e->url_offset.
+     * Called from the prefetch thread.
+     */
+    int (*open)(void *opaque, SegPrefetchEntry *e);
+    /**
+     * Close a connection whose response has been read completely.
+     * Called from the prefetch thread and from ff_seg_prefetch_take().
+     */
+    void (*release)(void *opaque, AVIOContext **pb);
+
+    /* Bytes buffered for each segment, or over all the queues sharing
+     * budget_used if it is set */
+    int max_size;
+    atomic_int *budget_used;
+
+    const char *thread_name;
+    SegPrefetchEntry *entries;
+    int nb_entries;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    int thread_started;
+    AVMutex lock;
+    AVCond cond;
+    atomic_int abort;
+
+    /* Data of the current segment already downloaded, served before
+     * reading from its input */
+    uint8_t *buf;
+    int buf_size;
+    int len;
+    int pos;
+} SegPrefetch;
+
+/**
+ * Allocate nb_entries slots and start the prefetch thread.
+ * The callbacks, opaque, max_size and budget_used must be set in p before.
+ * On failure, ff_seg_prefetch_free() must still be called.
+ */
+int ff_seg_prefetch_init(SegPrefetch *p, AVFormatContext *s, int nb_entries,
+                         const char *thread_name);
+
+/**
+ * Stop the prefetch thread and free all prefetched data.
+ */
+void ff_seg_prefetch_free(SegPrefetch *p);
+
+/**
+ * Drop all prefetched data, cancelling downloads in progress.
+ */
+void ff_seg_prefetch_flush(SegPrefetch *p);
+
+/**
+ * Queue segments first to last for download, dropping the ones outside
+ * of that range.
+ */
+void ff_seg_prefetch_schedule(SegPrefetch *p, int64_t first, int64_t last);
+
+/**
+ * Wait for the prefetched copy of segment seq_no, if any. If it still
+ * matches url, url_offset and size, its data becomes the current buffer
+ * and its connection, if still open, is returned in *input. The previous
+ * *input, if any, must have been read completely and is passed to release().
+ *
+ * @return 1 if the segment was taken, 0 otherwise
+ */
+int ff_seg_prefetch_take(SegPrefetch *p, int64_t seq_no, const char *url,
+                         int64_t url_offset, int64_t size, AVIOContext **input);
+
+/**
+ * Read from the current buffer.
+ * @return number of bytes read, 0 if it is exhausted
+ */
+int ff_seg_prefetch_read(SegPrefetch *p, uint8_t *buf, int buf_size);
+
+/**
+ * Free the current buffer.
+ */
+void ff_seg_prefetch_buf_free(SegPrefetch *p);
+
+#endif /* AVFORMAT_SEGFETCH_H */
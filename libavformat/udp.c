@@ -26,12 +26,14 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
+
+#include <stdatomic.h>
 
 #include "avformat.h"
 #include "libavutil/avassert.h"
 #include "libavutil/mem.h"
 #include "libavutil/parseutils.h"
-#include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 #include "libavutil/log.h"
@@ -77,6 +79,7 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_MAX_MSG_BATCH 1024
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -96,7 +99,10 @@ typedef struct UDPContext {
 
     /* Circular Buffer variables for use in UDP receive code */
     int circular_buffer_size;
-    AVFifo *fifo;
+    uint8_t *ring;
+    int ring_size;
+    atomic_int ring_rpos;
+    atomic_int ring_wpos;
     int circular_buffer_error;
     int64_t bitrate; /* number of bits to send per second */
     int64_t burst_bits;
@@ -107,7 +113,15 @@ typedef struct UDPContext {
     pthread_cond_t cond;
     int thread_started;
 #endif
-    uint8_t tmp[UDP_MAX_PKT_SIZE+4];
+    /* datagrams received or sent by one call of the circular buffer thread */
+    int msg_batch;
+    int msg_slot_size;
+    uint8_t *msg_buf;
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    struct mmsghdr *msgs;
+    struct iovec *msg_iov;
+#endif
+    struct sockaddr_storage *msg_addr;
     int remaining_in_dg;
     char *localaddr;
     int timeout;
@@ -136,6 +150,7 @@ static const AVOption options[] = {
     { "connect",        "set if connect() should be called on socket",     OFFSET(is_connected),   AV_OPT_TYPE_BOOL,   { .i64 =  0 },     0, 1,       .flags = D|E },
     { "fifo_size",      "set the UDP receiving circular buffer size, expressed as a number of packets with size of 188 bytes", OFFSET(circular_buffer_size), AV_OPT_TYPE_INT, {.i64 = 7*4096}, 0, INT_MAX, D },
     { "overrun_nonfatal", "survive in case of UDP receiving circular buffer overrun", OFFSET(overrun_nonfatal), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,    D },
+    { "msg_batch",      "maximum number of datagrams per recvmmsg()/sendmmsg() call of the circular buffer thread", OFFSET(msg_batch), AV_OPT_TYPE_INT, {.i64 = 16}, 1, UDP_MAX_MSG_BATCH, D|E },
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
@@ -479,69 +494,216 @@ static int udp_get_file_handle(URLContext *h)
 }
 
 #if HAVE_PTHREAD_CANCEL
+/*
+ * The circular buffer is a single producer, single consumer ring of
+ * datagrams, each one prefixed with its 32-bit length. Only the producer
+ * moves ring_wpos and only the consumer moves ring_rpos, so data is passed
+ * without locking; the mutex and condition are only used to wait for the
+ * other side and to report errors.
+ */
+static int ring_can_read(UDPContext *s)
+{
+    int w = atomic_load_explicit(&s->ring_wpos, memory_order_acquire);
+    int r = atomic_load_explicit(&s->ring_rpos, memory_order_relaxed);
+    return (w - r + s->ring_size) % s->ring_size;
+}
+
+static void ring_copy_in(UDPContext *s, int pos, const uint8_t *src, int len)
+{
+    int len1 = FFMIN(len, s->ring_size - pos);
+    memcpy(s->ring + pos, src, len1);
+    memcpy(s->ring, src + len1, len - len1);
+}
+
+static void ring_copy_out(UDPContext *s, int pos, uint8_t *dst, int len)
+{
+    int len1 = FFMIN(len, s->ring_size - pos);
+    memcpy(dst, s->ring + pos, len1);
+    memcpy(dst + len1, s->ring, len - len1);
+}
+
+/* Called by the producer only. */
+static int ring_write(UDPContext *s, const uint8_t *buf, int len)
+{
+    int w = atomic_load_explicit(&s->ring_wpos, memory_order_relaxed);
+    int r = atomic_load_explicit(&s->ring_rpos, memory_order_acquire);
+    uint8_t hdr[4];
+
+    if ((r - w - 1 + s->ring_size) % s->ring_size < len + 4)
+        return AVERROR(ENOSPC);
+
+    AV_WL32(hdr, len);
+    ring_copy_in(s, w, hdr, 4);
+    ring_copy_in(s, (w + 4) % s->ring_size, buf, len);
+    atomic_store_explicit(&s->ring_wpos, (w + 4 + len) % s->ring_size,
+                          memory_order_release);
+    return 0;
+}
+
+/**
+ * Called by the consumer only. Copy at most size bytes of the next
+ * datagram to buf and drop the rest of it.
+ *
+ * @return the datagram length, AVERROR(EAGAIN) if the ring is empty
+ */
+static int ring_read(UDPContext *s, uint8_t *buf, int size)
+{
+    int r = atomic_load_explicit(&s->ring_rpos, memory_order_relaxed);
+    uint8_t hdr[4];
+    int len;
+
+    if (!ring_can_read(s))
+        return AVERROR(EAGAIN);
+
+    ring_copy_out(s, r, hdr, 4);
+    len = AV_RL32(hdr);
+    ring_copy_out(s, (r + 4) % s->ring_size, buf, FFMIN(len, size));
+    atomic_store_explicit(&s->ring_rpos, (r + 4 + len) % s->ring_size,
+                          memory_order_release);
+    return len;
+}
+
+static uint8_t *msg_slot(UDPContext *s, int i)
+{
+    return s->msg_buf + (size_t)i * s->msg_slot_size;
+}
+
+/* Receive up to msg_batch datagrams, return their number. */
+static int udp_recv_batch(URLContext *h, UDPContext *s, int *lens)
+{
+    int ret;
+
+#if HAVE_RECVMMSG
+    if (s->msg_batch > 1) {
+        int i;
+        for (i = 0; i < s->msg_batch; i++)
+            s->msgs[i].msg_hdr.msg_namelen = sizeof(s->msg_addr[i]);
+        ret = recvmmsg(s->udp_fd, s->msgs, s->msg_batch, MSG_WAITFORONE, NULL);
+        if (ret < 0)
+            return ff_neterrno();
+        for (i = 0; i < ret; i++) {
+            lens[i] = s->msgs[i].msg_len;
+            if (s->msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+                av_log(h, AV_LOG_WARNING, "Datagram truncated to %d bytes, "
+                       "increase pkt_size or set msg_batch to 1\n", lens[i]);
+        }
+        return ret;
+    }
+#endif
+    {
+        socklen_t addr_len = sizeof(s->msg_addr[0]);
+        ret = recvfrom(s->udp_fd, msg_slot(s, 0), s->msg_slot_size, 0,
+                       (struct sockaddr *)&s->msg_addr[0], &addr_len);
+        if (ret < 0)
+            return ff_neterrno();
+        lens[0] = ret;
+        return 1;
+    }
+}
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
     UDPContext *s = h->priv_data;
+    int lens[UDP_MAX_MSG_BATCH];
     int old_cancelstate;
+    int err = 0;
 
     ff_thread_setname("udp-rx");
 
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
-    pthread_mutex_lock(&s->mutex);
     if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
         av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
-        s->circular_buffer_error = AVERROR(EIO);
+        err = AVERROR(EIO);
         goto end;
     }
     while(1) {
-        int len;
-        struct sockaddr_storage addr;
-        socklen_t addr_len = sizeof(addr);
+        int i, n;
 
-        pthread_mutex_unlock(&s->mutex);
         /* Blocking operations are always cancellation points;
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
+        n = udp_recv_batch(h, s, lens);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
-        pthread_mutex_lock(&s->mutex);
-        if (len < 0) {
-            if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
-                s->circular_buffer_error = ff_neterrno();
+        if (n < 0) {
+            if (n != AVERROR(EAGAIN) && n != AVERROR(EINTR)) {
+                err = n;
                 goto end;
             }
             continue;
         }
-        if (ff_ip_check_source_lists(&addr, &s->filters))
-            continue;
-        AV_WL32(s->tmp, len);
 
-        if (av_fifo_can_write(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
+        for (i = 0; i < n; i++) {
+            if (ff_ip_check_source_lists(&s->msg_addr[i], &s->filters))
                 continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
+            if (ring_write(s, msg_slot(s, i), lens[i]) < 0) {
+                /* No Space left */
+                if (s->overrun_nonfatal) {
+                    av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                            "Surviving due to overrun_nonfatal option\n");
+                    continue;
+                } else {
+                    av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                            "To avoid, increase fifo_size URL option. "
+                            "To survive in such case, use overrun_nonfatal option\n");
+                    err = AVERROR(EIO);
+                    goto end;
+                }
             }
         }
-        av_fifo_write(s->fifo, s->tmp, len + 4);
+        pthread_mutex_lock(&s->mutex);
         pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
     }
 
 end:
+    pthread_mutex_lock(&s->mutex);
+    s->circular_buffer_error = err;
     pthread_cond_signal(&s->cond);
     pthread_mutex_unlock(&s->mutex);
     return NULL;
 }
 
+/* Send the n datagrams stored in the message slots, return 0 or an error. */
+static int udp_send_batch(UDPContext *s, const int *lens, int n)
+{
+    int i = 0;
+
+    while (i < n) {
+        int ret;
+#if HAVE_SENDMMSG
+        if (n - i > 1) {
+            int j;
+            for (j = i; j < n; j++) {
+                s->msg_iov[j].iov_len = lens[j];
+                s->msgs[j].msg_hdr.msg_name    = s->is_connected ? NULL : &s->dest_addr;
+                s->msgs[j].msg_hdr.msg_namelen = s->is_connected ? 0 : s->dest_addr_len;
+            }
+            ret = sendmmsg(s->udp_fd, s->msgs + i, n - i, 0);
+            if (ret >= 0) {
+                i += ret;
+                continue;
+            }
+        } else
+#endif
+        if (!s->is_connected) {
+            ret = sendto (s->udp_fd, msg_slot(s, i), lens[i], 0,
+                        (struct sockaddr *) &s->dest_addr,
+                        s->dest_addr_len);
+        } else
+            ret = send(s->udp_fd, msg_slot(s, i), lens[i], 0);
+        if (ret >= 0) {
+            i++;
+        } else {
+            ret = ff_neterrno();
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                return ret;
+        }
+    }
+    return 0;
+}
+
 static void *circular_buffer_task_tx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -551,6 +713,7 @@ static void *circular_buffer_task_tx( void *_URLContext)
     int64_t sent_bits = 0;
     int64_t burst_interval = s->bitrate ? (s->burst_bits * 1000000 / s->bitrate) : 0;
     int64_t max_delay = s->bitrate ?  ((int64_t)h->max_packet_size * 8 * 1000000 / s->bitrate + 1) : 0;
+    int lens[UDP_MAX_MSG_BATCH];
 
     ff_thread_setname("udp-tx");
 
@@ -563,74 +726,57 @@ static void *circular_buffer_task_tx( void *_URLContext)
     }
 
     for(;;) {
-        int len;
-        const uint8_t *p;
-        uint8_t tmp[4];
+        int n, ret;
         int64_t timestamp;
 
-        len = av_fifo_can_read(s->fifo);
-
-        while (len<4) {
+        while (!ring_can_read(s)) {
             if (s->close_req)
                 goto end;
             pthread_cond_wait(&s->cond, &s->mutex);
-            len = av_fifo_can_read(s->fifo);
         }
 
-        av_fifo_read(s->fifo, tmp, 4);
-        len = AV_RL32(tmp);
-
-        av_assert0(len >= 0);
-        av_assert0(len <= sizeof(s->tmp));
-
-        av_fifo_read(s->fifo, s->tmp, len);
-
         pthread_mutex_unlock(&s->mutex);
 
-        if (s->bitrate) {
-            timestamp = av_gettime_relative();
-            if (timestamp < target_timestamp) {
-                int64_t delay = target_timestamp - timestamp;
-                if (delay > max_delay) {
-                    delay = max_delay;
-                    start_timestamp = timestamp + delay;
-                    sent_bits = 0;
-                }
-                av_usleep(delay);
-            } else {
-                if (timestamp - burst_interval > target_timestamp) {
-                    start_timestamp = timestamp - burst_interval;
-                    sent_bits = 0;
+        /* Datagrams which are already due are sent together, the first
+         * one that has to wait for its time ends the batch. */
+        for (n = 0; n < s->msg_batch && ring_can_read(s); n++) {
+            if (s->bitrate) {
+                timestamp = av_gettime_relative();
+                if (timestamp < target_timestamp) {
+                    int64_t delay = target_timestamp - timestamp;
+                    if (n)
+                        break;
+                    if (delay > max_delay) {
+                        delay = max_delay;
+                        start_timestamp = timestamp + delay;
+                        sent_bits = 0;
+                    }
+                    av_usleep(delay);
+                } else {
+                    if (timestamp - burst_interval > target_timestamp) {
+                        start_timestamp = timestamp - burst_interval;
+                        sent_bits = 0;
+                    }
                 }
             }
-            sent_bits += len * 8;
-            target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
-        }
 
-        p = s->tmp;
-        while (len) {
-            int ret;
-            av_assert0(len > 0);
-            if (!s->is_connected) {
-                ret = sendto (s->udp_fd, p, len, 0,
-                            (struct sockaddr *) &s->dest_addr,
-                            s->dest_addr_len);
-            } else
-                ret = send(s->udp_fd, p, len, 0);
-            if (ret >= 0) {
-                len -= ret;
-                p   += ret;
-            } else {
-                ret = ff_neterrno();
-                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
-                    pthread_mutex_lock(&s->mutex);
-                    s->circular_buffer_error = ret;
-                    pthread_mutex_unlock(&s->mutex);
-                    return NULL;
-                }
+            lens[n] = ring_read(s, msg_slot(s, n), s->msg_slot_size);
+            av_assert0(lens[n] >= 0 && lens[n] <= s->msg_slot_size);
+
+            if (s->bitrate) {
+                sent_bits += lens[n] * 8;
+                target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
             }
         }
 
+        ret = udp_send_batch(s, lens, n);
+        if (ret < 0) {
+            pthread_mutex_lock(&s->mutex);
+            s->circular_buffer_error = ret;
+            pthread_mutex_unlock(&s->mutex);
+            return NULL;
+        }
+
         pthread_mutex_lock(&s->mutex);
     }
 
@@ -639,8 +785,53 @@ end:
     return NULL;
 }
 
+static int udp_alloc_circular_buffer(UDPContext *s)
+{
+#if !HAVE_RECVMMSG && !HAVE_SENDMMSG
+    s->msg_batch = 1;
+#endif
+    /* a single datagram can take the largest size, batches of them are
+     * limited to pkt_size each */
+    if (s->msg_batch > 1 && s->pkt_size > 0)
+        s->msg_slot_size = FFMIN(s->pkt_size, UDP_MAX_PKT_SIZE);
+    else
+        s->msg_slot_size = UDP_MAX_PKT_SIZE;
+    s->ring_size = s->circular_buffer_size + 1;
+    s->ring      = av_malloc(s->ring_size);
+    s->msg_buf   = av_malloc_array(s->msg_batch, s->msg_slot_size);
+    s->msg_addr  = av_calloc(s->msg_batch, sizeof(*s->msg_addr));
+    if (!s->ring || !s->msg_buf || !s->msg_addr)
+        return AVERROR(ENOMEM);
+    atomic_init(&s->ring_rpos, 0);
+    atomic_init(&s->ring_wpos, 0);
+
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    s->msgs    = av_calloc(s->msg_batch, sizeof(*s->msgs));
+    s->msg_iov = av_calloc(s->msg_batch, sizeof(*s->msg_iov));
+    if (!s->msgs || !s->msg_iov)
+        return AVERROR(ENOMEM);
+    for (int i = 0; i < s->msg_batch; i++) {
+        s->msg_iov[i].iov_base = msg_slot(s, i);
+        s->msg_iov[i].iov_len  = s->msg_slot_size;
+        s->msgs[i].msg_hdr.msg_iov    = &s->msg_iov[i];
+        s->msgs[i].msg_hdr.msg_iovlen = 1;
+        s->msgs[i].msg_hdr.msg_name   = &s->msg_addr[i];
+    }
+#endif
+    return 0;
+}
+#endif
 
+static void udp_free_circular_buffer(UDPContext *s)
+{
+    av_freep(&s->ring);
+    av_freep(&s->msg_buf);
+    av_freep(&s->msg_addr);
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    av_freep(&s->msgs);
+    av_freep(&s->msg_iov);
 #endif
+}
 
 /* put it in UDP context */
 /* return non zero if error */
@@ -735,6 +926,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "burst_bits", p)) {
             s->burst_bits = strtoll(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "msg_batch", p)) {
+            s->msg_batch = av_clip(strtol(buf, NULL, 10), 1, UDP_MAX_MSG_BATCH);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "localaddr", p)) {
             av_freep(&s->localaddr);
             s->localaddr = av_strdup(buf);
@@ -935,11 +1129,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     if ((!is_output && s->circular_buffer_size) || (is_output && s->bitrate && s->circular_buffer_size)) {
         /* start the task going */
-        s->fifo = av_fifo_alloc2(s->circular_buffer_size, 1, 0);
-        if (!s->fifo) {
-            ret = AVERROR(ENOMEM);
+        ret = udp_alloc_circular_buffer(s);
+        if (ret < 0)
             goto fail;
-        }
         ret = pthread_mutex_init(&s->mutex, NULL);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", strerror(ret));
@@ -972,7 +1164,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
  fail:
     if (udp_fd >= 0)
         closesocket(udp_fd);
-    av_fifo_freep2(&s->fifo);
+    udp_free_circular_buffer(s);
     ff_ip_reset_filters(&s->filters);
     return ret;
 }
@@ -996,24 +1188,20 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
 #if HAVE_PTHREAD_CANCEL
     int avail, nonblock = h->flags & AVIO_FLAG_NONBLOCK;
 
-    if (s->fifo) {
-        pthread_mutex_lock(&s->mutex);
+    if (s->ring) {
         do {
-            avail = av_fifo_can_read(s->fifo);
-            if (avail) { // >=size) {
-                uint8_t tmp[4];
-
-                av_fifo_read(s->fifo, tmp, 4);
-                avail = AV_RL32(tmp);
+            avail = ring_read(s, buf, size);
+            if (avail >= 0) {
                 if(avail > size){
                     av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
                     avail = size;
                 }
+                return avail;
+            }
 
-                av_fifo_read(s->fifo, buf, avail);
-                av_fifo_drain2(s->fifo, AV_RL32(tmp) - avail);
+            pthread_mutex_lock(&s->mutex);
+            if (ring_can_read(s)) {
                 pthread_mutex_unlock(&s->mutex);
-                return avail;
             } else if(s->circular_buffer_error){
                 int err = s->circular_buffer_error;
                 pthread_mutex_unlock(&s->mutex);
@@ -1028,10 +1216,9 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
                 struct timespec tv = { .tv_sec  =  t / 1000000,
                                        .tv_nsec = (t % 1000000) * 1000 };
                 int err = pthread_cond_timedwait(&s->cond, &s->mutex, &tv);
-                if (err) {
-                    pthread_mutex_unlock(&s->mutex);
+                pthread_mutex_unlock(&s->mutex);
+                if (err)
                     return AVERROR(err == ETIMEDOUT ? EAGAIN : err);
-                }
                 nonblock = 1;
             }
         } while(1);
@@ -1057,9 +1244,7 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
     int ret;
 
 #if HAVE_PTHREAD_CANCEL
-    if (s->fifo) {
-        uint8_t tmp[4];
-
+    if (s->ring) {
         pthread_mutex_lock(&s->mutex);
 
         /*
@@ -1072,14 +1257,16 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
             return err;
         }
 
-        if (av_fifo_can_write(s->fifo) < size + 4) {
+        if (size > s->msg_slot_size) {
+            pthread_mutex_unlock(&s->mutex);
+            av_log(h, AV_LOG_ERROR, "Datagram of %d bytes is larger than pkt_size\n", size);
+            return AVERROR(EINVAL);
+        }
+        if (ring_write(s, buf, size) < 0) {
             /* What about a partial packet tx ? */
             pthread_mutex_unlock(&s->mutex);
             return AVERROR(ENOMEM);
         }
-        AV_WL32(tmp, size);
-        av_fifo_write(s->fifo, tmp, 4); /* size of packet */
-        av_fifo_write(s->fifo, buf, size); /* the data */
         pthread_cond_signal(&s->cond);
         pthread_mutex_unlock(&s->mutex);
         return size;
@@ -1141,7 +1328,7 @@ static int udp_close(URLContext *h)
     }
 #endif
     closesocket(s->udp_fd);
-    av_fifo_freep2(&s->fifo);
+    udp_free_circular_buffer(s);
     ff_ip_reset_filters(&s->filters);
     return 0;
 }
@@ -256,6 +256,55 @@ int av_buffer_replace(AVBufferRef **pdst, const AVBufferRef *src)
     return 0;
 }
 
+static void buffer_pool_cache_init(AVBufferPool *pool)
+{
+    for (int i = 0; i < BUFFER_POOL_CACHE_SIZE; i++)
+        atomic_init(&pool->cache[i], 0);
+}
+
+/* returns 0 if the cache is full */
+static int buffer_pool_cache_push(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    for (int i = 0; i < BUFFER_POOL_CACHE_SIZE; i++) {
+        uintptr_t expected = 0;
+
+        if (atomic_load_explicit(&pool->cache[i], memory_order_relaxed))
+            continue;
+        if (atomic_compare_exchange_strong_explicit(&pool->cache[i], &expected,
+                                                    (uintptr_t)buf,
+                                                    memory_order_release,
+                                                    memory_order_relaxed))
+            return 1;
+    }
+    return 0;
+}
+
+static BufferPoolEntry *buffer_pool_cache_pop(AVBufferPool *pool)
+{
+    for (int i = BUFFER_POOL_CACHE_SIZE - 1; i >= 0; i--) {
+        uintptr_t buf;
+
+        if (!atomic_load_explicit(&pool->cache[i], memory_order_relaxed))
+            continue;
+        buf = atomic_exchange_explicit(&pool->cache[i], 0, memory_order_acquire);
+        if (buf)
+            return (BufferPoolEntry *)buf;
+    }
+    return NULL;
+}
+
+/* return an unused entry to the pool */
+static void buffer_pool_put(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    if (buffer_pool_cache_push(pool, buf))
+        return;
+
+    ff_mutex_lock(&pool->mutex);
+    buf->next = pool->pool;
+    pool->pool = buf;
+    ff_mutex_unlock(&pool->mutex);
+}
+
 AVBufferPool *av_buffer_pool_init2(size_t size, void *opaque,
                                    AVBufferRef* (*alloc)(void *opaque, size_t size),
                                    void (*pool_free)(void *opaque))
@@ -276,6 +325,7 @@ AVBufferPool *av_buffer_pool_init2(size_t size, void *opaque,
     pool->pool_free = pool_free;
 
     atomic_init(&pool->refcount, 1);
+    buffer_pool_cache_init(pool);
 
     return pool;
 }
@@ -295,12 +345,20 @@ AVBufferPool *av_buffer_pool_init(size_t size, AVBufferRef* (*alloc)(size_t size
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
 
     atomic_init(&pool->refcount, 1);
+    buffer_pool_cache_init(pool);
 
     return pool;
 }
 
 static void buffer_pool_flush(AVBufferPool *pool)
 {
+    BufferPoolEntry *buf;
+
+    while ((buf = buffer_pool_cache_pop(pool))) {
+        buf->free(buf->opaque, buf->data);
+        av_freep(&buf);
+    }
+
     while (pool->pool) {
         BufferPoolEntry *buf = pool->pool;
         pool->pool = buf->next;
@@ -347,10 +405,7 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     BufferPoolEntry *buf = opaque;
     AVBufferPool *pool = buf->pool;
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    buffer_pool_put(pool, buf);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -389,24 +444,31 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
 
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
 {
-    AVBufferRef *ret;
+    AVBufferRef *ret = NULL;
     BufferPoolEntry *buf;
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    buf = buffer_pool_cache_pop(pool);
+    if (!buf) {
+        ff_mutex_lock(&pool->mutex);
+        buf = pool->pool;
+        if (buf) {
+            pool->pool = buf->next;
+            buf->next = NULL;
+        } else {
+            ret = pool_alloc_buffer(pool);
+        }
+        ff_mutex_unlock(&pool->mutex);
+    }
+
     if (buf) {
         memset(&buf->buffer, 0, sizeof(buf->buffer));
         ret = buffer_create(&buf->buffer, buf->data, pool->size,
                             pool_release_buffer, buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
+        if (ret)
             buf->buffer.flags_internal |= BUFFER_FLAG_NO_FREE;
-        }
-    } else {
-        ret = pool_alloc_buffer(pool);
+        else
+            buffer_pool_put(pool, buf);
     }
-    ff_mutex_unlock(&pool->mutex);
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
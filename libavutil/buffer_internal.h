@@ -85,10 +85,23 @@ typedef struct BufferPoolEntry {
     AVBuffer buffer;
 } BufferPoolEntry;
 
+/**
+ * Number of free entries a pool can hold without taking its mutex.
+ */
+#define BUFFER_POOL_CACHE_SIZE 32
+
 struct AVBufferPool {
     AVMutex mutex;
     BufferPoolEntry *pool;
 
+    /*
+     * Lock-free cache of free entries, used before falling back to the
+     * mutex-protected list above. Entries are released into the lowest empty
+     * slot and taken from the highest occupied one, so the most recently
+     * released (and most likely cache-hot) buffer is reused first.
+     */
+    atomic_uintptr_t cache[BUFFER_POOL_CACHE_SIZE];
+
     /*
      * This is used to track when the pool is to be freed.
      * The pointer to the pool itself held by the caller is considered to
@@ -0,0 +1,175 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program checks the reuse order of AVBufferPool and that buffers
+ * handed out concurrently by several threads are never shared.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/thread.h"
+
+#define BUF_SIZE    64
+#define NB_BUFS     80 /* more than the lock-free cache holds */
+#define NB_THREADS  4
+#define NB_ITERS    20000
+
+static int test_lifo(AVBufferPool *pool)
+{
+    AVBufferRef *bufs[3];
+    uint8_t *data[3];
+
+    for (int i = 0; i < 3; i++) {
+        bufs[i] = av_buffer_pool_get(pool);
+        if (!bufs[i])
+            return 1;
+        data[i] = bufs[i]->data;
+    }
+    for (int i = 0; i < 3; i++)
+        av_buffer_unref(&bufs[i]);
+
+    for (int i = 2; i >= 0; i--) {
+        AVBufferRef *buf = av_buffer_pool_get(pool);
+        int same = buf && buf->data == data[i];
+
+        printf("reuse %d: %s\n", i, same ? "ok" : "wrong buffer");
+        bufs[i] = buf;
+        if (!same)
+            return 1;
+    }
+    for (int i = 0; i < 3; i++)
+        av_buffer_unref(&bufs[i]);
+
+    return 0;
+}
+
+static int test_overflow(AVBufferPool *pool)
+{
+    AVBufferRef *bufs[NB_BUFS];
+    uint8_t *data[NB_BUFS];
+    int ret = 0;
+
+    for (int i = 0; i < NB_BUFS; i++) {
+        bufs[i] = av_buffer_pool_get(pool);
+        if (!bufs[i])
+            return 1;
+        data[i] = bufs[i]->data;
+    }
+    for (int i = 0; i < NB_BUFS; i++)
+        av_buffer_unref(&bufs[i]);
+
+    /* every buffer must come back exactly once */
+    for (int i = 0; i < NB_BUFS; i++) {
+        bufs[i] = av_buffer_pool_get(pool);
+        if (!bufs[i])
+            return 1;
+        for (int j = 0; j < i; j++)
+            if (bufs[j]->data == bufs[i]->data)
+                ret = 1;
+    }
+    for (int i = 0; i < NB_BUFS; i++) {
+        int found = 0;
+        for (int j = 0; j < NB_BUFS; j++)
+            found |= bufs[j]->data == data[i];
+        if (!found)
+            ret = 1;
+    }
+    for (int i = 0; i < NB_BUFS; i++)
+        av_buffer_unref(&bufs[i]);
+
+    printf("overflow: %s\n", ret ? "failed" : "ok");
+    return ret;
+}
+
+typedef struct ThreadArg {
+    AVBufferPool *pool;
+    int id;
+    int errors;
+} ThreadArg;
+
+static void *thread_main(void *opaque)
+{
+    ThreadArg *arg = opaque;
+
+    for (int i = 0; i < NB_ITERS; i++) {
+        AVBufferRef *bufs[3];
+        int nb = 1 + (i + arg->id) % 3;
+
+        for (int j = 0; j < nb; j++) {
+            bufs[j] = av_buffer_pool_get(arg->pool);
+            if (!bufs[j]) {
+                arg->errors++;
+                nb = j;
+                break;
+            }
+            memset(bufs[j]->data, arg->id * 3 + j, BUF_SIZE);
+        }
+        for (int j = 0; j < nb; j++) {
+            for (int k = 0; k < BUF_SIZE; k++)
+                if (bufs[j]->data[k] != arg->id * 3 + j) {
+                    arg->errors++;
+                    break;
+                }
+            av_buffer_unref(&bufs[j]);
+        }
+    }
+
+    return NULL;
+}
+
+static int test_threads(AVBufferPool *pool)
+{
+    pthread_t threads[NB_THREADS];
+    ThreadArg args[NB_THREADS];
+    int errors = 0, ret;
+
+    for (int i = 0; i < NB_THREADS; i++) {
+        args[i] = (ThreadArg){ .pool = pool, .id = i };
+        if ((ret = pthread_create(&threads[i], NULL, thread_main, &args[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            return 1;
+        }
+    }
+    for (int i = 0; i < NB_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        errors += args[i].errors;
+    }
+
+    printf("threads: %s\n", errors ? "failed" : "ok");
+    return !!errors;
+}
+
+int main(void)
+{
+    AVBufferPool *pool = av_buffer_pool_init(BUF_SIZE, NULL);
+    int ret = 0;
+
+    if (!pool)
+        return 1;
+
+    ret |= test_lifo(pool);
+    ret |= test_overflow(pool);
+    ret |= test_threads(pool);
+
+    av_buffer_pool_uninit(&pool);
+
+    return ret;
+}
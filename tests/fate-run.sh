@@ -393,6 +393,23 @@ lavf_container_timecode()
     lavf_container "" "$1"
 }
 
+lavf_container_io_uring(){
+    lavf_container "" "$1 -io_uring 1" disable_crc || return
+    do_avconv_crc $file -auto_conversion_filters $DEC_OPTS -io_uring 1 -direct 1 -i $target_path/$file
+}
+
+seek_index(){
+    file=$target_path/tests/data/$1
+    index=$outdir/$test.idx
+    test "$keep" -ge 1 || cleanfiles="$cleanfiles $index"
+    rm -f $index
+    # build the index by reading the whole file, then check that it is loaded
+    ffmpeg -seek_index $target_path/$index -i $file -c copy -f null - || return
+    run ffprobe${PROGSUF}${EXECSUF} -v verbose -seek_index $target_path/$index $file 2>&1 |
+        grep -q "Loaded [0-9]* index entries" || return
+    run libavformat/tests/seek${EXECSUF} $file -seek_index $target_path/$index
+}
+
 lavf_container_fate()
 {
     t="${test#lavf-fate-}"
@@ -606,6 +623,44 @@ gaplessenc(){
     probegaplessinfo "$(target_path "$file1")"
 }
 
+# encode with one and with $2 threads, the outputs must be identical
+enc_threads(){
+    src_file=$(target_path $1)
+    enc_threads=$2
+    shift 2
+
+    file1="${outdir}/${test}.out-1"
+    file2="${outdir}/${test}.out-${enc_threads}"
+    cleanfiles="$cleanfiles $file1 $file2"
+
+    ffmpeg -auto_conversion_filters -i $src_file "$@" -threads 1 -y $(target_path $file1) || return
+    ffmpeg -auto_conversion_filters -i $src_file "$@" -threads $enc_threads -y $(target_path $file2) || return
+    cmp $file1 $file2
+}
+
+dec_shared_pool(){
+    src_fmt=$1
+    src_file=$(target_path $2)
+    enc_opt=$3
+    dec_opt=$4
+    nb_inputs=$5
+
+    encfile="${outdir}/${test}.nut"
+    cleanfiles="$cleanfiles $encfile"
+    tencfile=$(target_path $encfile)
+    ffmpeg -f $src_fmt -i $src_file $enc_opt -threads 1 -f nut -y $tencfile || return
+
+    inputs=
+    maps=
+    i=0
+    while [ $i -lt $nb_inputs ]; do
+        inputs="$inputs $dec_opt -shared_frame_threads 1 -i $tencfile"
+        maps="$maps -map $i:v"
+        i=$((i + 1))
+    done
+    framecrc $inputs $maps
+}
+
 audio_match(){
     sample=$(target_path $1)
     trefile=$2
@@ -240,6 +240,17 @@ fate-aac-pred-encode: CMP_TARGET = 662
 fate-aac-pred-encode: FUZZ = 12
 fate-aac-pred-encode: SIZE_TOLERANCE = 3560
 
+# slice threading across the channel elements must not change the output
+FATE_AAC_THREADS += fate-aac-threads-encode
+fate-aac-threads-encode: tests/data/asynth-44100-6.wav
+fate-aac-threads-encode: CMD = enc_threads tests/data/asynth-44100-6.wav 3 -c:a aac -b:a 384k -fflags +bitexact -flags +bitexact -f adts
+
+FATE_AAC_THREADS += fate-aac-pred-threads-encode
+fate-aac-pred-threads-encode: tests/data/asynth-44100-6.wav
+fate-aac-pred-threads-encode: CMD = enc_threads tests/data/asynth-44100-6.wav 3 -c:a aac -profile:a aac_main -b:a 384k -fflags +bitexact -flags +bitexact -f adts
+
+$(FATE_AAC_THREADS): CMP = null
+
 FATE_AAC_LATM += fate-aac-latm_000000001180bc60
 fate-aac-latm_000000001180bc60: CMD = pcm -i $(TARGET_SAMPLES)/aac/latm_000000001180bc60.mpg
 fate-aac-latm_000000001180bc60: REF = $(SAMPLES)/aac/latm_000000001180bc60.s16
@@ -262,10 +273,12 @@ $(FATE_AAC_ALL): CMP  = oneoff
 $(FATE_AAC_ALL): FUZZ = 2
 
 FATE_AAC_ENCODE-$(call ENCMUX, AAC, ADTS, ARESAMPLE_FILTER) += $(FATE_AAC_ENCODE)
+FATE_AAC_THREADS-$(call ENCMUX, AAC, ADTS, WAV_DEMUXER PCM_S16LE_DECODER ARESAMPLE_FILTER) += $(FATE_AAC_THREADS)
 
 FATE_AAC_BSF-$(call ALLYES, AAC_DEMUXER AAC_ADTSTOASC_BSF MATROSKA_MUXER) += fate-aac-autobsf-adtstoasc
 
 FATE_SAMPLES_FFMPEG += $(FATE_AAC_ALL) $(FATE_AAC_ENCODE-yes) $(FATE_AAC_BSF-yes)
+FATE_FFMPEG += $(FATE_AAC_THREADS-yes)
 
-fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_BSF-yes)
+fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_BSF-yes) $(FATE_AAC_THREADS-yes)
 fate-aac-latm: $(FATE_AAC_LATM-yes)
@@ -264,6 +264,14 @@ fate-ffmpeg-loopback-decoding: CMD = transcode \
     "-map 0:v:0 -c:v mpeg2video -f null - -flags +bitexact -idct simple -threads $$threads -dec 0:0 -filter_complex '[0:v][dec:0]hstack[stack]' -map '[stack]' -c:v ffv1" ""
 FATE_FFMPEG-$(call ENCDEC2, MPEG2VIDEO, FFV1, NUT, HSTACK_FILTER PIPE_PROTOCOL FRAMECRC_MUXER) += fate-ffmpeg-loopback-decoding
 
+# Test decoding several streams at once with frame threads on a shared pool.
+fate-ffmpeg-shared-frame-threads: tests/data/vsynth1.yuv
+fate-ffmpeg-shared-frame-threads: CMD = threads=3 thread_type=frame dec_shared_pool \
+    "rawvideo -s 352x288 -pix_fmt yuv420p" tests/data/vsynth1.yuv \
+    "-frames:v 20 -c:v mpeg4 -bf 2 -qscale 5 -flags +bitexact -fflags +bitexact" \
+    "-flags +bitexact -idct simple" 4
+FATE_FFMPEG-$(call ENCDEC, MPEG4, NUT, RAWVIDEO_DEMUXER FRAMECRC_MUXER PIPE_PROTOCOL) += fate-ffmpeg-shared-frame-threads
+
 # test matching by stream disposition
 fate-ffmpeg-spec-disposition: CMD = framecrc -i $(TARGET_SAMPLES)/mpegts/pmtchange.ts -map '0:disp:visual_impaired+descriptions:1' -c copy
 FATE_SAMPLES_FFMPEG-$(call FRAMECRC, MPEGTS,,) += fate-ffmpeg-spec-disposition
@@ -85,6 +85,9 @@ fate-filter-lavd-testsrc: CMD = framecrc -f lavfi -i testsrc=r=7:n=2:d=10
 FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2) += $(addprefix fate-filter-testsrc2-, yuv420p yuv444p rgb24 rgba)
 fate-filter-testsrc2-%: CMD = framecrc -lavfi testsrc2=r=7:d=10 -pix_fmt $(word 4, $(subst -, ,$(@)))
 
+FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC SPLIT CROP HFLIP VFLIP NEGATE VSTACK) += fate-filter-branch-threads
+fate-filter-branch-threads: CMD = framecrc -filter_complex_threads 4 -filter_complex_branch_threads -lavfi "testsrc=s=320x240:r=5:d=2,split=3[a][b][c];[a]crop=320:80:0:0[a1];[b]crop=320:80:0:80,hflip[b1];[c]crop=320:80:0:160,vflip,negate[c1];[a1][b1][c1]vstack=3" -pix_fmt rgb24
+
 FATE_FILTER-$(call FILTERFRAMECRC, ALLRGB) += fate-filter-allrgb
 fate-filter-allrgb: CMD = framecrc -lavfi allrgb=rate=5:duration=1 -pix_fmt rgb24
 
@@ -456,6 +459,14 @@ FATE_FILTER_VSYNTH-$(call FILTERDEMDEC, SCALE, RAWVIDEO, RAWVIDEO) += fate-filte
 fate-filter-scalechroma: tests/data/vsynth1.yuv
 fate-filter-scalechroma: CMD = framecrc -flags bitexact -s 352x288 -pix_fmt yuv444p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -pix_fmt yuv420p -sws_flags +bitexact -vf scale=out_chroma_loc=bottomleft
 
+FATE_FILTER_VSYNTH-$(call FILTERDEMDEC, SCALE, RAWVIDEO, RAWVIDEO) += fate-filter-scale-slices
+fate-filter-scale-slices: tests/data/vsynth1.yuv
+fate-filter-scale-slices: CMD = framecrc -flags bitexact -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -filter_threads 4 -vf scale=w=500:h=300:interl=1:flags=bicubic+bitexact+accurate_rnd -pix_fmt yuv420p
+
+FATE_FILTER_VSYNTH-$(call FILTERDEMDEC, MULTISCALE, RAWVIDEO, RAWVIDEO) += fate-filter-multiscale
+fate-filter-multiscale: tests/data/vsynth1.yuv
+fate-filter-multiscale: CMD = framecrc -flags bitexact -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -filter_complex "multiscale=sizes=176x144|320x240|300x80|88x72:flags=bicubic+bitexact+accurate_rnd[a][b][c][d]" -map "[a]" -map "[b]" -map "[c]" -map "[d]" -frames 10
+
 FATE_FILTER_VSYNTH_VIDEO_FILTER-$(CONFIG_VFLIP_FILTER) += fate-filter-vflip
 fate-filter-vflip: CMD = video_filter "vflip"
 
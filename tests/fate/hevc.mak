@@ -221,6 +221,22 @@ FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER SCALE_FILTER) +=         \
 
 FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER SCALE_FILTER) += $(HEVC_TESTS_MULTIVIEW)
 
+# tiled streams decode their tiles in parallel with slice threading;
+# the output must match the single-threaded conformance refs
+HEVC_SAMPLES_TILES =            \
+    ENTP_A_Qualcomm_1           \
+    ENTP_B_Qualcomm_1           \
+    STRUCT_A_Samsung_5          \
+    STRUCT_B_Samsung_4          \
+    STRUCT_B_Samsung_6          \
+    TILES_A_Cisco_2             \
+    TILES_B_Cisco_1             \
+
+HEVC_TESTS_TILES_SLICE_THREADS := $(addprefix fate-hevc-slice-threads-, $(HEVC_SAMPLES_TILES))
+$(HEVC_TESTS_TILES_SLICE_THREADS): CMD = threads=4 thread_type=slice framecrc -i $(TARGET_SAMPLES)/hevc-conformance/$(subst fate-hevc-slice-threads-,,$(@)).bit -pix_fmt yuv420p
+$(HEVC_TESTS_TILES_SLICE_THREADS): REF = $(SRC_PATH)/tests/ref/fate/$(subst fate-hevc-slice-threads-,hevc-conformance-,$(@))
+FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER) += $(HEVC_TESTS_TILES_SLICE_THREADS)
+
 fate-hevc-paramchange-yuv420p-yuv420p10: CMD = framecrc -i $(TARGET_SAMPLES)/hevc/paramchange_yuv420p_yuv420p10.hevc -fps_mode passthrough -sws_flags area+accurate_rnd+bitexact
 FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER SCALE_FILTER LARGE_TESTS) += fate-hevc-paramchange-yuv420p-yuv420p10
 
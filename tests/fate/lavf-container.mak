@@ -4,8 +4,8 @@ FATE_LAVF_CONTAINER-$(call ENCDEC2, DVVIDEO,    PCM_S16LE, AVI)                +
 FATE_LAVF_CONTAINER-$(call ENCDEC,  FLV,                   FLV)                += flv
 FATE_LAVF_CONTAINER-$(call ENCDEC,  RAWVIDEO,              FILMSTRIP)          += flm
 FATE_LAVF_CONTAINER-$(call ENCDEC2, MPEG2VIDEO, PCM_S16LE, GXF)                += gxf gxf_pal gxf_ntsc
-FATE_LAVF_CONTAINER-$(call ENCDEC2, MPEG4,      MP2,       MATROSKA)           += mkv mkv_attachment
-FATE_LAVF_CONTAINER-$(call ENCDEC2, MPEG4,      PCM_ALAW,  MOV)                += mov mov_rtphint mov_hybrid_frag ismv
+FATE_LAVF_CONTAINER-$(call ENCDEC2, MPEG4,      MP2,       MATROSKA)           += mkv mkv_attachment mkv_live
+FATE_LAVF_CONTAINER-$(call ENCDEC2, MPEG4,      PCM_ALAW,  MOV)                += mov mov_rtphint mov_hybrid_frag mov_moov_size mov_moov_size_large mov_io_uring ismv
 FATE_LAVF_CONTAINER-$(call ENCDEC,  MPEG4,                 MOV)                += mp4
 FATE_LAVF_CONTAINER-$(call ENCDEC2, MPEG1VIDEO, MP2,       MPEG1SYSTEM MPEGPS) += mpg
 FATE_LAVF_CONTAINER-$(call ENCDEC , FFV1,                  MXF)                += mxf_ffv1
@@ -17,11 +17,11 @@ FATE_LAVF_CONTAINER-$(call ENCDEC2, MPEG4,      MP2,       NUT)                +
 FATE_LAVF_CONTAINER-$(call ENCMUX,  RV10 AC3_FIXED,        RM)                 += rm
 FATE_LAVF_CONTAINER-$(call ENCDEC2, MJPEG,      PCM_S16LE, SMJPEG)             += smjpeg
 FATE_LAVF_CONTAINER-$(call ENCDEC,  FLV,                   SWF)                += swf
-FATE_LAVF_CONTAINER-$(call ENCDEC2, MPEG2VIDEO, MP2,       MPEGTS)             += ts
+FATE_LAVF_CONTAINER-$(call ENCDEC2, MPEG2VIDEO, MP2,       MPEGTS)             += ts ts_batch
 FATE_LAVF_CONTAINER-$(call ENCDEC,  MP2,                   WTV)                += wtv
 
 FATE_LAVF_CONTAINER_RESAMPLE := asf avi dv_pal dv_ntsc gxf_pal gxf_ntsc  \
-                                mkv mkv_attachment mpg mxf nut rm ts wtv
+                                mkv mkv_attachment mkv_live mpg mxf nut rm ts ts_batch wtv
 FATE_LAVF_CONTAINER-$(!CONFIG_ARESAMPLE_FILTER) := $(filter-out $(FATE_LAVF_CONTAINER_RESAMPLE),$(FATE_LAVF_CONTAINER-yes))
 
 FATE_LAVF_CONTAINER_SCALE := dv dv_pal dv_ntsc flm gxf gxf_pal gxf_ntsc \
@@ -49,9 +49,13 @@ fate-lavf-gxf_ntsc: CMD = lavf_container_timecode_drop "-af aresample=48000:tsf=
 fate-lavf-ismv: CMD = lavf_container_timecode "-an -write_tmcd 1 -c:v mpeg4 -threads 1"
 fate-lavf-mkv: CMD = lavf_container "" "-c:a mp2 -c:v mpeg4 -ar 44100 -threads 1"
 fate-lavf-mkv_attachment: CMD = lavf_container_attach "-c:a mp2 -c:v mpeg4 -threads 1 -f matroska"
+fate-lavf-mkv_live: CMD = lavf_container "" "-c:a mp2 -c:v mpeg4 -ar 44100 -threads 1 -live 1 -f matroska"
 fate-lavf-mov: CMD = lavf_container_timecode "-movflags +faststart -c:a pcm_alaw -c:v mpeg4 -threads 1"
 fate-lavf-mov_rtphint: CMD = lavf_container "" "-movflags +rtphint -c:a pcm_alaw -c:v mpeg4 -threads 1 -f mov"
 fate-lavf-mov_hybrid_frag: CMD = lavf_container "" "-movflags +hybrid_fragmented -c:a pcm_alaw -c:v mpeg4 -threads 1 -f mov"
+fate-lavf-mov_moov_size: CMD = lavf_container "" "-movflags +faststart -moov_size 1024 -c:a pcm_alaw -c:v mpeg4 -threads 1 -f mov"
+fate-lavf-mov_moov_size_large: CMD = lavf_container "" "-movflags +faststart -moov_size 65536 -c:a pcm_alaw -c:v mpeg4 -threads 1 -f mov"
+fate-lavf-mov_io_uring: CMD = lavf_container_io_uring "-movflags +faststart -c:a pcm_alaw -c:v mpeg4 -threads 1 -f mov"
 fate-lavf-mp4: CMD = lavf_container_timecode "-c:v mpeg4 -an -threads 1"
 fate-lavf-mpg: CMD = lavf_container_timecode "-ar 44100 -threads 1"
 fate-lavf-mxf: CMD = lavf_container_timecode "-af aresample=48000:tsf=s16p -bf 2 -threads 1"
@@ -66,6 +70,7 @@ fate-lavf-smjpeg:  CMD = lavf_container "" "-f smjpeg"
 # The RealMedia muxer is broken.
 fate-lavf-rm:  CMD = lavf_container "" "-c:a ac3_fixed" disable_crc
 fate-lavf-ts:  CMD = lavf_container "" "-mpegts_transport_stream_id 42 -ar 44100 -threads 1"
+fate-lavf-ts_batch: CMD = lavf_container "" "-mpegts_transport_stream_id 42 -ar 44100 -threads 1 -batch_packets 7 -f mpegts"
 fate-lavf-wtv: CMD = lavf_container "" "-c:a mp2 -threads 1"
 
 FATE_AVCONV += $(FATE_LAVF_CONTAINER)
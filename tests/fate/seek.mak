@@ -136,10 +136,10 @@ FATE_SEEK += $(FATE_SEEK_LAVF_AUDIO)
 
 # files from fate-lavf-container
 
-FATE_SEEK_LAVF_CONTAINER += asf avi dv flv gxf mkv mov mpg    \
-                            mxf mxf_d10 mxf_dv25 mxf_dvcpro50 \
-                            mxf_opatom mxf_opatom_audio       \
-                            nut swf ts wtv
+FATE_SEEK_LAVF_CONTAINER += asf avi dv flv gxf mkv mkv_live mov \
+                            mpg mxf mxf_d10 mxf_dv25            \
+                            mxf_dvcpro50 mxf_opatom             \
+                            mxf_opatom_audio nut swf ts wtv
 # rm is special: fate-lavf-rm does not read the created file
 # and therefore does not require the corresponding demuxer
 # to be present, so we have to explicitly check for this here.
@@ -150,6 +150,36 @@ FATE_SEEK_LAVF_CONTAINER := $(FATE_SEEK_LAVF_CONTAINER:%=fate-seek-lavf-%)
 FATE_SEEK_LAVF_CONTAINER := $(filter $(subst fate-,fate-seek-,$(FATE_LAVF_CONTAINER)), $(FATE_SEEK_LAVF_CONTAINER))
 FATE_SEEK += $(FATE_SEEK_LAVF_CONTAINER)
 
+# the mov demuxer must seek the same with its lazy sample index
+
+FATE_SEEK_LAVF_MOV_LAZY := $(filter fate-seek-lavf-mov, $(FATE_SEEK_LAVF_CONTAINER))
+FATE_SEEK_LAVF_MOV_LAZY := $(FATE_SEEK_LAVF_MOV_LAZY:%=%-lazy-index)
+$(FATE_SEEK_LAVF_MOV_LAZY): libavformat/tests/seek$(EXESUF) fate-lavf-mov
+$(FATE_SEEK_LAVF_MOV_LAZY): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.mov -lazy_index 1
+$(FATE_SEEK_LAVF_MOV_LAZY): REF = $(SRC_PATH)/tests/ref/seek/lavf-mov
+FATE_AVCONV += $(FATE_SEEK_LAVF_MOV_LAZY)
+
+# the matroska demuxer must seek the same with an index loaded from
+# seek_index, without Cues and without scanning clusters
+
+FATE_SEEK_LAVF_MKV_INDEX := $(filter fate-seek-lavf-mkv_live, $(FATE_SEEK_LAVF_CONTAINER))
+FATE_SEEK_LAVF_MKV_INDEX := $(FATE_SEEK_LAVF_MKV_INDEX:%=%-seek-index)
+$(FATE_SEEK_LAVF_MKV_INDEX): libavformat/tests/seek$(EXESUF) fate-lavf-mkv_live
+$(FATE_SEEK_LAVF_MKV_INDEX): CMD = seek_index lavf/lavf.mkv_live
+$(FATE_SEEK_LAVF_MKV_INDEX): REF = $(SRC_PATH)/tests/ref/seek/lavf-mkv_live
+FATE_AVCONV += $(FATE_SEEK_LAVF_MKV_INDEX)
+
+# the mpegts demuxer with its input thread: read 4 packets after each seek,
+# so that seeks happen while TS packets are still queued in that thread.
+# The ref is the same as without read_ahead.
+
+FATE_SEEK_LAVF_TS_READ_AHEAD := $(filter fate-seek-lavf-ts, $(FATE_SEEK_LAVF_CONTAINER))
+FATE_SEEK_LAVF_TS_READ_AHEAD := $(FATE_SEEK_LAVF_TS_READ_AHEAD:%=%-read-ahead)
+$(FATE_SEEK_LAVF_TS_READ_AHEAD): libavformat/tests/seek$(EXESUF) fate-lavf-ts
+$(FATE_SEEK_LAVF_TS_READ_AHEAD): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.ts -frames 4 -read_ahead 64
+$(FATE_SEEK_LAVF_TS_READ_AHEAD): REF = $(SRC_PATH)/tests/ref/seek/lavf-ts-read-ahead
+FATE_AVCONV += $(FATE_SEEK_LAVF_TS_READ_AHEAD)
+
 # files from fate-lavf-video
 
 FATE_SEEK_LAVF_VIDEO += gif y4m
@@ -207,4 +237,5 @@ fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 
 FATE_AVCONV += $(FATE_SEEK)
 FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
-fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
+fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_LAVF_MOV_LAZY) \
+               $(FATE_SEEK_LAVF_MKV_INDEX) $(FATE_SEEK_LAVF_TS_READ_AHEAD)